@@ -0,0 +1,513 @@
+/* columns.c -- columnar inventory output for find.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* -fprintcolumns writes selected attributes of each file in batches
+ * of columns, so that the output can be loaded or queried without
+ * parsing text.  The layout is similar in spirit to the Arrow IPC
+ * format, but much simpler.  All numbers are little-endian, and every
+ * buffer starts at a multiple of 8 bytes from the start of the file,
+ * so the file can be mapped into memory and used in place.
+ *
+ *   magic    "FINDCOL1"
+ *   blocks   each is: u32 kind, u32 zero, u64 length, then LENGTH
+ *            bytes of contents (LENGTH is a multiple of 8).
+ *
+ * The blocks are a schema, then any number of dictionary and batch
+ * blocks, then an end block.
+ *
+ *   BLOCK_SCHEMA      u32 number of columns, then for each column a u8
+ *                     type, a u8 name length and the name.
+ *   BLOCK_DICTIONARY  u32 id of the first directory, u32 count N,
+ *                     u64 offsets[N + 1], then the directory names.
+ *   BLOCK_BATCH       u32 number of rows, u32 zero, then the buffers
+ *                     of each column in schema order.  A buffer is a
+ *                     u64 length and the data, padded to 8 bytes.
+ *   BLOCK_END         u64 total rows, u64 total directories.
+ *
+ * A COLUMN_UINT64 or COLUMN_INT64 column has one buffer of 8-byte
+ * values.  A COLUMN_PATH column has three buffers: u32 directory ids,
+ * u32 offsets[rows + 1] and the bytes of the last component of each
+ * name.  A file's name is the directory name (which includes its
+ * trailing slash, and is empty for the starting points) followed by
+ * the last component.  Directory ids are allocated from 0 and the
+ * dictionary block defining an id precedes the first batch using it.
+ *
+ * Files are visited depth-first, so the directory part of a name is
+ * always the same as that of a recent file at the same depth.  We
+ * therefore remember the most recent directory for each depth, rather
+ * than all directories, which keeps memory use independent of the
+ * size of the tree.
+ */
+
+/* config.h always comes first. */
+#include <config.h>
+
+/* system headers. */
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* gnulib headers. */
+#include "intprops.h"
+#include "quotearg.h"
+#include "stat-time.h"
+#include "xalloc.h"
+
+/* find headers. */
+#include "defs.h"
+#include "columns.h"
+#include "system.h"
+
+
+enum column_type
+{
+  COLUMN_UINT64 = 1,
+  COLUMN_INT64 = 2,             /* nanoseconds since the epoch */
+  COLUMN_PATH = 3               /* dictionary-encoded directory + name */
+};
+
+enum block_kind
+{
+  BLOCK_SCHEMA = 1,
+  BLOCK_DICTIONARY = 2,
+  BLOCK_BATCH = 3,
+  BLOCK_END = 4
+};
+
+enum
+{
+  BatchRows = 65536,            /* rows per batch */
+  BlockHeaderSize = 16
+};
+
+enum column_id
+{
+  COL_PATH, COL_SIZE, COL_MTIME, COL_UID, COL_GID,
+  COL_MODE, COL_INODE, COL_DEV, COL_NLINK,
+  N_COLUMN_IDS
+};
+
+static const struct column_def
+{
+  const char *name;
+  enum column_type type;
+} column_defs[N_COLUMN_IDS] =
+{
+  {"path", COLUMN_PATH},
+  {"size", COLUMN_UINT64},
+  {"mtime", COLUMN_INT64},
+  {"uid", COLUMN_UINT64},
+  {"gid", COLUMN_UINT64},
+  {"mode", COLUMN_UINT64},
+  {"inode", COLUMN_UINT64},
+  {"dev", COLUMN_UINT64},
+  {"nlink", COLUMN_UINT64},
+};
+
+/* A growable byte buffer. */
+struct colbuf
+{
+  char *data;
+  size_t len;
+  size_t size;
+};
+
+/* The most recent directory seen at one depth. */
+struct dir_slot
+{
+  bool valid;
+  uint32_t id;
+  struct colbuf text;
+};
+
+struct column_writer
+{
+  FILE *stream;
+  const char *filename;
+  enum column_id columns[N_COLUMN_IDS];
+  size_t n_columns;
+  bool has_path;
+  bool started;                 /* the magic and schema are written */
+  bool finished;
+
+  /* The current batch. */
+  size_t rows;
+  struct colbuf values[N_COLUMN_IDS];   /* fixed-width columns */
+  struct colbuf dir_ids;
+  struct colbuf name_offsets;
+  struct colbuf names;
+
+  /* Directories which have not been written out yet. */
+  uint32_t dict_first;
+  struct colbuf dict_offsets;
+  struct colbuf dict_text;
+
+  uint32_t n_dirs;
+  struct dir_slot *slots;       /* indexed by depth */
+  size_t n_slots;
+
+  uint64_t total_rows;
+  struct colbuf block;          /* the block being assembled */
+};
+
+
+static void
+colbuf_append (struct colbuf *b, const void *p, size_t n)
+{
+  while (b->size - b->len < n)
+    b->data = x2nrealloc (b->data, &b->size, 1);
+  memcpy (b->data + b->len, p, n);
+  b->len += n;
+}
+
+static void
+put_le (char *p, uint64_t v, size_t n)
+{
+  size_t i;
+  for (i = 0; i < n; i++)
+    {
+      p[i] = v & 0xFF;
+      v >>= 8;
+    }
+}
+
+/* Append the N low-order bytes of V, least significant first. */
+static void
+colbuf_append_le (struct colbuf *b, uint64_t v, size_t n)
+{
+  char buf[8];
+  put_le (buf, v, n);
+  colbuf_append (b, buf, n);
+}
+
+static void
+colbuf_pad (struct colbuf *b)
+{
+  static const char zeros[8];
+  colbuf_append (b, zeros, (8 - b->len % 8) % 8);
+}
+
+
+static void
+block_begin (struct column_writer *w, enum block_kind kind)
+{
+  w->block.len = 0;
+  colbuf_append_le (&w->block, kind, 4);
+  colbuf_append_le (&w->block, 0, 4);
+  colbuf_append_le (&w->block, 0, 8);   /* length; see block_end */
+}
+
+static void
+block_append_buffer (struct column_writer *w, const struct colbuf *buf)
+{
+  colbuf_append_le (&w->block, buf->len, 8);
+  colbuf_append (&w->block, buf->data, buf->len);
+  colbuf_pad (&w->block);
+}
+
+static void
+block_end (struct column_writer *w)
+{
+  colbuf_pad (&w->block);
+  put_le (w->block.data + 8, w->block.len - BlockHeaderSize, 8);
+  if (fwrite (w->block.data, 1, w->block.len, w->stream) < w->block.len)
+    nonfatal_nontarget_file_error (errno, w->filename);
+}
+
+static void
+write_schema (struct column_writer *w)
+{
+  size_t i;
+
+  if (fwrite ("FINDCOL1", 1, 8, w->stream) < 8)
+    nonfatal_nontarget_file_error (errno, w->filename);
+
+  block_begin (w, BLOCK_SCHEMA);
+  colbuf_append_le (&w->block, w->n_columns, 4);
+  for (i = 0; i < w->n_columns; i++)
+    {
+      const struct column_def *def = &column_defs[w->columns[i]];
+      const size_t len = strlen (def->name);
+      colbuf_append_le (&w->block, def->type, 1);
+      colbuf_append_le (&w->block, len, 1);
+      colbuf_append (&w->block, def->name, len);
+    }
+  block_end (w);
+  w->started = true;
+}
+
+/* Write out the directories added since the last dictionary block. */
+static void
+write_dictionary (struct column_writer *w)
+{
+  const uint32_t count = w->n_dirs - w->dict_first;
+
+  if (0 == count)
+    return;
+  block_begin (w, BLOCK_DICTIONARY);
+  colbuf_append_le (&w->block, w->dict_first, 4);
+  colbuf_append_le (&w->block, count, 4);
+  colbuf_append (&w->block, w->dict_offsets.data, w->dict_offsets.len);
+  colbuf_append (&w->block, w->dict_text.data, w->dict_text.len);
+  block_end (w);
+
+  w->dict_first = w->n_dirs;
+  w->dict_offsets.len = 0;
+  w->dict_text.len = 0;
+  colbuf_append_le (&w->dict_offsets, 0, 8);
+}
+
+static void
+write_batch (struct column_writer *w)
+{
+  size_t i;
+
+  if (!w->started)
+    write_schema (w);
+  if (0 == w->rows)
+    return;
+
+  write_dictionary (w);
+  block_begin (w, BLOCK_BATCH);
+  colbuf_append_le (&w->block, w->rows, 4);
+  colbuf_append_le (&w->block, 0, 4);
+  for (i = 0; i < w->n_columns; i++)
+    {
+      const enum column_id c = w->columns[i];
+      if (COL_PATH == c)
+        {
+          block_append_buffer (w, &w->dir_ids);
+          block_append_buffer (w, &w->name_offsets);
+          block_append_buffer (w, &w->names);
+        }
+      else
+        {
+          block_append_buffer (w, &w->values[c]);
+        }
+      w->values[c].len = 0;
+    }
+  block_end (w);
+
+  w->total_rows += w->rows;
+  w->rows = 0;
+  w->dir_ids.len = 0;
+  w->names.len = 0;
+  w->name_offsets.len = 0;
+  colbuf_append_le (&w->name_offsets, 0, 4);
+}
+
+
+/* Return the id of the directory DIR (of length LEN), whose entries
+ * are at depth DEPTH, allocating a new one if it is not the directory
+ * we last saw at that depth.
+ */
+static uint32_t
+directory_id (struct column_writer *w, size_t depth,
+              const char *dir, size_t len)
+{
+  struct dir_slot *slot;
+
+  if (depth >= w->n_slots)
+    {
+      size_t old = w->n_slots;
+      w->n_slots = depth + 1;
+      w->slots = xnrealloc (w->slots, w->n_slots, sizeof *w->slots);
+      memset (w->slots + old, 0, (w->n_slots - old) * sizeof *w->slots);
+    }
+  slot = &w->slots[depth];
+  if (slot->valid && slot->text.len == len
+      && 0 == memcmp (slot->text.data, dir, len))
+    return slot->id;
+
+  if (UINT32_MAX == w->n_dirs)
+    error (EXIT_FAILURE, 0, _("%s: too many directories for %s"),
+           safely_quote_err_filename (0, w->filename), "-fprintcolumns");
+
+  slot->valid = true;
+  slot->id = w->n_dirs++;
+  slot->text.len = 0;
+  colbuf_append (&slot->text, dir, len);
+
+  colbuf_append (&w->dict_text, dir, len);
+  colbuf_append_le (&w->dict_offsets, w->dict_text.len, 8);
+  return slot->id;
+}
+
+static void
+append_path (struct column_writer *w, const char *pathname)
+{
+  size_t dirlen = 0;
+  const char *base = pathname;
+
+  if (state.path_base)
+    {
+      /* The directory part includes the slash. */
+      dirlen = state.path_dirlen + 1;
+      base = pathname + dirlen;
+    }
+  colbuf_append_le (&w->dir_ids,
+                    directory_id (w, state.curdepth, pathname, dirlen), 4);
+  colbuf_append (&w->names, base, strlen (base));
+  colbuf_append_le (&w->name_offsets, w->names.len, 4);
+}
+
+/* Return TS as nanoseconds since the epoch, saturating if it is out
+ * of range.
+ */
+static int64_t
+timespec_to_ns (struct timespec ts)
+{
+  int64_t ns;
+
+  if (INT_MULTIPLY_WRAPV (ts.tv_sec, 1000000000, &ns)
+      || INT_ADD_WRAPV (ns, ts.tv_nsec, &ns))
+    return ts.tv_sec < 0 ? INT64_MIN : INT64_MAX;
+  return ns;
+}
+
+bool
+pred_fprintcolumns (const char *pathname, struct stat *stat_buf,
+                    struct predicate *pred_ptr)
+{
+  struct column_writer *w = pred_ptr->args.column_writer;
+  size_t i;
+
+  /* Keep the offsets of the names within 32 bits. */
+  if (w->has_path && w->names.len > UINT32_MAX - strlen (pathname))
+    write_batch (w);
+
+  for (i = 0; i < w->n_columns; i++)
+    {
+      const enum column_id c = w->columns[i];
+      uint64_t v;
+
+      switch (c)
+        {
+        case COL_PATH:
+          append_path (w, pathname);
+          continue;
+        case COL_SIZE:
+          v = stat_buf->st_size;
+          break;
+        case COL_MTIME:
+          v = timespec_to_ns (get_stat_mtime (stat_buf));
+          break;
+        case COL_UID:
+          v = stat_buf->st_uid;
+          break;
+        case COL_GID:
+          v = stat_buf->st_gid;
+          break;
+        case COL_MODE:
+          v = stat_buf->st_mode;
+          break;
+        case COL_INODE:
+          v = stat_buf->st_ino;
+          break;
+        case COL_DEV:
+          v = stat_buf->st_dev;
+          break;
+        case COL_NLINK:
+          v = stat_buf->st_nlink;
+          break;
+        default:
+          abort ();
+        }
+      colbuf_append_le (&w->values[c], v, 8);
+    }
+
+  if (++w->rows == BatchRows)
+    write_batch (w);
+  return true;
+}
+
+
+struct column_writer *
+column_writer_create (FILE *stream, const char *filename,
+                      const char *spec, bool *need_stat)
+{
+  struct column_writer *w = xzalloc (sizeof *w);
+  const char *p = spec;
+
+  w->stream = stream;
+  w->filename = filename;
+  *need_stat = false;
+
+  while (true)
+    {
+      const size_t len = strcspn (p, ",");
+      enum column_id c;
+      size_t i;
+
+      for (c = 0; c < N_COLUMN_IDS; c++)
+        {
+          if (strlen (column_defs[c].name) == len
+              && 0 == strncmp (column_defs[c].name, p, len))
+            break;
+        }
+      if (N_COLUMN_IDS == c)
+        {
+          error (EXIT_FAILURE, 0,
+                 _("invalid column list %s for %s: valid columns are "
+                   "path, size, mtime, uid, gid, mode, inode, dev and nlink"),
+                 quotearg_n_style (0, options.err_quoting_style, spec),
+                 "-fprintcolumns");
+        }
+      for (i = 0; i < w->n_columns; i++)
+        {
+          if (w->columns[i] == c)
+            error (EXIT_FAILURE, 0, _("column %s given twice for %s"),
+                   column_defs[c].name, "-fprintcolumns");
+        }
+
+      w->columns[w->n_columns++] = c;
+      if (COL_PATH == c)
+        w->has_path = true;
+      else
+        *need_stat = true;
+
+      if ('\0' == p[len])
+        break;
+      p += len + 1;
+    }
+
+  colbuf_append_le (&w->name_offsets, 0, 4);
+  colbuf_append_le (&w->dict_offsets, 0, 8);
+  return w;
+}
+
+void
+finish_column_output (struct predicate *p)
+{
+  struct column_writer *w;
+
+  if (!pred_is (p, pred_fprintcolumns))
+    return;
+  w = p->args.column_writer;
+  if (w->finished)
+    return;
+
+  write_batch (w);
+  block_begin (w, BLOCK_END);
+  colbuf_append_le (&w->block, w->total_rows, 8);
+  colbuf_append_le (&w->block, w->n_dirs, 8);
+  block_end (w);
+  w->finished = true;
+}
@@ -0,0 +1,41 @@
+/* columns.h -- columnar inventory output for find.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef INC_COLUMNS_H
+# define INC_COLUMNS_H 1
+
+# include <stdbool.h>
+# include <stdio.h>
+
+struct column_writer;
+struct predicate;
+
+/* Parse SPEC, a comma-separated list of column names, and return a
+   writer for those columns to STREAM.  FILENAME is used in error
+   messages.  Exit with an error message if SPEC is invalid.  Set
+   *NEED_STAT if any of the columns needs the stat information of each
+   file.  */
+struct column_writer *column_writer_create (FILE *stream,
+                                            const char *filename,
+                                            const char *spec,
+                                            bool *need_stat);
+
+/* If P is a -fprintcolumns predicate, write out its last batch and
+   the end of its output.  Called for each predicate at exit, before
+   the output files are closed.  */
+void finish_column_output (struct predicate *p);
+
+#endif
@@ -0,0 +1,266 @@
+/* contextcache.c -- cache SELinux security contexts of visited files.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* On a labelled system, a directory tree usually carries only a
+ * handful of distinct security contexts.  Reading the context is an
+ * extended attribute lookup per file, and -context then needs an
+ * fnmatch call per file on top of that.
+ *
+ * We therefore intern every context string we see, so that each
+ * distinct context is stored (and matched against each -context
+ * pattern) just once.  In addition, when we already have stat
+ * information for a file which we may see again (because it has
+ * several links, or because we are following symbolic links), we
+ * remember its context keyed by (device, inode).  Changing the
+ * context of a file updates its ctime, so if the ctime is still the
+ * same on the next visit we can skip reading the attribute.
+ */
+
+/* config.h always comes first. */
+#include <config.h>
+
+/* system headers. */
+#include <errno.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* gnulib headers. */
+#include "hash.h"
+#include "stat-time.h"
+#include "timespec.h"
+#include "xalloc.h"
+
+/* find headers. */
+#include "defs.h"
+#include "contextcache.h"
+
+
+enum
+{
+  DefaultHashTableSize = 31
+};
+
+/* The result of matching one context against one -context pattern. */
+struct match_memo
+{
+  const char *pattern;
+  bool matched;
+  struct match_memo *next;
+};
+
+struct file_context
+{
+  char *text;
+  struct match_memo *memo;
+};
+
+struct inode_context
+{
+  dev_t device;
+  ino_t inode;
+  struct timespec ctime;
+  struct file_context *ctx;
+};
+
+static Hash_table *contexts;
+static Hash_table *inodes;
+
+
+static size_t
+context_hashfunc (const void *pv, size_t buckets)
+{
+  const struct file_context *p = pv;
+  return hash_string (p->text, buckets);
+}
+
+static bool
+context_comparator (const void *av, const void *bv)
+{
+  const struct file_context *a = av, *b = bv;
+  return 0 == strcmp (a->text, b->text);
+}
+
+static void
+context_free (void *pv)
+{
+  struct file_context *p = pv;
+  while (p->memo)
+    {
+      struct match_memo *next = p->memo->next;
+      free (p->memo);
+      p->memo = next;
+    }
+  free (p->text);
+  free (p);
+}
+
+static size_t
+inode_hashfunc (const void *pv, size_t buckets)
+{
+  const struct inode_context *p = pv;
+  return (p->device ^ p->inode) % buckets;
+}
+
+static bool
+inode_comparator (const void *av, const void *bv)
+{
+  const struct inode_context *a = av, *b = bv;
+  return (a->inode == b->inode) && (a->device == b->device);
+}
+
+
+/* Return true if we might visit the file described by ST again
+   during this run, so that it is worth remembering its context.  */
+static bool
+may_revisit (const struct stat *st)
+{
+  if (options.symlink_handling == SYMLINK_ALWAYS_DEREF)
+    return true;
+  return !S_ISDIR (st->st_mode) && st->st_nlink > 1;
+}
+
+/* Find or create the interned copy of SCONTEXT.  */
+static struct file_context *
+intern_context (const char *scontext)
+{
+  struct file_context key, *found;
+
+  if (!contexts)
+    {
+      contexts = hash_initialize (DefaultHashTableSize, NULL,
+                                  context_hashfunc, context_comparator,
+                                  context_free);
+      if (!contexts)
+        xalloc_die ();
+    }
+
+  key.text = (char *) scontext;
+  found = hash_lookup (contexts, &key);
+  if (!found)
+    {
+      found = xmalloc (sizeof *found);
+      found->text = xstrdup (scontext);
+      found->memo = NULL;
+      if (!hash_insert (contexts, found))
+        xalloc_die ();
+    }
+  return found;
+}
+
+static void
+remember_inode (const struct stat *st, struct file_context *ctx)
+{
+  struct inode_context key, *entry;
+
+  if (!inodes)
+    {
+      inodes = hash_initialize (DefaultHashTableSize, NULL,
+                                inode_hashfunc, inode_comparator, free);
+      if (!inodes)
+        xalloc_die ();
+    }
+
+  key.device = st->st_dev;
+  key.inode = st->st_ino;
+  entry = hash_lookup (inodes, &key);
+  if (!entry)
+    {
+      entry = xmalloc (sizeof *entry);
+      entry->device = st->st_dev;
+      entry->inode = st->st_ino;
+      if (!hash_insert (inodes, entry))
+        xalloc_die ();
+    }
+  entry->ctime = get_stat_ctime (st);
+  entry->ctx = ctx;
+}
+
+
+struct file_context *
+get_file_context (const struct stat *stat_buf)
+{
+  struct file_context *ctx;
+  char *scontext;
+  const bool cacheable = state.have_stat && may_revisit (stat_buf);
+
+  if (cacheable && inodes)
+    {
+      struct inode_context key;
+      const struct inode_context *entry;
+
+      key.device = stat_buf->st_dev;
+      key.inode = stat_buf->st_ino;
+      entry = hash_lookup (inodes, &key);
+      if (entry && 0 == timespec_cmp (entry->ctime,
+                                      get_stat_ctime (stat_buf)))
+        return entry->ctx;
+    }
+
+  if ((*options.x_getfilecon) (state.cwd_dir_fd, state.rel_pathname,
+                               &scontext) < 0)
+    return NULL;
+
+  ctx = intern_context (scontext);
+  freecon (scontext);
+
+  if (cacheable)
+    remember_inode (stat_buf, ctx);
+  return ctx;
+}
+
+const char *
+file_context_text (const struct file_context *ctx)
+{
+  return ctx->text;
+}
+
+bool
+file_context_matches (struct file_context *ctx, const char *pattern)
+{
+  struct match_memo *m;
+
+  for (m = ctx->memo; m; m = m->next)
+    {
+      if (m->pattern == pattern)
+        return m->matched;
+    }
+
+  m = xmalloc (sizeof *m);
+  m->pattern = pattern;
+  m->matched = (fnmatch (pattern, ctx->text, 0) == 0);
+  m->next = ctx->memo;
+  ctx->memo = m;
+  return m->matched;
+}
+
+void
+contextcache_free (void)
+{
+  if (inodes)
+    {
+      hash_free (inodes);
+      inodes = NULL;
+    }
+  if (contexts)
+    {
+      hash_free (contexts);
+      contexts = NULL;
+    }
+}
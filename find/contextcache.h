@@ -0,0 +1,42 @@
+/* contextcache.h -- cache SELinux security contexts of visited files.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef INC_CONTEXTCACHE_H
+# define INC_CONTEXTCACHE_H 1
+
+# include <stdbool.h>
+# include <sys/stat.h>
+
+struct file_context;
+
+/* Return the (interned) security context of the file currently being
+   visited, or NULL with errno set if it could not be determined.
+   STAT_BUF is only consulted if state.have_stat is true.  */
+struct file_context *get_file_context (const struct stat *stat_buf);
+
+/* Return the text of the security context CTX.  The string is owned
+   by the cache and remains valid until contextcache_free is called.  */
+const char *file_context_text (const struct file_context *ctx);
+
+/* Return true if CTX matches the glob PATTERN.  The result is
+   remembered, so each distinct context is matched against each
+   pattern only once.  PATTERN is compared by address.  */
+bool file_context_matches (struct file_context *ctx, const char *pattern);
+
+/* Release all memory used by the cache.  */
+void contextcache_free (void);
+
+#endif
@@ -81,6 +81,14 @@ typedef bool (*PRED_FUNC) (const char *pathname, struct stat * stat_buf,
 /* The number of seconds in a day. */
 # define DAYSECS            86400
 
+/* Output to a pipe or a regular file is written in chunks of this
+ * size.  It matches the default limit for F_SETPIPE_SZ on Linux.
+ */
+enum
+{
+  OutputBufferSize = 1024 * 1024
+};
+
 /* Argument structures for predicates. */
 
 enum comparison_type
@@ -139,10 +147,44 @@ struct samefile_file_id
   int fd;
 };
 
+struct mode_change;
+
+/* chmod_val is used by -chmod.  */
+struct chmod_val
+{
+  struct mode_change *change;
+  mode_t umask;                 /* Applies to modes like "+x" which do not say who.  */
+};
+
+/* chown_val is used by -chown.  An ID of -1 is left as it is.  */
+struct chown_val
+{
+  uid_t uid;
+  gid_t gid;
+};
+
+/* target_dir is used by -moveto and -linkto.  */
+struct target_dir
+{
+  const char *name;
+  int fd;
+};
+
+/* Converts a count of FROM-byte units into TO-byte units, rounding
+   up, as human_readable (N, BUF, human_ceiling, FROM, TO) would.  See
+   block_converter_init and convert_blocks.  */
+struct block_converter
+{
+  uintmax_t mul;                /* FROM / gcd (FROM, TO) */
+  uintmax_t div;                /* TO / gcd (FROM, TO) */
+  int div_shift;                /* log2 (DIV), or -1 if DIV is not a power of 2 */
+};
+
 struct size_val
 {
   enum comparison_type kind;
   int blocksize;
+  struct block_converter blocks;        /* bytes to BLOCKSIZE units */
   uintmax_t size;
 };
 
@@ -178,6 +220,11 @@ struct time_val
   enum xval xval;
   enum comparison_type kind;
   struct timespec ts;
+
+  /* For the tests which compare against a window of time (-amin,
+     -mtime, -used and so on), the inclusive range of matching
+     timestamps.  This is worked out from KIND and TS at parse time.  */
+  struct timespec lower, upper;
 };
 
 
@@ -186,11 +233,26 @@ struct exec_val
   bool multiple;                /* -exec {} \+ denotes multiple argument. */
   struct buildcmd_control ctl;
   struct buildcmd_state state;
-  char **replace_vec;           /* Command arguments (for ";" style) */
+  struct bc_insert_template *replace_tpl; /* Command arguments (for ";" style) */
   int num_args;
   bool close_stdin;             /* If true, close stdin in the child. */
   struct saved_cwd *wd_for_exec;        /* What directory to perform the exec in. */
   int last_child_status;        /* Status of the most recent child. */
+  bool status_unused;           /* ";" form whose result nothing tests. */
+
+  /* For -execdir ... +, the directory of the files in the argument
+   * list being built (a copy of the name find uses for it, which is
+   * not NUL-terminated), and batches set aside for reuse (see exec.c).
+   */
+  char *dir_key;
+  size_t dir_keylen;
+  size_t dir_keyalloc;
+  struct execdir_batch *spare_batches;
+
+  /* For -execworker, the workers (see exec.c).  last_child_status is
+   * then the status the worker reported for the last file.
+   */
+  struct exec_worker *worker;
 };
 
 /* The format string for a -printf or -fprintf is chopped into one or
@@ -206,19 +268,28 @@ enum SegmentKind
   KIND_FORMAT,                  /* Regular format */
 };
 
+struct time_format;
+struct printf_op;
+struct column_writer;
+
 struct segment
 {
   enum SegmentKind segkind;     /* KIND_FORMAT, KIND_PLAIN, KIND_STOP */
   char format_char[2];          /* Format chars if kind is KIND_FORMAT */
   char *text;                   /* Plain text or `%' format string. */
   int text_len;                 /* Length of `text'. */
+  struct time_format *time_format;      /* Date directives only; see print.c */
   struct segment *next;         /* Next segment for this predicate. */
 };
 
 struct format_val
 {
   struct segment *segment;      /* Linked list of segments. */
+  struct printf_op *ops;        /* The segments compiled; see print.c */
+  size_t n_ops;                 /* Number of elements in `ops'. */
   FILE *stream;                 /* Output stream to print on. */
+  struct SharefileEntry *shared;        /* Where STREAM came from, if a file;
+                                           see output_stream.  */
   const char *filename;         /* We need the filename for error messages. */
   bool dest_is_tty;             /* True if the destination is a terminal. */
   struct quoting_options *quote_opts;
@@ -306,8 +377,13 @@ struct predicate
     struct time_val reftime;    /* newer newerXY anewer cnewer mtime atime ctime mmin amin cmin */
     struct perm_val perm;       /* perm */
     struct samefile_file_id samefileid; /* samefile */
+    struct chmod_val chmod;     /* chmod */
+    struct chown_val chown;     /* chown */
+    struct target_dir target;   /* moveto linkto */
+    bool status_unused;         /* delete: nothing tests the result */
     bool types[FTYPE_COUNT];    /* file type(s) */
     struct format_val printf_vec;       /* printf fprintf fprint ls fls print0 fprint0 print */
+    struct column_writer *column_writer;        /* fprintcolumns */
     char *scontext;             /* security context */
   } args;
 
@@ -345,6 +421,14 @@ enum SymlinkOption
 };
 
 void set_follow_state (enum SymlinkOption opt);
+
+/* GroupOutput represents the choice made with -groupoutput. */
+enum GroupOutput
+{
+  GROUP_OUTPUT_NONE,            /* the default */
+  GROUP_OUTPUT_ORDERED,         /* -groupoutput ordered */
+  GROUP_OUTPUT_UNORDERED        /* -groupoutput unordered */
+};
 void cleanup (void);
 
 /* fstype.c */
@@ -403,6 +487,8 @@ PREDICATEFUNCTION pred_amin;
 PREDICATEFUNCTION pred_and;
 PREDICATEFUNCTION pred_anewer;
 PREDICATEFUNCTION pred_atime;
+PREDICATEFUNCTION pred_chmod;
+PREDICATEFUNCTION pred_chown;
 PREDICATEFUNCTION pred_closeparen;
 PREDICATEFUNCTION pred_cmin;
 PREDICATEFUNCTION pred_cnewer;
@@ -412,12 +498,16 @@ PREDICATEFUNCTION pred_delete;
 PREDICATEFUNCTION pred_empty;
 PREDICATEFUNCTION pred_exec;
 PREDICATEFUNCTION pred_execdir;
+PREDICATEFUNCTION pred_execworker;
 PREDICATEFUNCTION pred_executable;
 PREDICATEFUNCTION pred_false;
 PREDICATEFUNCTION pred_fls;
 PREDICATEFUNCTION pred_fprint;
 PREDICATEFUNCTION pred_fprint0;
+PREDICATEFUNCTION pred_fprintcolumns;
 PREDICATEFUNCTION pred_fprintf;
+PREDICATEFUNCTION pred_fprintjson;
+PREDICATEFUNCTION pred_fprinttlv;
 PREDICATEFUNCTION pred_fstype;
 PREDICATEFUNCTION pred_gid;
 PREDICATEFUNCTION pred_group;
@@ -426,9 +516,11 @@ PREDICATEFUNCTION pred_iname;
 PREDICATEFUNCTION pred_inum;
 PREDICATEFUNCTION pred_ipath;
 PREDICATEFUNCTION pred_links;
+PREDICATEFUNCTION pred_linkto;
 PREDICATEFUNCTION pred_lname;
 PREDICATEFUNCTION pred_ls;
 PREDICATEFUNCTION pred_mmin;
+PREDICATEFUNCTION pred_moveto;
 PREDICATEFUNCTION pred_mtime;
 PREDICATEFUNCTION pred_name;
 PREDICATEFUNCTION pred_negate;
@@ -449,6 +541,7 @@ PREDICATEFUNCTION pred_readable;
 PREDICATEFUNCTION pred_regex;
 PREDICATEFUNCTION pred_samefile;
 PREDICATEFUNCTION pred_size;
+PREDICATEFUNCTION pred_touch;
 PREDICATEFUNCTION pred_true;
 PREDICATEFUNCTION pred_type;
 PREDICATEFUNCTION pred_uid;
@@ -514,6 +607,14 @@ pred_quit (const char *pathname, struct stat *stat_buf,
                            struct predicate *p);
 
 /* util.c. */
+     const char *get_link_target (void);
+     int get_link_target_stat (const struct stat **target);
+     void forget_link_target (void);
+     char *enlarge_output_buffer (FILE *fp);
+     FILE *output_stream (struct format_val *dest);
+     void block_converter_init (struct block_converter *c,
+                                uintmax_t from, uintmax_t to);
+     uintmax_t convert_blocks (const struct block_converter *c, uintmax_t n);
      bool following_links (void);
      bool digest_mode (mode_t *mode, const char *pathname, const char *name,
                        struct stat *pstat, bool leaf);
@@ -566,6 +667,11 @@ pred_quit (const char *pathname, struct stat *stat_buf,
         */
        bool ignore_readdir_race;
 
+       /* If true, a non-directory with more than one hard link is
+        * only visited under the first name we find for it.
+        */
+       bool links_once;
+
        /* If true, pass control characters through.  If false, escape them
         * or turn them into harmless things.
         */
@@ -629,6 +735,21 @@ pred_quit (const char *pathname, struct stat *stat_buf,
 
        /* True if actions like -ok, -okdir need a user confirmation via stdin.  */
        bool ok_prompt_stdin;
+
+       /* The greatest number of commands run by -exec and -execdir
+        * which may be running at the same time (see -maxprocs).
+        */
+       int max_procs;
+
+       /* Whether the output of each command run in the background is
+        * kept together, and in which order (see -groupoutput).
+        */
+       enum GroupOutput group_output;
+
+       /* If positive, the number of seconds each command run by -exec
+        * or -execdir ... {} + should take (see -batchtime).
+        */
+       double batch_time;
      };
 
 
@@ -656,6 +777,16 @@ pred_quit (const char *pathname, struct stat *stat_buf,
        /* Length of starting path. */
        int starting_path_length;
 
+       /* Where the last component of the pathname being visited starts,
+        * and how many bytes of the pathname make up its leading
+        * directories (as printed by %h).  These are taken from fts, so
+        * no string scanning is needed.  PATH_BASE is NULL for starting
+        * points, since they are named exactly as the user gave them;
+        * callers must then work this out for themselves.
+        */
+       const char *path_base;
+       size_t path_dirlen;
+
        /* If true, don't descend past current directory.
           Can be set by -prune, -maxdepth, -mount and -xdev. */
        bool stop_at_current_level;
@@ -663,9 +794,10 @@ pred_quit (const char *pathname, struct stat *stat_buf,
        /* Status value to return to system. */
        int exit_status;
 
-       /* True if there are any execdirs.  This saves us a pair of fchdir()
-        * calls for every directory we leave if it is false.  This is just
-        * an optimisation.  Set to true if you want to be conservative.
+       /* True if there are any execdirs.  This saves us looking for
+        * -execdir ... + argument lists to run at exit if it is false.
+        * This is just an optimisation.  Set to true if you want to be
+        * conservative.
         */
        bool execdirs_outstanding;
 
@@ -674,6 +806,18 @@ pred_quit (const char *pathname, struct stat *stat_buf,
 
        /* Avoid multiple error messages for the same file. */
        bool already_issued_stat_error_msg;
+
+       /* The target of the symbolic link being visited, and the result
+        * of stat()ing that target.  Both are filled in lazily (by
+        * get_link_target and get_link_target_stat) so that tests like
+        * -lname and directives like %l can share one readlink call.
+        */
+       bool have_link_target;
+       char *link_target;       /* NULL if readlink failed */
+       int link_target_errno;
+       bool have_target_stat;
+       struct stat target_stat;
+       int target_stat_errno;   /* zero if target_stat is valid */
      };
 
 /* exec.c */
@@ -681,6 +825,13 @@ pred_quit (const char *pathname, struct stat *stat_buf,
                           struct predicate *pred_ptr);
      int launch (struct buildcmd_control *ctl, void *usercontext, int argc,
                  char **argv);
+     void wait_for_running_commands (void);
+     void complete_execdir (struct exec_val *execp);
+     void init_execworker (struct exec_val *execp, char **argv, int argc);
+     bool impl_pred_execworker (const char *pathname, struct stat *stat_buf,
+                                struct predicate *pred_ptr);
+     void complete_execworker (struct exec_val *execp);
+     void complete_exec (struct exec_val *execp);
 
 /* finddata.c */
      extern struct options options;
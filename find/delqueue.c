@@ -0,0 +1,368 @@
+/* delqueue.c -- remove files for -delete on several threads at once.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* On a network file system every unlink is a round trip to the
+ * server, so removing a large tree one file at a time takes far
+ * longer than it needs to.  When nothing looks at the result of
+ * -delete, the removals are instead handed to a few threads, and any
+ * failures are reported when the main thread next looks at the queue.
+ *
+ * The one ordering that matters is that a directory is not removed
+ * (or looked into by -empty, or seen by a command) until everything
+ * below it is gone.  Since -delete implies -depth, everything below a
+ * directory has been queued by the time we get to it, and it is
+ * enough to wait for the files queued at greater depths.
+ */
+
+/* config.h always comes first. */
+#include <config.h>
+
+/* system headers. */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* gnulib headers. */
+#include "cloexec.h"
+#include "xalloc.h"
+
+/* find headers. */
+#include "defs.h"
+#include "delqueue.h"
+#include "system.h"
+
+
+enum
+{
+  DelqueueThreads = 8,          /* removals in progress at once */
+  DelqueueMaxPending = 4096,    /* queued before we wait for some */
+  DelqueueMaxDirs = 64          /* directories held open for the queue */
+};
+
+/* A directory with files queued in it.  We keep our own descriptor
+   for it, since fts closes its own once it has finished reading the
+   directory.  */
+struct delq_dir
+{
+  int fd;                       /* ours, or AT_FDCWD */
+  int source;                   /* the descriptor we duplicated */
+  size_t refs;
+};
+
+struct delq_job
+{
+  struct delq_dir *dir;
+  int flags;                    /* for unlinkat */
+  int depth;
+  int err;                      /* errno value, once done */
+  char *pathname;               /* for diagnostics */
+  char *name;                   /* relative to DIR */
+  struct delq_job *next;
+};
+
+/* These are shared with the threads, under LOCK. */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+static struct delq_job *todo = NULL;
+static struct delq_job **todo_tail = &todo;
+static struct delq_job *done = NULL;    /* most recent first */
+static bool stopping = false;
+
+/* These belong to the main thread. */
+static pthread_t threads[DelqueueThreads];
+static size_t nthreads = 0u;
+static bool cannot_start = false;
+static bool exit_registered = false;
+static struct delq_dir *cur_dir = NULL;
+static size_t ndirs = 0u;               /* live delq_dirs, cur_dir included */
+static size_t pending = 0u;             /* queued and not yet reaped */
+static size_t *pending_at_depth = NULL;
+static size_t ndepths = 0u;
+
+
+static void *
+delq_worker (void *arg)
+{
+  (void) arg;
+
+  pthread_mutex_lock (&lock);
+  for (;;)
+    {
+      struct delq_job *job;
+      int err = 0;
+
+      while (!todo && !stopping)
+        pthread_cond_wait (&work_ready, &lock);
+      job = todo;
+      if (!job)
+        break;
+      todo = job->next;
+      if (!todo)
+        todo_tail = &todo;
+      pthread_mutex_unlock (&lock);
+
+      /* As in pred_delete, retry as a directory on EISDIR. */
+      if (0 != unlinkat (job->dir->fd, job->name, job->flags))
+        {
+          err = errno;
+          if (EISDIR == err && 0 == (job->flags & AT_REMOVEDIR))
+            err = (0 == unlinkat (job->dir->fd, job->name,
+                                  job->flags | AT_REMOVEDIR)) ? 0 : errno;
+        }
+
+      pthread_mutex_lock (&lock);
+      job->err = err;
+      job->next = done;
+      done = job;
+      pthread_cond_signal (&job_done);
+    }
+  pthread_mutex_unlock (&lock);
+  return NULL;
+}
+
+static bool
+start_threads (void)
+{
+  sigset_t all, old;
+
+  if (nthreads || cannot_start)
+    return nthreads > 0;
+
+  /* Signals are for the main thread to handle. */
+  sigfillset (&all);
+  pthread_sigmask (SIG_BLOCK, &all, &old);
+  while (nthreads < DelqueueThreads
+         && 0 == pthread_create (&threads[nthreads], NULL, delq_worker, NULL))
+    nthreads++;
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+  cannot_start = (0 == nthreads);
+  if (nthreads && !exit_registered)
+    {
+      /* Fatal errors and the like leave by calling exit, without going
+         through cleanup; the files already queued should still go,
+         and their failures should still be reported.  */
+      atexit (delqueue_finish);
+      exit_registered = true;
+    }
+  return nthreads > 0;
+}
+
+static void
+release_dir (struct delq_dir *dir)
+{
+  if (0 == --dir->refs)
+    {
+      if (dir->fd >= 0)
+        close (dir->fd);
+      free (dir);
+      ndirs--;
+    }
+}
+
+/* Report on the finished jobs in the list starting at JOB (which is
+   most recent first), and free them.  */
+static void
+reap (struct delq_job *job)
+{
+  struct delq_job *oldest = NULL;
+
+  while (job)
+    {
+      struct delq_job *next = job->next;
+      job->next = oldest;
+      oldest = job;
+      job = next;
+    }
+
+  for (job = oldest; job; job = oldest)
+    {
+      oldest = job->next;
+      /* As in pred_delete, a file which has vanished is not an error
+         with -ignore_readdir_race.  */
+      if (job->err && !(ENOENT == job->err && options.ignore_readdir_race))
+        {
+          error (0, job->err, _("cannot delete %s"),
+                 safely_quote_err_filename (0, job->pathname));
+          state.exit_status = EXIT_FAILURE;
+        }
+      pending--;
+      pending_at_depth[job->depth]--;
+      release_dir (job->dir);
+      free (job);
+    }
+}
+
+/* Reap the jobs which have finished, first waiting for one if WAIT. */
+static void
+collect (bool wait)
+{
+  struct delq_job *finished;
+
+  pthread_mutex_lock (&lock);
+  while (wait && !done)
+    pthread_cond_wait (&job_done, &lock);
+  finished = done;
+  done = NULL;
+  pthread_mutex_unlock (&lock);
+  reap (finished);
+}
+
+/* Return the directory of the file being examined, or NULL if we
+   cannot keep it open.  */
+static struct delq_dir *
+current_dir (void)
+{
+  if (cur_dir && cur_dir->source != state.cwd_dir_fd)
+    delqueue_left_dir ();
+  if (!cur_dir)
+    {
+      int fd = AT_FDCWD;
+
+      /* Each directory costs us a descriptor, which fts may need;
+         wait for the files queued in the older ones.  */
+      while (ndirs >= DelqueueMaxDirs && pending)
+        collect (true);
+      if (AT_FDCWD != state.cwd_dir_fd)
+        {
+          fd = dup_cloexec (state.cwd_dir_fd);
+          if (fd < 0)
+            return NULL;
+        }
+      cur_dir = xmalloc (sizeof *cur_dir);
+      cur_dir->fd = fd;
+      cur_dir->source = state.cwd_dir_fd;
+      cur_dir->refs = 1u;
+      ndirs++;
+    }
+  return cur_dir;
+}
+
+static bool
+pending_below (int depth)
+{
+  size_t i;
+
+  for (i = depth < 0 ? 0u : (size_t) depth + 1u; i < ndepths; i++)
+    if (pending_at_depth[i])
+      return true;
+  return false;
+}
+
+void
+delqueue_wait (int depth)
+{
+  while (pending && pending_below (depth))
+    collect (true);
+}
+
+bool
+delqueue_unlink (const char *pathname, int flags)
+{
+  const bool maybe_dir = (flags & AT_REMOVEDIR) || !state.have_type
+    || 0 == state.type || S_ISDIR (state.type);
+  const size_t pathsize = strlen (pathname) + 1u;
+  const size_t namesize = strlen (state.rel_pathname) + 1u;
+  struct delq_dir *dir;
+  struct delq_job *job;
+  struct delq_job *finished;
+
+  if (state.curdepth < 0 || !start_threads ())
+    return false;
+
+  if (maybe_dir)
+    delqueue_wait (state.curdepth);
+  while (pending >= DelqueueMaxPending)
+    collect (true);
+  dir = current_dir ();
+  if (!dir)
+    return false;
+
+  job = xmalloc (sizeof *job + pathsize + namesize);
+  job->pathname = (char *) (job + 1);
+  memcpy (job->pathname, pathname, pathsize);
+  job->name = job->pathname + pathsize;
+  memcpy (job->name, state.rel_pathname, namesize);
+  job->dir = dir;
+  dir->refs++;
+  job->flags = flags;
+  job->depth = state.curdepth;
+  job->err = 0;
+  job->next = NULL;
+
+  if ((size_t) job->depth >= ndepths)
+    {
+      size_t old = ndepths;
+      ndepths = (size_t) job->depth + 1u;
+      pending_at_depth = xnrealloc (pending_at_depth, ndepths,
+                                    sizeof *pending_at_depth);
+      memset (pending_at_depth + old, 0,
+              (ndepths - old) * sizeof *pending_at_depth);
+    }
+  pending_at_depth[job->depth]++;
+  pending++;
+
+  pthread_mutex_lock (&lock);
+  *todo_tail = job;
+  todo_tail = &job->next;
+  pthread_cond_signal (&work_ready);
+  finished = done;
+  done = NULL;
+  pthread_mutex_unlock (&lock);
+  reap (finished);
+  return true;
+}
+
+void
+delqueue_left_dir (void)
+{
+  if (cur_dir)
+    {
+      release_dir (cur_dir);
+      cur_dir = NULL;
+    }
+}
+
+void
+delqueue_finish (void)
+{
+  size_t i;
+
+  delqueue_wait (-1);
+  delqueue_left_dir ();
+  if (!nthreads)
+    return;
+
+  pthread_mutex_lock (&lock);
+  stopping = true;
+  pthread_cond_broadcast (&work_ready);
+  pthread_mutex_unlock (&lock);
+  for (i = 0; i < nthreads; i++)
+    pthread_join (threads[i], NULL);
+  nthreads = 0u;
+  stopping = false;
+
+  free (pending_at_depth);
+  pending_at_depth = NULL;
+  ndepths = 0u;
+}
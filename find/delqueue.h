@@ -0,0 +1,40 @@
+/* delqueue.h -- remove files for -delete on several threads at once.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef INC_DELQUEUE_H
+# define INC_DELQUEUE_H 1
+
+# include <stdbool.h>
+
+/* Queue the removal of the file being examined (state.rel_pathname in
+   state.cwd_dir_fd), called PATHNAME in diagnostics, with unlinkat
+   FLAGS.  If it may be a directory, first wait for the removal of
+   anything queued below it.  Return false if the file could not be
+   queued, in which case the caller should remove it itself.  */
+bool delqueue_unlink (const char *pathname, int flags);
+
+/* Wait for the removal of the files queued deeper than DEPTH (all of
+   them if DEPTH is negative), and report any failures.  */
+void delqueue_wait (int depth);
+
+/* Note that traversal has left the directory of the last file queued. */
+void delqueue_left_dir (void);
+
+/* Wait for all queued removals, and stop the threads doing them.
+   This is also run at exit, so calling it again does nothing.  */
+void delqueue_finish (void);
+
+#endif
@@ -22,21 +22,29 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
 
 /* gnulib headers */
 #include "cloexec.h"
 #include "dirname.h"
 #include "fcntl--.h"
+#include "safe-read.h"
 #include "save-cwd.h"
 #include "xalloc.h"
 
 /* findutils headers */
 #include "buildcmd.h"
+#include "cmdpath.h"
 #include "defs.h"
+#include "delqueue.h"
+#include "dircallback.h"
 #include "fdleak.h"
+#include "outseq.h"
 #include "system.h"
 
 
@@ -93,6 +101,261 @@ record_exec_dir (struct exec_val *execp)
 }
 
 
+/* -execdir ... + builds a separate argument list for each directory.
+ * The list for the directory of the file most recently visited is in
+ * the exec_val itself; the others are "parked" in batches until more
+ * files from their directory turn up (fts revisits a directory's files
+ * after descending into each of its subdirectories), the list is full,
+ * or find exits.  Each parked batch keeps a descriptor open on its
+ * directory, so at most ExecdirParkedMax are kept; beyond that, the
+ * least recently used one is run early.
+ */
+struct execdir_batch
+{
+  struct exec_val *execp;       /* The predicate this belongs to. */
+  struct buildcmd_state state;
+  struct saved_cwd *wd;
+  char *dir_key;
+  size_t dir_keylen;
+  size_t dir_keyalloc;
+  struct execdir_batch *older;  /* Parked list, or list of spares. */
+  struct execdir_batch *newer;
+};
+
+enum { ExecdirParkedMax = 32 };
+
+static struct execdir_batch *oldest_parked = NULL;
+static struct execdir_batch *newest_parked = NULL;
+static size_t parked_count = 0u;
+
+
+/* Exchange the argument list of EXECP with the one in B.  */
+static void
+swap_batch (struct exec_val *execp, struct execdir_batch *b)
+{
+  struct buildcmd_state state = execp->state;
+  struct saved_cwd *wd = execp->wd_for_exec;
+  char *key = execp->dir_key;
+  size_t keylen = execp->dir_keylen;
+  size_t keyalloc = execp->dir_keyalloc;
+
+  execp->state = b->state;
+  execp->wd_for_exec = b->wd;
+  execp->dir_key = b->dir_key;
+  execp->dir_keylen = b->dir_keylen;
+  execp->dir_keyalloc = b->dir_keyalloc;
+  b->state = state;
+  b->wd = wd;
+  b->dir_key = key;
+  b->dir_keylen = keylen;
+  b->dir_keyalloc = keyalloc;
+}
+
+/* Return a batch holding an empty argument list for EXECP.  */
+static struct execdir_batch *
+get_spare_batch (struct exec_val *execp)
+{
+  struct execdir_batch *b = execp->spare_batches;
+  size_t i;
+
+  if (b)
+    {
+      execp->spare_batches = b->older;
+      return b;
+    }
+
+  b = xmalloc (sizeof *b);
+  b->execp = execp;
+  b->wd = NULL;
+  b->dir_key = NULL;
+  b->dir_keylen = b->dir_keyalloc = 0u;
+  /* Copy the command and initial arguments from the list we have.  */
+  bc_init_state (&execp->ctl, &b->state, execp);
+  for (i = 0; i < execp->ctl.initial_argc; i++)
+    {
+      const char *arg = execp->state.cmd_argv[i];
+      bc_push_arg (&execp->ctl, &b->state, arg, strlen (arg) + 1, NULL, 0, 1);
+    }
+  return b;
+}
+
+static void
+park_batch (struct execdir_batch *b)
+{
+  b->older = newest_parked;
+  b->newer = NULL;
+  if (newest_parked)
+    newest_parked->newer = b;
+  else
+    oldest_parked = b;
+  newest_parked = b;
+  parked_count++;
+}
+
+static void
+unpark_batch (struct execdir_batch *b)
+{
+  if (b->older)
+    b->older->newer = b->newer;
+  else
+    oldest_parked = b->newer;
+  if (b->newer)
+    b->newer->older = b->older;
+  else
+    newest_parked = b->older;
+  parked_count--;
+}
+
+static int
+exec_cb (void *context)
+{
+  struct exec_val *execp = context;
+  bc_do_exec (&execp->ctl, &execp->state);
+  return 0;
+}
+
+/* Run the argument list of EXECP, if it is not empty, and forget its
+ * directory.
+ */
+static void
+run_current_batch (struct exec_val *execp)
+{
+  if (execp->state.todo)
+    run_in_dir (execp->wd_for_exec, exec_cb, execp);
+  if (execp->wd_for_exec && execp->wd_for_exec != initial_wd)
+    {
+      free_cwd (execp->wd_for_exec);
+      free (execp->wd_for_exec);
+    }
+  execp->wd_for_exec = NULL;
+  execp->dir_keylen = 0u;
+}
+
+/* Run the parked batch B and keep it as a spare.  */
+static void
+run_parked_batch (struct execdir_batch *b)
+{
+  struct exec_val *execp = b->execp;
+
+  unpark_batch (b);
+  swap_batch (execp, b);
+  run_current_batch (execp);
+  swap_batch (execp, b);
+  b->older = execp->spare_batches;
+  execp->spare_batches = b;
+}
+
+/* Return the name of the directory containing the file being visited,
+ * storing its length in *LEN.  Two files have the same one just when
+ * find reached them through the same directory, which -execdir then
+ * runs the command in.
+ */
+static const char *
+current_dir_key (size_t *len)
+{
+  if (state.path_base)
+    {
+      /* fts_path is the name of the directory, a slash (unless that
+       * name is "/") and the base name.
+       */
+      const char *path = state.path_base - state.path_dirlen - 1;
+      *len = state.path_dirlen ? state.path_dirlen : 1u;
+      return path;
+    }
+  else
+    {
+      /* A starting point, named relative to our initial directory
+       * just as the names fts builds below it are.
+       */
+      *len = dir_len (state.rel_pathname);
+      if (*len)
+        return state.rel_pathname;
+      *len = 1u;
+      return ".";
+    }
+}
+
+/* Make the argument list of EXECP the one for the directory of the
+ * file being visited, setting one aside or starting one as needed.
+ * Return false if we cannot open that directory.
+ */
+static bool
+select_execdir_batch (struct exec_val *execp)
+{
+  size_t len;
+  const char *dir = current_dir_key (&len);
+  struct execdir_batch *b;
+
+  if (execp->state.todo)
+    {
+      if (len == execp->dir_keylen && 0 == memcmp (dir, execp->dir_key, len))
+        return true;            /* The same directory as last time. */
+
+      b = get_spare_batch (execp);
+      swap_batch (execp, b);
+      park_batch (b);
+      if (parked_count > ExecdirParkedMax)
+        run_parked_batch (oldest_parked);
+    }
+
+  for (b = newest_parked; b; b = b->older)
+    {
+      if (b->execp == execp
+          && b->dir_keylen == len && 0 == memcmp (b->dir_key, dir, len))
+        {
+          /* Carry on with the list we set aside for this directory. */
+          unpark_batch (b);
+          swap_batch (execp, b);
+          b->older = execp->spare_batches;
+          execp->spare_batches = b;
+          return true;
+        }
+    }
+
+  while (!record_exec_dir (execp))
+    {
+      const int saved_errno = errno;
+
+      free (execp->wd_for_exec);
+      execp->wd_for_exec = NULL;
+      if ((saved_errno != EMFILE && saved_errno != ENFILE) || !oldest_parked)
+        {
+          errno = saved_errno;
+          return false;
+        }
+      /* Free up a descriptor.  */
+      run_parked_batch (oldest_parked);
+    }
+
+  if (execp->dir_keyalloc < len)
+    {
+      execp->dir_key = xrealloc (execp->dir_key, len);
+      execp->dir_keyalloc = len;
+    }
+  memcpy (execp->dir_key, dir, len);
+  execp->dir_keylen = len;
+  return true;
+}
+
+/* Run any arguments waiting for the -execdir ... + predicate EXECP,
+ * oldest first.
+ */
+void
+complete_execdir (struct exec_val *execp)
+{
+  struct execdir_batch *b = oldest_parked;
+
+  while (b)
+    {
+      struct execdir_batch *next = b->newer;
+      if (b->execp == execp)
+        run_parked_batch (b);
+      b = next;
+    }
+  run_current_batch (execp);
+}
+
+
 
 
 bool
@@ -102,6 +365,7 @@ impl_pred_exec (const char *pathname,
   struct exec_val *execp = &pred_ptr->args.exec_vec;
   char *buf = NULL;
   const char *target;
+  size_t targetlen;
   bool result;
   const bool local = is_exec_in_local_dir (pred_ptr->pred_func);
   const char *prefix;
@@ -114,7 +378,8 @@ impl_pred_exec (const char *pathname,
          the wd_for_exec member of struct exec_val.  So for those
          predicates, we do so now.
        */
-      if (!record_exec_dir (execp))
+      if (!(execp->multiple
+            ? select_execdir_batch (execp) : record_exec_dir (execp)))
         {
           error (EXIT_FAILURE, errno,
                  _("Failed to save working directory in order to "
@@ -146,6 +411,7 @@ impl_pred_exec (const char *pathname,
       prefix = NULL;
       pfxlen = 0u;
     }
+  targetlen = strlen (target);
 
   if (execp->multiple)
     {
@@ -155,7 +421,7 @@ impl_pred_exec (const char *pathname,
        */
       bc_push_arg (&execp->ctl,
                    &execp->state,
-                   target, strlen (target) + 1, prefix, pfxlen, 0);
+                   target, targetlen + 1, prefix, pfxlen, 0);
 
       /* remember that there are pending execdirs. */
       if (execp->state.todo)
@@ -174,9 +440,8 @@ impl_pred_exec (const char *pathname,
         {
           bc_do_insert (&execp->ctl,
                         &execp->state,
-                        execp->replace_vec[i],
-                        strlen (execp->replace_vec[i]),
-                        prefix, pfxlen, target, strlen (target), 0);
+                        &execp->replace_tpl[i],
+                        prefix, pfxlen, target, targetlen, 0);
         }
 
       /* Actually invoke the command. */
@@ -277,42 +542,333 @@ prep_child_for_exec (bool close_stdin, const struct saved_cwd *wd)
 }
 
 
-int
-launch (struct buildcmd_control *ctl, void *usercontext, int argc,
-        char **argv)
+/* The status we record for a command which could not be started.
+ * It is what we would see if a child created with fork called
+ * _exit (1), as fork_command does.
+ */
+#ifdef W_EXITCODE
+# define FAILED_COMMAND_STATUS W_EXITCODE (1, 0)
+#else
+# define FAILED_COMMAND_STATUS (1 << 8)
+#endif
+
+/* Commands started in the background, which have not yet been waited
+ * for.  There are only ever options.max_procs of these, so a small
+ * array does.
+ */
+struct running_command
 {
-  pid_t child_pid;
-  static int first_time = 1;
-  struct exec_val *execp = usercontext;
+  pid_t pid;
+  bool multiple;                /* Terminated by '+'. */
+  char *name;                   /* argv[0], for diagnostics. */
 
-  (void) ctl;                   /* silence compiler warning */
-  (void) argc;                  /* silence compiler warning */
+  /* With -batchtime, the command line's builder, when the command was
+   * started and how many arguments it was given; otherwise NULL.
+   */
+  struct buildcmd_control *ctl;
+  double started;
+  size_t nargs;
 
+  /* With -groupoutput, the pipe the command's standard output goes
+   * to (-1 once it has ended), the command's key in output_seq, and
+   * output read from the pipe which output_seq has not yet taken.
+   */
+  int out_fd;
+  uintmax_t out_key;
+  char *held;
+  size_t held_len;
+};
+
+static struct running_command *running = NULL;
+static size_t running_alloc = 0u;
+static size_t running_count = 0u;
+
+enum
+{
+  GroupOutputChunk = 4096,          /* read from a command at once */
+  GroupOutputLimit = 1024 * 1024    /* held back for all commands */
+};
+
+/* With -groupoutput, what keeps the output of each background command
+ * together; NULL before the first one starts.
+ */
+static struct outseq *output_seq = NULL;
+
+/* If not -1, the descriptor the command being started should have as
+ * its standard output.
+ */
+static int command_stdout = -1;
+
+static void hand_to_workers (pid_t pid, int status);
+
+
+/* Report on the termination of the command NAME with process ID PID
+ * and status STATUS.  As for -exec ... {} +, when MULTIPLE is true a
+ * failure sets the exit status of find.
+ */
+static void
+note_command_status (const char *name, bool multiple, pid_t pid, int status)
+{
+  if (WIFSIGNALED (status))
+    {
+      error (0, 0, _("%s terminated by signal %d"),
+             quotearg_n_style (0, options.err_quoting_style, name),
+             WTERMSIG (status));
+
+      if (multiple)
+        {
+          /* -exec   \; just returns false if the invoked command fails.
+           * -exec {} + returns true if the invoked command fails, but
+           *            sets the program exit status.
+           */
+          state.exit_status = EXIT_FAILURE;
+        }
+      return;
+    }
+
+  int ex = WEXITSTATUS (status);
   if (options.debug_options & DebugExec)
     {
-      int i;
-      fprintf (stderr, "DebugExec: launching process (argc=%" PRIuMAX "):",
-               (uintmax_t) execp->state.cmd_argc - 1);
-      for (i = 0; i < execp->state.cmd_argc - 1; ++i)
+      /* pid_t is of type long on Solaris 11.  Cast PID for use with
+       * %ld as long as gnulib doesn't provide portable PRIdPID. */
+      fprintf (stderr,
+               "DebugExec: process (PID=%ld) terminated with exit status: %d\n",
+               (long) pid, ex);
+    }
+
+  if (0 != ex && multiple)
+    {
+      /* See above. */
+      state.exit_status = EXIT_FAILURE;
+    }
+}
+
+/* Report on the background command running[I], which has exited with
+ * status STATUS, and forget it.
+ */
+static void
+retire_command (size_t i, int status)
+{
+  struct running_command *r = &running[i];
+
+  note_command_status (r->name, r->multiple, r->pid, status);
+  if (r->ctl)
+    bc_note_batch_time (r->ctl, r->nargs, bc_now () - r->started);
+  if (output_seq)
+    outseq_finish_task (output_seq, r->out_key);
+  free (r->name);
+  free (r->held);
+  running[i] = running[--running_count];
+}
+
+/* Give the output the background command R has produced to
+ * output_seq, or keep it for later if there is no room for it yet.
+ */
+static void
+offer_output (struct running_command *r)
+{
+  if (r->held_len
+      && outseq_write (output_seq, r->out_key, r->held, r->held_len))
+    r->held_len = 0u;
+}
+
+/* With -groupoutput, copy the output of the background commands to
+ * output_seq, and reap the commands whose output has ended.  If HANG
+ * is true, wait until at least one has, unless none are running.
+ *
+ * We do not read from a command whose last output output_seq has not
+ * taken, so it waits until there is room.  The command whose output
+ * is going straight to the stream can always go on, so one always can.
+ */
+static void
+pump_command_output (bool hang)
+{
+  static struct pollfd *pfd = NULL;
+  static size_t pfd_alloc = 0u;
+
+  while (running_count)
+    {
+      size_t i;
+      bool reaped = false;
+
+      if (pfd_alloc < running_count)
         {
-          fprintf (stderr, " %s",
-                   safely_quote_err_filename (0, execp->state.cmd_argv[i]));
+          pfd = xnrealloc (pfd, running_count, sizeof *pfd);
+          pfd_alloc = running_count;
         }
-      fprintf (stderr, "\n");
+      for (i = 0; i < running_count; i++)
+        {
+          offer_output (&running[i]);
+          /* poll ignores negative descriptors. */
+          pfd[i].fd = running[i].held_len ? -1 : running[i].out_fd;
+          pfd[i].events = POLLIN;
+          pfd[i].revents = 0;
+        }
+
+      if (poll (pfd, running_count, hang ? -1 : 0) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          error (EXIT_FAILURE, errno, _("error waiting for child process"));
+        }
+
+      for (i = 0; i < running_count; i++)
+        {
+          struct running_command *r = &running[i];
+          size_t n;
+
+          if (!pfd[i].revents)
+            continue;
+          n = safe_read (r->out_fd, r->held, GroupOutputChunk);
+          if (n == SAFE_READ_ERROR || n == 0)
+            {
+              if (n == SAFE_READ_ERROR)
+                error (0, errno, _("cannot read the output of %s"),
+                       quotearg_n_style (0, options.err_quoting_style,
+                                         r->name));
+              close (r->out_fd);
+              r->out_fd = -1;
+            }
+          else
+            {
+              r->held_len = n;
+              offer_output (r);
+            }
+        }
+
+      /* A command whose output has ended has exited, or is about to.
+       * Going downwards, the command moved into slot I by
+       * retire_command is one we have already looked at.
+       */
+      for (i = running_count; i-- > 0;)
+        {
+          int status;
+
+          if (running[i].out_fd >= 0)
+            continue;
+          while (waitpid (running[i].pid, &status, 0) == (pid_t) -1)
+            {
+              if (errno != EINTR)
+                {
+                  error (0, errno, _("error waiting for child process"));
+                  status = FAILED_COMMAND_STATUS;
+                  break;
+                }
+            }
+          retire_command (i, status);
+          reaped = true;
+        }
+
+      if (!hang || reaped)
+        return;
     }
+}
 
-  /* Make sure output of command doesn't get mixed with find output. */
-  fflush (stdout);
-  fflush (stderr);
+/* Reap the background commands which have finished.  If HANG is true,
+ * wait until at least one has, unless none are running.
+ */
+static void
+reap_running_commands (bool hang)
+{
+  if (output_seq)
+    {
+      pump_command_output (hang);
+      return;
+    }
 
-  /* Make sure to listen for the kids.  */
-  if (first_time)
+  while (running_count)
     {
-      first_time = 0;
-      signal (SIGCHLD, SIG_DFL);
+      int status;
+      size_t i;
+      pid_t pid = waitpid (-1, &status, hang ? 0 : WNOHANG);
+
+      if (pid == (pid_t) -1)
+        {
+          if (errno == EINTR)
+            continue;
+          error (0, errno, _("error waiting for child process"));
+          state.exit_status = EXIT_FAILURE;
+          /* Whatever went wrong, we cannot wait for these any more. */
+          while (running_count)
+            free (running[--running_count].name);
+          return;
+        }
+      if (pid == 0)
+        return;                 /* None has finished yet. */
+
+      for (i = 0; i < running_count && running[i].pid != pid; i++)
+        ;
+      if (i == running_count)
+        {
+          /* Perhaps an -execworker worker; if so, its pool reports on
+           * it when it notices that the worker has gone.
+           */
+          hand_to_workers (pid, status);
+          continue;
+        }
+
+      retire_command (i, status);
+      hang = false;
+    }
+}
+
+/* Wait until fewer than LIMIT background commands are running. */
+static void
+wait_for_slots (size_t limit)
+{
+  reap_running_commands (false);
+  while (running_count >= limit)
+    reap_running_commands (true);
+}
+
+/* Wait for every command started in the background to finish. */
+void
+wait_for_running_commands (void)
+{
+  wait_for_slots (1);
+  if (output_seq)
+    {
+      outseq_destroy (output_seq);
+      output_seq = NULL;
+    }
+}
+
+/* Run the last arguments for the -exec ... + predicate EXECP.  With
+ * -batchtime and -maxprocs, they are shared out among the slots which
+ * are free, so that a single command does not hold up the end.
+ */
+void
+complete_exec (struct exec_val *execp)
+{
+  if (execp->ctl.tuner.target > 0 && options.max_procs > 1)
+    {
+      size_t idle;
+
+      reap_running_commands (false);
+      idle = running_count < (size_t) options.max_procs
+        ? options.max_procs - running_count : 1u;
+      bc_do_exec_split (&execp->ctl, &execp->state, idle);
     }
+  else
+    bc_do_exec (&execp->ctl, &execp->state);
+}
 
-  child_pid = fork ();
+
+/* Start the command ARGV for EXECP in a child process created with
+ * fork, and return its process ID.
+ */
+static pid_t
+fork_command (struct exec_val *execp, char **argv)
+{
+  pid_t child_pid;
+  /* Search $PATH here, where the answer is remembered. */
+  const char *file = cmdpath_lookup (argv[0]);
+
+  /* If we run out of processes, wait for a command to finish and try
+   * again.
+   */
+  while ((child_pid = fork ()) == -1 && errno == EAGAIN && running_count)
+    reap_running_commands (true);
   if (child_pid == -1)
     {
       /* TRANSLATORS: fork is the name of a system call, and so it
@@ -327,7 +883,9 @@ launch (struct buildcmd_control *ctl, void *usercontext, int argc,
     {
       /* We are the child. */
       assert (NULL != execp->wd_for_exec);
-      if (!prep_child_for_exec (execp->close_stdin, execp->wd_for_exec))
+      if (!prep_child_for_exec (execp->close_stdin, execp->wd_for_exec)
+          || (command_stdout >= 0
+              && dup2 (command_stdout, STDOUT_FILENO) < 0))
         {
           _exit (1);
         }
@@ -342,11 +900,252 @@ launch (struct buildcmd_control *ctl, void *usercontext, int argc,
       if (bc_args_exceed_testing_limit (argv))
         errno = E2BIG;
       else
-        execvp (argv[0], argv);
+        execvp (file, argv);
       /* TODO: use a pipe to pass back the errno value, like xargs does */
       error (0, errno, "%s", safely_quote_err_filename (0, argv[0]));
       _exit (1);
     }
+  return child_pid;
+}
+
+/* Return a file descriptor open on /dev/null for use as the standard
+ * input of commands, or -1 if there is none.
+ */
+static int
+get_null_input (void)
+{
+  static int fd = -2;
+
+  if (fd == -2)
+    {
+      fd = open_cloexec ("/dev/null", O_RDONLY);
+      if (0 <= fd && fd <= STDERR_FILENO)
+        {
+          /* One of the standard descriptors was closed.  Making this
+           * descriptor the child's standard input would not clear its
+           * close-on-exec flag, so leave that case to fork_command.
+           */
+          close (fd);
+          fd = -1;
+        }
+    }
+  return fd;
+}
+
+/* Return true if the child setup needed for EXECP can be left to
+ * posix_spawn.  Otherwise we fall back on fork, so that the problem is
+ * diagnosed as it always has been.
+ */
+static bool
+can_spawn (const struct exec_val *execp)
+{
+  assert (NULL != execp->wd_for_exec);
+  if (execp->wd_for_exec->desc < 0 && NULL == execp->wd_for_exec->name)
+    return false;
+  return !execp->close_stdin || get_null_input () >= 0;
+}
+
+/* Add changing to the directory WD to ACTIONS.  Return zero or an
+ * error number.
+ */
+static int
+add_chdir_action (posix_spawn_file_actions_t *actions,
+                  const struct saved_cwd *wd)
+{
+  if (wd->desc >= 0)
+    return posix_spawn_file_actions_addfchdir (actions, wd->desc);
+  else
+    return posix_spawn_file_actions_addchdir (actions, wd->name);
+}
+
+/* Start ARGV with posix_spawnp and ACTIONS, and store its process ID
+ * in *PID.  Return zero or an error number.
+ */
+static int
+spawn_retrying (const posix_spawn_file_actions_t *actions, char **argv,
+                pid_t *pid)
+{
+  int err;
+  const char *file = cmdpath_lookup (argv[0]);
+
+  /* The child inherits exactly the descriptors we have open now. */
+  if (fd_leak_check_is_enabled ())
+    complain_about_leaky_fds ();
+
+  /* If we run out of processes, wait for a command to finish and try
+   * again.
+   */
+  while ((err = posix_spawnp (pid, file, actions, NULL, argv, environ))
+         == EAGAIN && running_count)
+    reap_running_commands (true);
+
+  /* Like execvp, run a file the system cannot execute as a shell
+   * script.
+   */
+  if (ENOEXEC == err)
+    {
+      char **script_argv = cmdpath_script_argv (file, argv);
+      while ((err = posix_spawn (pid, script_argv[0], actions, NULL,
+                                 script_argv, environ))
+             == EAGAIN && running_count)
+        reap_running_commands (true);
+      free (script_argv);
+    }
+  return err;
+}
+
+/* Start the command ARGV for EXECP with posix_spawnp, storing its
+ * process ID in *PID.  Unlike fork, this does not copy the address
+ * space of find, which can be large, so it is much cheaper.  Return
+ * zero if the command was started, and otherwise an error number.
+ */
+static int
+spawn_command (struct exec_val *execp, char **argv, pid_t *pid)
+{
+  posix_spawn_file_actions_t actions;
+  int err;
+
+  if (bc_args_exceed_testing_limit (argv))
+    return E2BIG;
+
+  err = posix_spawn_file_actions_init (&actions);
+  if (err)
+    return err;
+
+  if (execp->close_stdin)
+    err = posix_spawn_file_actions_adddup2 (&actions, get_null_input (),
+                                            STDIN_FILENO);
+  if (!err && command_stdout >= 0)
+    err = posix_spawn_file_actions_adddup2 (&actions, command_stdout,
+                                            STDOUT_FILENO);
+  if (!err)
+    err = add_chdir_action (&actions, execp->wd_for_exec);
+  if (!err)
+    err = spawn_retrying (&actions, argv, pid);
+
+  posix_spawn_file_actions_destroy (&actions);
+  return err;
+}
+
+
+int
+launch (struct buildcmd_control *ctl, void *usercontext, int argc,
+        char **argv)
+{
+  pid_t child_pid;
+  static int first_time = 1;
+  struct exec_val *execp = usercontext;
+  /* With -maxprocs, don't wait for commands whose result is not
+   * needed.  The others still take one of the available slots.
+   */
+  const bool background = options.max_procs > 1
+    && (execp->multiple || execp->status_unused);
+  /* Whether to time the command for the batch size tuner. */
+  const bool timed = execp->multiple && ctl->tuner.target > 0;
+  double started = 0.0;
+  /* With -groupoutput, the pipe for the output of a background
+   * command.
+   */
+  int out_pipe[2] = { -1, -1 };
+
+  (void) argc;                  /* silence compiler warning */
+
+  /* The command should not see files which -delete has dealt with. */
+  delqueue_wait (-1);
+
+  if (options.debug_options & DebugExec)
+    {
+      int i;
+      fprintf (stderr, "DebugExec: launching process (argc=%" PRIuMAX "):",
+               (uintmax_t) execp->state.cmd_argc - 1);
+      for (i = 0; i < execp->state.cmd_argc - 1; ++i)
+        {
+          fprintf (stderr, " %s",
+                   safely_quote_err_filename (0, execp->state.cmd_argv[i]));
+        }
+      fprintf (stderr, "\n");
+    }
+
+  /* Make sure output of command doesn't get mixed with find output. */
+  fflush (stdout);
+  fflush (stderr);
+
+  /* Make sure to listen for the kids.  */
+  if (first_time)
+    {
+      first_time = 0;
+      signal (SIGCHLD, SIG_DFL);
+    }
+
+  wait_for_slots (options.max_procs);
+
+  if (background && options.group_output != GROUP_OUTPUT_NONE)
+    {
+      if (!output_seq)
+        output_seq = outseq_create (stdout,
+                                    options.group_output == GROUP_OUTPUT_ORDERED
+                                    ? OUTSEQ_ORDERED : OUTSEQ_UNORDERED,
+                                    GroupOutputLimit);
+      if (pipe2 (out_pipe, O_CLOEXEC) != 0)
+        error (EXIT_FAILURE, errno, _("cannot create a pipe"));
+      command_stdout = out_pipe[1];
+    }
+
+  if (timed)
+    started = bc_now ();
+  if (can_spawn (execp))
+    {
+      int err = spawn_command (execp, argv, &child_pid);
+      if (err)
+        {
+          if (out_pipe[0] >= 0)
+            {
+              close (out_pipe[0]);
+              close (out_pipe[1]);
+              command_stdout = -1;
+            }
+          /* Report this as the child would have if we had used fork. */
+          error (0, err, "%s", safely_quote_err_filename (0, argv[0]));
+          if (execp->multiple)
+            state.exit_status = EXIT_FAILURE;
+          execp->last_child_status = FAILED_COMMAND_STATUS;
+          return 1;             /* FAIL (but don't try again) */
+        }
+    }
+  else
+    {
+      child_pid = fork_command (execp, argv);
+    }
+  if (out_pipe[1] >= 0)
+    {
+      /* The command has its own copy. */
+      close (out_pipe[1]);
+      command_stdout = -1;
+    }
+
+  if (background)
+    {
+      if (running_count == running_alloc)
+        running = x2nrealloc (running, &running_alloc, sizeof *running);
+      running[running_count].pid = child_pid;
+      running[running_count].multiple = execp->multiple;
+      running[running_count].name = xstrdup (argv[0]);
+      running[running_count].ctl = timed ? ctl : NULL;
+      running[running_count].started = started;
+      running[running_count].nargs = timed ? bc_batch_size (ctl, argv) : 0u;
+      running[running_count].out_fd = out_pipe[0];
+      running[running_count].out_key = output_seq
+        ? outseq_start_task (output_seq) : 0u;
+      running[running_count].held = output_seq
+        ? xmalloc (GroupOutputChunk) : NULL;
+      running[running_count].held_len = 0u;
+      running_count++;
+      /* The command has not finished, but as far as the caller is
+       * concerned it has succeeded.
+       */
+      execp->last_child_status = 0;
+      return 1;                 /* OK */
+    }
 
   while (waitpid (child_pid, &(execp->last_child_status), 0) == (pid_t) - 1)
     {
@@ -360,52 +1159,167 @@ launch (struct buildcmd_control *ctl, void *usercontext, int argc,
         }
     }
 
-  if (WIFSIGNALED (execp->last_child_status))
-    {
-      error (0, 0, _("%s terminated by signal %d"),
-             quotearg_n_style (0, options.err_quoting_style, argv[0]),
-             WTERMSIG (execp->last_child_status));
+  note_command_status (argv[0], execp->multiple, child_pid,
+                       execp->last_child_status);
+  if (timed)
+    bc_note_batch_time (ctl, bc_batch_size (ctl, argv), bc_now () - started);
 
-      if (execp->multiple)
-        {
-          /* -exec   \; just returns false if the invoked command fails.
-           * -exec {} + returns true if the invoked command fails, but
-           *            sets the program exit status.
-           */
-          state.exit_status = EXIT_FAILURE;
-        }
+  /* If the child failed, we still don't want to run it again, since
+   * this is the exec callback rather than a report of E2BIG.
+   */
+  return 1;                     /* OK */
+}
 
-      return 1;                 /* OK */
-    }
 
-  int ex = WEXITSTATUS (execp->last_child_status);
-  if (options.debug_options & DebugExec)
+/* -execworker sends file names to workers (see buildcmd.h).  When
+ * nothing uses the result of the action, up to options.max_procs
+ * workers are each sent several names before we wait for their
+ * statuses; otherwise one worker is sent one name at a time.
+ */
+struct exec_worker
+{
+  struct bc_worker_pool pool;
+  struct exec_val *execp;
+  bool started;
+  size_t lost;                  /* Names not reported on. */
+  struct exec_worker *next;
+};
+
+/* All the -execworker predicates. */
+static struct exec_worker *exec_workers = NULL;
+
+enum { WorkerPipelineDepth = 16 };
+
+static int
+prepare_worker (struct bc_worker_pool *pool, size_t slot,
+                posix_spawn_file_actions_t *actions)
+{
+  struct exec_worker *worker = pool->usercontext;
+
+  (void) slot;
+  return add_chdir_action (actions, worker->execp->wd_for_exec);
+}
+
+static int
+spawn_worker (struct bc_worker_pool *pool, size_t slot,
+              const posix_spawn_file_actions_t *actions, pid_t *pid)
+{
+  (void) slot;
+  return spawn_retrying (actions, pool->argv, pid);
+}
+
+static void
+note_worker_status (struct bc_worker_pool *pool, size_t slot, int status)
+{
+  struct exec_worker *worker = pool->usercontext;
+
+  (void) slot;
+  if (BC_WORKER_LOST == status)
     {
-      /* pid_t is of type long on Solaris 11.  Cast CHILD_PID for use with
-       * %ld as long as gnulib doesn't provide portable PRIdPID. */
-      fprintf (stderr,
-               "DebugExec: process (PID=%ld) terminated with exit status: %d\n",
-               (long) child_pid, ex);
+      worker->lost++;
+      status = 1;
     }
+  worker->execp->last_child_status = status;
+}
 
-  if (0 == ex)
+static void
+note_worker_exit (struct bc_worker_pool *pool, size_t slot, int wait_status)
+{
+  struct exec_worker *worker = pool->usercontext;
+  const char *name = pool->argv[0];
+
+  if (worker->lost)
     {
-      return 1;                 /* OK */
+      error (0, 0, _("%s exited without reporting on every file sent to it"),
+             quotearg_n_style (0, options.err_quoting_style, name));
+      state.exit_status = EXIT_FAILURE;
+      worker->lost = 0u;
     }
-  else
+  /* As for -exec ... {} +, a worker which fails makes find fail. */
+  note_command_status (name, true, pool->workers[slot].pid, wait_status);
+}
+
+/* Give the wait status STATUS of process PID, which reap_running_commands
+ * collected, to the -execworker pool it belongs to, if any.
+ */
+static void
+hand_to_workers (pid_t pid, int status)
+{
+  struct exec_worker *worker;
+
+  for (worker = exec_workers; worker; worker = worker->next)
+    if (bc_worker_pool_reaped (&worker->pool, pid, status))
+      return;
+}
+
+/* Set up EXECP for -execworker with the worker command in the ARGC
+ * elements of ARGV.
+ */
+void
+init_execworker (struct exec_val *execp, char **argv, int argc)
+{
+  struct exec_worker *worker = xmalloc (sizeof *worker);
+  char **cmd = xnmalloc (argc + 1, sizeof *cmd);
+
+  memcpy (cmd, argv, argc * sizeof *cmd);
+  cmd[argc] = NULL;
+  bc_worker_pool_init (&worker->pool, cmd, 1u, 1u, worker);
+  worker->pool.prepare = prepare_worker;
+  worker->pool.spawn = spawn_worker;
+  worker->pool.status_callback = note_worker_status;
+  worker->pool.exit_callback = note_worker_exit;
+  worker->execp = execp;
+  worker->started = false;
+  worker->lost = 0u;
+  worker->next = exec_workers;
+  exec_workers = worker;
+  execp->worker = worker;
+}
+
+bool
+impl_pred_execworker (const char *pathname, struct stat *stat_buf,
+                      struct predicate *pred_ptr)
+{
+  struct exec_val *execp = &pred_ptr->args.exec_vec;
+  struct exec_worker *worker = execp->worker;
+  int err;
+
+  (void) stat_buf;
+  if (!worker->started)
     {
-      if (execp->multiple)
+      /* Make sure to listen for the kids.  */
+      signal (SIGCHLD, SIG_DFL);
+      if (execp->status_unused)
         {
-          /* -exec   \; just returns false if the invoked command fails.
-           * -exec {} + returns true if the invoked command fails, but
-           *            sets the program exit status.
-           */
-          state.exit_status = EXIT_FAILURE;
+          worker->pool.max_workers = options.max_procs;
+          worker->pool.max_pending = WorkerPipelineDepth;
         }
-      /* The child failed, but this is the exec callback.  We
-       * don't want to run the child again in this case anwyay.
-       */
-      return 1;                 /* FAIL (but don't try again) */
+      worker->started = true;
+    }
+
+  if (options.debug_options & DebugExec)
+    fprintf (stderr, "DebugExec: sending %s to %s\n",
+             safely_quote_err_filename (0, pathname),
+             safely_quote_err_filename (1, worker->pool.argv[0]));
+
+  /* Make sure output of the worker doesn't get mixed with find output. */
+  fflush (stdout);
+  err = bc_worker_pool_send (&worker->pool, pathname, strlen (pathname) + 1);
+  if (err)
+    {
+      /* Report this as we would for -exec. */
+      error (0, err, "%s", safely_quote_err_filename (0, worker->pool.argv[0]));
+      return false;
     }
+  if (execp->status_unused)
+    return true;
+  bc_worker_pool_wait (&worker->pool);
+  return 0 == execp->last_child_status;
+}
 
+/* Wait for the workers of EXECP to finish. */
+void
+complete_execworker (struct exec_val *execp)
+{
+  bc_worker_pool_finish (&execp->worker->pool);
 }
@@ -52,8 +52,10 @@
 
 /* find headers. */
 #include "defs.h"
+#include "delqueue.h"
 #include "dircallback.h"
 #include "fdleak.h"
+#include "inodeset.h"
 #include "unused-result.h"
 #include "system.h"
 
@@ -67,6 +69,9 @@ static int ftsoptions =
 static int prev_depth = INT_MIN;        /* fts_level can be < 0 */
 static int curr_fd = -1;
 
+/* Multiply-linked files already visited, for -links-once. */
+static struct inode_set *links_seen = NULL;
+
 
 static bool
 find (char *arg)
@@ -78,6 +83,7 @@ find (char *arg)
 
      static void left_dir (void)
 {
+  delqueue_left_dir ();
   if (ftsoptions & FTS_CWDFD)
     {
       if (curr_fd >= 0)
@@ -172,6 +178,20 @@ visit (FTS *p, FTSENT *ent, struct stat *pstat)
   state.rel_pathname = ent->fts_accpath;
   state.cwd_dir_fd = p->fts_cwd_fd;
 
+  /* Below the starting point, fts_path is the parent's path, a slash
+   * (unless the parent's path already ends in one) and fts_name.
+   */
+  if (ent->fts_level > FTS_ROOTLEVEL)
+    {
+      state.path_base = ent->fts_path + ent->fts_pathlen - ent->fts_namelen;
+      state.path_dirlen = ent->fts_pathlen - ent->fts_namelen - 1;
+    }
+  else
+    {
+      state.path_base = NULL;
+      state.path_dirlen = 0;
+    }
+
   /* Apply the predicates to this path. */
   eval_tree = get_eval_tree ();
   apply_predicate (ent->fts_path, pstat, eval_tree);
@@ -427,6 +447,19 @@ consider_visiting (FTS *p, FTSENT *ent)
       ignore = 1;
     }
 
+  /* With -links-once, only the first name of a multiply-linked file
+   * is visited.  Directories are exempt since their link count says
+   * nothing about other names.
+   */
+  if (!ignore && options.links_once && !isdir && state.have_stat
+      && statbuf.st_nlink > 1)
+    {
+      if (!links_seen)
+        links_seen = inode_set_create ();
+      if (!inode_set_insert (links_seen, statbuf.st_dev, statbuf.st_ino))
+        ignore = 1;
+    }
+
   if (options.debug_options & DebugSearch)
     fprintf (stderr,
              "consider_visiting (late): %s: "
@@ -483,6 +516,10 @@ find (char *arg)
   if (options.xdev)
     ftsoptions |= FTS_XDEV;
 
+  /* -links-once needs the link count of every file. */
+  if (options.links_once)
+    ftsoptions &= ~FTS_NOSTAT;
+
   p = fts_open (arglist, ftsoptions, NULL);
   if (NULL == p)
     {
@@ -492,24 +529,10 @@ find (char *arg)
     }
   else
     {
-      int level = INT_MIN;
-
       while ((errno = 0, ent = fts_read (p)) != NULL)
         {
-          if (state.execdirs_outstanding && ((int) ent->fts_level != level))
-            {
-              /* If we changed level, perform any outstanding
-               * execdirs.  If we see a sequence of directory entries
-               * like this: fffdfffdfff, we could build a command line
-               * of 9 files, but this simple-minded implementation
-               * builds a command line for only 3 files at a time
-               * (since fts descends into the directories).
-               */
-              complete_pending_execdirs ();
-            }
-          level = (int) ent->fts_level;
-
           state.already_issued_stat_error_msg = false;
+          forget_link_target ();
           state.have_stat = false;
           state.have_type = !!ent->fts_statp->st_mode;
           state.type = state.have_type ? ent->fts_statp->st_mode : 0;
@@ -724,6 +747,7 @@ main (int argc, char **argv)
   record_initial_cwd ();
 
   state.already_issued_stat_error_msg = false;
+  state.have_link_target = state.have_target_stat = false;
   state.exit_status = EXIT_SUCCESS;
   state.execdirs_outstanding = false;
   state.cwd_dir_fd = AT_FDCWD;
@@ -789,6 +813,8 @@ main (int argc, char **argv)
       show_success_rates (eval_tree);
       cleanup ();
     }
+  inode_set_free (links_seen);
+  links_seen = NULL;
   return state.exit_status;
 }
 
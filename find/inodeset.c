@@ -0,0 +1,163 @@
+/* inodeset.c -- a compact set of (device, inode) pairs.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* A hard-linked tree (as made by backup tools such as rsnapshot) can
+ * contain millions of names for the same inodes, so we don't want to
+ * spend a separate allocation on every member as the gnulib hash
+ * module would.  Instead, the pairs are kept in a single open-addressed
+ * array, with a bitmap recording which slots are in use (any inode
+ * number, including zero, is a valid key).
+ */
+
+/* config.h always comes first. */
+#include <config.h>
+
+/* system headers. */
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+/* gnulib headers. */
+#include "xalloc.h"
+
+/* find headers. */
+#include "inodeset.h"
+
+
+enum
+{
+  InitialSlots = 64                 /* must be a power of two */
+};
+
+struct inode_key
+{
+  dev_t dev;
+  ino_t ino;
+};
+
+struct inode_set
+{
+  struct inode_key *slots;
+  unsigned char *used;          /* bitmap, one bit per slot */
+  size_t nslots;
+  size_t count;
+};
+
+#define SLOT_USED(set, i) ((set)->used[(i) / CHAR_BIT] & (1u << ((i) % CHAR_BIT)))
+#define MARK_USED(set, i) ((set)->used[(i) / CHAR_BIT] |= (1u << ((i) % CHAR_BIT)))
+
+
+static size_t
+slot_of (const struct inode_set *set, dev_t dev, ino_t ino)
+{
+  /* Inode numbers are often allocated sequentially, so mix the bits
+     before reducing the value to a slot number.  */
+  uint_fast64_t h = (uint_fast64_t) ino ^ ((uint_fast64_t) dev << 29);
+  h *= UINT64_C (0x9E3779B97F4A7C15);
+  return (size_t) (h >> 32) & (set->nslots - 1);
+}
+
+static void
+allocate_slots (struct inode_set *set, size_t nslots)
+{
+  set->nslots = nslots;
+  set->slots = xnmalloc (nslots, sizeof *set->slots);
+  set->used = xzalloc ((nslots + CHAR_BIT - 1) / CHAR_BIT);
+}
+
+/* Add (DEV, INO) to SET, which is known not to contain it and to have
+   room for it.  */
+static void
+place (struct inode_set *set, dev_t dev, ino_t ino)
+{
+  size_t i = slot_of (set, dev, ino);
+  while (SLOT_USED (set, i))
+    i = (i + 1) & (set->nslots - 1);
+  set->slots[i].dev = dev;
+  set->slots[i].ino = ino;
+  MARK_USED (set, i);
+}
+
+static void
+grow (struct inode_set *set)
+{
+  struct inode_key *old_slots = set->slots;
+  unsigned char *old_used = set->used;
+  size_t old_nslots = set->nslots;
+  size_t i;
+
+  if (old_nslots > SIZE_MAX / 2 / sizeof *old_slots)
+    xalloc_die ();
+  allocate_slots (set, old_nslots * 2);
+  for (i = 0; i < old_nslots; ++i)
+    {
+      if (old_used[i / CHAR_BIT] & (1u << (i % CHAR_BIT)))
+        place (set, old_slots[i].dev, old_slots[i].ino);
+    }
+  free (old_slots);
+  free (old_used);
+}
+
+
+struct inode_set *
+inode_set_create (void)
+{
+  struct inode_set *set = xmalloc (sizeof *set);
+  allocate_slots (set, InitialSlots);
+  set->count = 0;
+  return set;
+}
+
+bool
+inode_set_insert (struct inode_set *set, dev_t dev, ino_t ino)
+{
+  size_t i = slot_of (set, dev, ino);
+
+  while (SLOT_USED (set, i))
+    {
+      if (set->slots[i].ino == ino && set->slots[i].dev == dev)
+        return false;
+      i = (i + 1) & (set->nslots - 1);
+    }
+
+  /* Keep the load factor at or below 3/4.  */
+  if (4 * (set->count + 1) > 3 * set->nslots)
+    {
+      grow (set);
+      place (set, dev, ino);
+    }
+  else
+    {
+      set->slots[i].dev = dev;
+      set->slots[i].ino = ino;
+      MARK_USED (set, i);
+    }
+  ++set->count;
+  return true;
+}
+
+void
+inode_set_free (struct inode_set *set)
+{
+  if (set)
+    {
+      free (set->slots);
+      free (set->used);
+      free (set);
+    }
+}
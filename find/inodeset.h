@@ -0,0 +1,32 @@
+/* inodeset.h -- a compact set of (device, inode) pairs.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef INC_INODESET_H
+# define INC_INODESET_H 1
+
+# include <stdbool.h>
+# include <sys/types.h>
+
+struct inode_set;
+
+struct inode_set *inode_set_create (void);
+
+/* Add (DEV, INO) to SET.  Return true if it was not already present.  */
+bool inode_set_insert (struct inode_set *set, dev_t dev, ino_t ino);
+
+void inode_set_free (struct inode_set *set);
+
+#endif
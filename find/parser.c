@@ -45,6 +45,7 @@
 #include "selinux-at.h"
 #include "splitstring.h"
 #include "stat-time.h"
+#include "timespec.h"
 #include "xalloc.h"
 #include "xstrtod.h"
 #include "xstrtol.h"
@@ -60,6 +61,7 @@
 
 /* find headers. */
 #include "buildcmd.h"
+#include "columns.h"
 #include "defs.h"
 #include "fdleak.h"
 #include "findutils-version.h"
@@ -94,6 +96,10 @@ static bool parse_and (const struct parser_table *, char *argv[],
                        int *arg_ptr);
 static bool parse_anewer (const struct parser_table *, char *argv[],
                           int *arg_ptr);
+static bool parse_chmod (const struct parser_table *, char *argv[],
+                         int *arg_ptr);
+static bool parse_chown (const struct parser_table *, char *argv[],
+                         int *arg_ptr);
 static bool parse_cmin (const struct parser_table *, char *argv[],
                         int *arg_ptr);
 static bool parse_cnewer (const struct parser_table *, char *argv[],
@@ -113,6 +119,8 @@ static bool parse_exec (const struct parser_table *, char *argv[],
                         int *arg_ptr);
 static bool parse_execdir (const struct parser_table *, char *argv[],
                            int *arg_ptr);
+static bool parse_execworker (const struct parser_table *, char *argv[],
+                              int *arg_ptr);
 static bool parse_false (const struct parser_table *, char *argv[],
                          int *arg_ptr);
 static bool parse_files0_from (const struct parser_table *, char *argv[],
@@ -127,6 +135,10 @@ static bool parse_fprint (const struct parser_table *, char *argv[],
                           int *arg_ptr);
 static bool parse_fprint0 (const struct parser_table *, char *argv[],
                            int *arg_ptr);
+static bool parse_fprintcolumns (const struct parser_table *, char *argv[],
+                                 int *arg_ptr);
+static bool parse_fprint_fields (const struct parser_table *, char *argv[],
+                                 int *arg_ptr);
 static bool parse_fstype (const struct parser_table *, char *argv[],
                           int *arg_ptr);
 static bool parse_gid (const struct parser_table *, char *argv[],
@@ -145,20 +157,32 @@ static bool parse_iregex (const struct parser_table *, char *argv[],
                           int *arg_ptr);
 static bool parse_iwholename (const struct parser_table *, char *argv[],
                               int *arg_ptr);
+static bool parse_links_once (const struct parser_table *, char *argv[],
+                             int *arg_ptr);
 static bool parse_links (const struct parser_table *, char *argv[],
                          int *arg_ptr);
+static bool parse_linkto (const struct parser_table *, char *argv[],
+                          int *arg_ptr);
 static bool parse_lname (const struct parser_table *, char *argv[],
                          int *arg_ptr);
 static bool parse_ls (const struct parser_table *, char *argv[],
                       int *arg_ptr);
 static bool parse_maxdepth (const struct parser_table *, char *argv[],
                             int *arg_ptr);
+static bool parse_groupoutput (const struct parser_table *, char *argv[],
+                               int *arg_ptr);
+static bool parse_maxprocs (const struct parser_table *, char *argv[],
+                            int *arg_ptr);
+static bool parse_batchtime (const struct parser_table *, char *argv[],
+                             int *arg_ptr);
 static bool parse_mindepth (const struct parser_table *, char *argv[],
                             int *arg_ptr);
 static bool parse_mmin (const struct parser_table *, char *argv[],
                         int *arg_ptr);
 static bool parse_mount (const struct parser_table *, char *argv[],
                          int *arg_ptr);
+static bool parse_moveto (const struct parser_table *, char *argv[],
+                          int *arg_ptr);
 static bool parse_name (const struct parser_table *, char *argv[],
                         int *arg_ptr);
 static bool parse_negate (const struct parser_table *, char *argv[],
@@ -189,6 +213,8 @@ static bool parse_print0 (const struct parser_table *, char *argv[],
                           int *arg_ptr);
 static bool parse_printf (const struct parser_table *, char *argv[],
                           int *arg_ptr);
+static bool parse_print_fields (const struct parser_table *, char *argv[],
+                                int *arg_ptr);
 static bool parse_prune (const struct parser_table *, char *argv[],
                          int *arg_ptr);
 static bool parse_regex (const struct parser_table *, char *argv[],
@@ -201,6 +227,8 @@ static bool parse_size (const struct parser_table *, char *argv[],
                         int *arg_ptr);
 static bool parse_time (const struct parser_table *, char *argv[],
                         int *arg_ptr);
+static bool parse_touch (const struct parser_table *, char *argv[],
+                         int *arg_ptr);
 static bool parse_true (const struct parser_table *, char *argv[],
                         int *arg_ptr);
 static bool parse_type (const struct parser_table *, char *argv[],
@@ -280,12 +308,16 @@ static struct parser_table const parse_entry_newerXY = {
 
 static struct parser_table const parse_table[] = {
   /* Regular options: no PRED function.  */
+  {ARG_OPTION, "batchtime", parse_batchtime, NULL},     /* GNU */
   {ARG_OPTION, "d", parse_d, NULL},     /* Mac OS X, FreeBSD, NetBSD, OpenBSD */
   /* but deprecated in favour of -depth */
   {ARG_OPTION, "depth", parse_depth, NULL},     /* POSIX */
   {ARG_OPTION, "files0-from", parse_files0_from, NULL}, /* GNU */
+  {ARG_OPTION, "groupoutput", parse_groupoutput, NULL}, /* GNU */
   {ARG_OPTION, "ignore_readdir_race", parse_ignore_race, NULL}, /* GNU */
+  {ARG_OPTION, "links-once", parse_links_once, NULL},   /* GNU */
   {ARG_OPTION, "maxdepth", parse_maxdepth, NULL},       /* GNU */
+  {ARG_OPTION, "maxprocs", parse_maxprocs, NULL},       /* GNU */
   {ARG_OPTION, "mindepth", parse_mindepth, NULL},       /* GNU */
   {ARG_OPTION, "mount", parse_mount, NULL},     /* POSIX */
   {ARG_OPTION, "noleaf", parse_noleaf, NULL},   /* GNU */
@@ -359,21 +391,32 @@ static struct parser_table const parse_table[] = {
   {ARG_TEST, "xtype", parse_xtype, pred_xtype}, /* GNU */
 
   /* Actions.  */
+  {ARG_ACTION, "chmod", parse_chmod, pred_chmod},       /* GNU */
+  {ARG_ACTION, "chown", parse_chown, pred_chown},       /* GNU */
   {ARG_ACTION, "delete", parse_delete, pred_delete},    /* GNU, Mac OS, FreeBSD */
   {ARG_ACTION, "exec", parse_exec, pred_exec},  /* POSIX */
   {ARG_ACTION, "execdir", parse_execdir, pred_execdir}, /* *BSD, GNU */
+  {ARG_ACTION, "execworker", parse_execworker, pred_execworker},        /* GNU */
   {ARG_ACTION, "fls", parse_fls, pred_fls},     /* GNU */
   {ARG_ACTION, "fprint", parse_fprint, pred_fprint},    /* GNU */
   {ARG_ACTION, "fprint0", parse_fprint0, pred_fprint0}, /* GNU */
+  {ARG_ACTION, "fprintcolumns", parse_fprintcolumns, pred_fprintcolumns},       /* GNU */
   {ARG_ACTION, "fprintf", parse_fprintf, pred_fprintf}, /* GNU */
+  {ARG_ACTION, "fprintjson", parse_fprint_fields, pred_fprintjson},     /* GNU */
+  {ARG_ACTION, "fprinttlv", parse_fprint_fields, pred_fprinttlv},       /* GNU */
+  {ARG_ACTION, "linkto", parse_linkto, pred_linkto},    /* GNU */
   {ARG_ACTION, "ls", parse_ls, pred_ls},        /* GNU, Unix */
+  {ARG_ACTION, "moveto", parse_moveto, pred_moveto},    /* GNU */
   {ARG_ACTION, "ok", parse_ok, pred_ok},        /* POSIX */
   {ARG_ACTION, "okdir", parse_okdir, pred_okdir},       /* GNU (-execdir is BSD) */
   {ARG_ACTION, "print", parse_print, pred_print},       /* POSIX */
   {ARG_ACTION, "print0", parse_print0, pred_print0},    /* GNU */
   {ARG_ACTION, "printf", parse_printf, pred_fprintf},   /* GNU */
+  {ARG_ACTION, "printjson", parse_print_fields, pred_fprintjson},       /* GNU */
+  {ARG_ACTION, "printtlv", parse_print_fields, pred_fprinttlv}, /* GNU */
   {ARG_ACTION, "prune", parse_prune, pred_prune},       /* POSIX */
   {ARG_ACTION, "quit", parse_quit, pred_quit},  /* GNU */
+  {ARG_ACTION, "touch", parse_touch, pred_touch},       /* GNU */
 
 #ifdef UNIMPLEMENTED_UNIX
   /* It's pretty ugly for find to know about archive formats.
@@ -865,6 +908,126 @@ parse_anewer (const struct parser_table *entry, char **argv, int *arg_ptr)
   return false;
 }
 
+static bool
+parse_chmod (const struct parser_table *entry, char **argv, int *arg_ptr)
+{
+  const char *mode_expr;
+  struct mode_change *change;
+  struct predicate *our_pred;
+  mode_t umask_value;
+
+  if (!collect_arg (argv, arg_ptr, &mode_expr))
+    return false;
+
+  change = mode_compile (mode_expr);
+  if (NULL == change)
+    {
+      error (EXIT_FAILURE, 0, _("invalid file mode %s"),
+             quotearg_n_style (0, options.err_quoting_style, mode_expr));
+    }
+  umask_value = umask (0);
+  umask (umask_value);
+
+  our_pred = insert_primary (entry, mode_expr);
+  our_pred->side_effects = our_pred->no_default_print = true;
+  /* pred_chmod needs the current mode to work out the new one. */
+  our_pred->need_stat = true;
+  our_pred->args.chmod.change = change;
+  our_pred->args.chmod.umask = umask_value;
+  our_pred->est_success_rate = 1.0f;
+  return true;
+}
+
+/* Parse the OWNER[:GROUP] argument of -chown as chown(1) does, except
+   that the separator may only be a colon.  An empty OWNER leaves the
+   owner as it is, and an empty GROUP after the colon means OWNER's
+   login group.  */
+static bool
+parse_chown (const struct parser_table *entry, char **argv, int *arg_ptr)
+{
+  const char *spec;
+  const char *colon;
+  char *owner;
+  struct predicate *our_pred;
+  uid_t uid = -1;
+  gid_t gid = -1;
+  gid_t login_gid = -1;
+
+  if (!collect_arg (argv, arg_ptr, &spec))
+    return false;
+
+  colon = strchr (spec, ':');
+  owner = colon ? xmemdup0 (spec, colon - spec) : xstrdup (spec);
+  if (*owner)
+    {
+      struct passwd *cur_pwd = getpwnam (owner);
+      endpwent ();
+      if (cur_pwd != NULL)
+        {
+          uid = cur_pwd->pw_uid;
+          login_gid = cur_pwd->pw_gid;
+        }
+      else
+        {
+          uintmax_t num;
+          if ((xstrtoumax (owner, NULL, 10, &num, "") != LONGINT_OK)
+              || (UID_T_MAX <= num))
+            {
+              error (EXIT_FAILURE, 0,
+                     _("invalid user name or UID argument to -chown: %s"),
+                     quotearg_n_style (0, options.err_quoting_style, spec));
+            }
+          uid = num;
+        }
+    }
+  free (owner);
+
+  if (colon && colon[1])
+    {
+      const char *groupname = colon + 1;
+      struct group *cur_gr = getgrnam (groupname);
+      endgrent ();
+      if (cur_gr != NULL)
+        {
+          gid = cur_gr->gr_gid;
+        }
+      else
+        {
+          uintmax_t num;
+          if ((xstrtoumax (groupname, NULL, 10, &num, "") != LONGINT_OK)
+              || (GID_T_MAX <= num))
+            {
+              error (EXIT_FAILURE, 0,
+                     _("invalid group name or GID argument to -chown: %s"),
+                     quotearg_n_style (0, options.err_quoting_style, spec));
+            }
+          gid = num;
+        }
+    }
+  else if (colon && colon != spec)
+    {
+      /* As with chown, "OWNER:" means OWNER's login group.  */
+      if (login_gid == (gid_t) -1)
+        {
+          error (EXIT_FAILURE, 0,
+                 _("-chown %s names no user whose login group to use"),
+                 quotearg_n_style (0, options.err_quoting_style, spec));
+        }
+      gid = login_gid;
+    }
+
+  /* As with chown, ":" alone changes nothing; pred_chown then just
+     returns true.  */
+  our_pred = insert_primary (entry, spec);
+  our_pred->side_effects = our_pred->no_default_print = true;
+  /* pred_chown leaves files which already have the right owner alone. */
+  our_pred->need_stat = true;
+  our_pred->args.chown.uid = uid;
+  our_pred->args.chown.gid = gid;
+  our_pred->est_success_rate = 1.0f;
+  return true;
+}
+
 bool
 parse_closeparen (const struct parser_table *entry, char **argv, int *arg_ptr)
 {
@@ -958,6 +1121,8 @@ parse_delete (const struct parser_table *entry, char *argv[], int *arg_ptr)
    * (errno==EISDIR) in pred_delete.
    */
   our_pred->need_stat = our_pred->need_type = false;
+  /* Set by build_expression_tree once the whole expression is known. */
+  our_pred->args.status_unused = false;
 
   our_pred->est_success_rate = 1.0f;
   return true;
@@ -1011,6 +1176,13 @@ parse_execdir (const struct parser_table *entry, char **argv, int *arg_ptr)
   return insert_exec_ok ("-execdir", entry, argv, arg_ptr);
 }
 
+static bool
+parse_execworker (const struct parser_table *entry, char **argv,
+                  int *arg_ptr)
+{
+  return insert_exec_ok ("-execworker", entry, argv, arg_ptr);
+}
+
 static bool
 insert_false (void)
 {
@@ -1132,6 +1304,37 @@ parse_fprint0 (const struct parser_table *entry, char **argv, int *arg_ptr)
   return false;
 }
 
+static bool
+parse_fprintcolumns (const struct parser_table *entry, char **argv,
+                     int *arg_ptr)
+{
+  const char *filename;
+  const char *spec;
+  int saved_argc = *arg_ptr;
+
+  if (collect_arg (argv, arg_ptr, &filename)
+      && collect_arg (argv, arg_ptr, &spec))
+    {
+      struct format_val fmt;
+      struct predicate *our_pred;
+      bool need_stat;
+
+      open_output_file (filename, &fmt);
+      /* The column writer keeps the stream.  */
+      if (fmt.shared)
+        sharefile_keep_open (fmt.shared);
+      our_pred = insert_primary (entry, spec);
+      our_pred->side_effects = our_pred->no_default_print = true;
+      our_pred->args.column_writer =
+        column_writer_create (fmt.stream, fmt.filename, spec, &need_stat);
+      our_pred->need_stat = need_stat;
+      our_pred->need_type = false;
+      return true;
+    }
+  *arg_ptr = saved_argc;        /* don't consume the invalid argument. */
+  return false;
+}
+
 static float
 estimate_fstype_success_rate (const char *fsname)
 {
@@ -1391,6 +1594,49 @@ parse_links (const struct parser_table *entry, char **argv, int *arg_ptr)
   return false;
 }
 
+static bool
+parse_links_once (const struct parser_table *entry, char **argv,
+                  int *arg_ptr)
+{
+  options.links_once = true;
+  return parse_noop (entry, argv, arg_ptr);
+}
+
+/* Open the directory named by the argument of -moveto or -linkto, so
+   that files can be moved or linked into it however deep in the tree
+   we are.  */
+static bool
+insert_target_dir (const struct parser_table *entry, char **argv,
+                   int *arg_ptr)
+{
+  const char *dirname;
+  struct predicate *our_pred;
+  int fd;
+
+  if (!collect_arg (argv, arg_ptr, &dirname))
+    return false;
+
+  fd = open_cloexec (dirname, O_RDONLY | O_DIRECTORY | O_NOCTTY);
+  if (fd < 0)
+    fatal_nontarget_file_error (errno, dirname);
+
+  our_pred = insert_primary (entry, dirname);
+  our_pred->side_effects = our_pred->no_default_print = true;
+  /* Neither rename nor link follows a symbolic link, so we do not
+     need to know what the file is.  */
+  our_pred->need_stat = our_pred->need_type = false;
+  our_pred->args.target.name = dirname;
+  our_pred->args.target.fd = fd;
+  our_pred->est_success_rate = 1.0f;
+  return true;
+}
+
+static bool
+parse_linkto (const struct parser_table *entry, char **argv, int *arg_ptr)
+{
+  return insert_target_dir (entry, argv, arg_ptr);
+}
+
 static bool
 parse_lname (const struct parser_table *entry, char **argv, int *arg_ptr)
 {
@@ -1458,6 +1704,81 @@ parse_mindepth (const struct parser_table *entry, char **argv, int *arg_ptr)
   return insert_depthspec (entry, argv, arg_ptr, &options.mindepth);
 }
 
+static bool
+parse_maxprocs (const struct parser_table *entry, char **argv, int *arg_ptr)
+{
+  const char *arg;
+  const char *predicate = argv[(*arg_ptr) - 1];
+
+  if (collect_arg (argv, arg_ptr, &arg))
+    {
+      size_t len = strspn (arg, "0123456789");
+      if (len > 0 && arg[len] == 0)
+        {
+          options.max_procs = safe_atoi (arg, options.err_quoting_style);
+          if (options.max_procs > 0)
+            return parse_noop (entry, argv, arg_ptr);
+        }
+      error (EXIT_FAILURE, 0,
+             _("Expected a positive decimal integer argument to %s, but got %s"),
+             predicate, quotearg_n_style (0, options.err_quoting_style, arg));
+      /*NOTREACHED*/
+      return false;
+    }
+  /* missing argument */
+  return false;
+}
+
+static bool
+parse_groupoutput (const struct parser_table *entry, char **argv,
+                   int *arg_ptr)
+{
+  const char *arg;
+
+  if (collect_arg (argv, arg_ptr, &arg))
+    {
+      if (0 == strcmp (arg, "ordered"))
+        options.group_output = GROUP_OUTPUT_ORDERED;
+      else if (0 == strcmp (arg, "unordered"))
+        options.group_output = GROUP_OUTPUT_UNORDERED;
+      else
+        error (EXIT_FAILURE, 0,
+               _("The argument to -groupoutput must be 'ordered' or "
+                 "'unordered', but got %s"),
+               quotearg_n_style (0, options.err_quoting_style, arg));
+      return parse_noop (entry, argv, arg_ptr);
+    }
+  /* missing argument */
+  return false;
+}
+
+static bool
+parse_batchtime (const struct parser_table *entry, char **argv, int *arg_ptr)
+{
+  const char *arg;
+  const char *predicate = argv[(*arg_ptr) - 1];
+
+  if (collect_arg (argv, arg_ptr, &arg))
+    {
+      const char *end;
+      double seconds;
+
+      if (xstrtod (arg, &end, &seconds, strtod) && *end == 0 && seconds > 0)
+        {
+          options.batch_time = seconds;
+          return parse_noop (entry, argv, arg_ptr);
+        }
+      error (EXIT_FAILURE, 0,
+             _("Expected a positive number of seconds as the argument to %s, "
+               "but got %s"),
+             predicate, quotearg_n_style (0, options.err_quoting_style, arg));
+      /*NOTREACHED*/
+      return false;
+    }
+  /* missing argument */
+  return false;
+}
+
 
 static bool
 do_parse_xmin (const struct parser_table *entry,
@@ -2043,6 +2364,44 @@ parse_fprintf (const struct parser_table *entry, char **argv, int *arg_ptr)
   return false;
 }
 
+/* -printjson and -printtlv. */
+static bool
+parse_print_fields (const struct parser_table *entry, char **argv,
+                    int *arg_ptr)
+{
+  char *fields;
+
+  if (collect_arg_nonconst (argv, arg_ptr, &fields))
+    {
+      struct format_val fmt;
+      open_stdout (&fmt);
+      return insert_fprint_fields (&fmt, entry, fields);
+    }
+  return false;
+}
+
+/* -fprintjson and -fprinttlv. */
+static bool
+parse_fprint_fields (const struct parser_table *entry, char **argv,
+                     int *arg_ptr)
+{
+  const char *filename;
+  char *fields;
+  int saved_argc = *arg_ptr;
+
+  if (collect_arg (argv, arg_ptr, &filename))
+    {
+      if (collect_arg_nonconst (argv, arg_ptr, &fields))
+        {
+          struct format_val fmt;
+          open_output_file (filename, &fmt);
+          return insert_fprint_fields (&fmt, entry, fields);
+        }
+    }
+  *arg_ptr = saved_argc;        /* don't consume the invalid argument. */
+  return false;
+}
+
 static bool
 parse_prune (const struct parser_table *entry, char **argv, int *arg_ptr)
 {
@@ -2218,6 +2577,7 @@ parse_size (const struct parser_table *entry, char **argv, int *arg_ptr)
   our_pred = insert_primary (entry, arg);
   our_pred->args.size.kind = c_type;
   our_pred->args.size.blocksize = blksize;
+  block_converter_init (&our_pred->args.size.blocks, 1, blksize);
   our_pred->args.size.size = num;
   our_pred->need_stat = true;
   our_pred->need_type = false;
@@ -2383,6 +2743,23 @@ parse_samefile (const struct parser_table *entry, char **argv, int *arg_ptr)
   return true;
 }
 
+static bool
+parse_touch (const struct parser_table *entry, char **argv, int *arg_ptr)
+{
+  struct predicate *our_pred;
+
+  (void) argv;
+  (void) arg_ptr;
+
+  our_pred = insert_primary_noarg (entry);
+  our_pred->side_effects = our_pred->no_default_print = true;
+  /* We only need to know whether the file is a symbolic link. */
+  our_pred->need_stat = false;
+  our_pred->need_type = true;
+  our_pred->est_success_rate = 1.0f;
+  return true;
+}
+
 static bool
 parse_true (const struct parser_table *entry, char **argv, int *arg_ptr)
 {
@@ -2582,6 +2959,15 @@ parse_mount (const struct parser_table *entry, char **argv, int *arg_ptr)
   return parse_noop (entry, argv, arg_ptr);
 }
 
+static bool
+parse_moveto (const struct parser_table *entry, char **argv, int *arg_ptr)
+{
+  /* -moveto implies -depth, so that we do not try to search a
+     directory we have already moved away.  */
+  options.do_dir_first = false;
+  return insert_target_dir (entry, argv, arg_ptr);
+}
+
 static bool
 parse_xdev (const struct parser_table *entry, char **argv, int *arg_ptr)
 {
@@ -2886,7 +3272,13 @@ insert_exec_ok (const char *action,
   execp = &our_pred->args.exec_vec;
   execp->wd_for_exec = NULL;
 
-  if ((func != pred_okdir) && (func != pred_ok))
+  if (func == pred_execworker)
+    {
+      /* The worker reads file names from its standard input. */
+      allow_plus = false;
+      execp->close_stdin = false;
+    }
+  else if ((func != pred_okdir) && (func != pred_ok))
     {
       allow_plus = true;
       execp->close_stdin = false;
@@ -2917,6 +3309,12 @@ insert_exec_ok (const char *action,
     }
 
   our_pred->args.exec_vec.multiple = 0;
+  our_pred->args.exec_vec.status_unused = false;
+  our_pred->args.exec_vec.dir_key = NULL;
+  our_pred->args.exec_vec.dir_keylen = 0;
+  our_pred->args.exec_vec.dir_keyalloc = 0;
+  our_pred->args.exec_vec.spare_batches = NULL;
+  our_pred->args.exec_vec.worker = NULL;
 
   /* Count the number of args with path replacements, up until the ';'.
    * Also figure out if the command is terminated by ";" or by "+".
@@ -2977,6 +3375,20 @@ insert_exec_ok (const char *action,
       return false;
     }
 
+  if (func == pred_execworker)
+    {
+      if (brace_count)
+        {
+          error (EXIT_FAILURE, 0,
+                 _("The command for -execworker is sent file names on its "
+                   "standard input, so it may not contain %s"),
+                 quotearg_n_style (0, options.err_quoting_style, "{}"));
+        }
+      init_execworker (execp, argv + start, end - start);
+      *arg_ptr = end + 1;
+      return true;
+    }
+
   if (our_pred->args.exec_vec.multiple)
     {
       const char *suffix;
@@ -3036,7 +3448,7 @@ insert_exec_ok (const char *action,
       /* "+" terminator, so we can just append our arguments after the
        * command and initial arguments.
        */
-      execp->replace_vec = NULL;
+      execp->replace_tpl = NULL;
       execp->ctl.replace_pat = NULL;
       execp->ctl.rplen = 0;
       execp->ctl.lines_per_exec = 0;    /* no limit */
@@ -3066,16 +3478,19 @@ insert_exec_ok (const char *action,
       execp->ctl.rplen = strlen (execp->ctl.replace_pat);
       execp->ctl.lines_per_exec = 0;    /* no limit */
       execp->ctl.args_per_exec = 0;     /* no limit */
-      execp->replace_vec = xmalloc (sizeof (char *) * execp->num_args);
 
 
       /* execp->state = xmalloc(sizeof(*(execp->state))); */
       bc_init_state (&execp->ctl, &execp->state, execp);
 
+      execp->replace_tpl = xnmalloc (execp->num_args,
+                                     sizeof *execp->replace_tpl);
+
       /* Remember the (pre-replacement) arguments for later. */
       for (i = 0; i < execp->num_args; ++i)
         {
-          execp->replace_vec[i] = argv[i + start];
+          bc_init_insert (&execp->ctl, &execp->replace_tpl[i],
+                          argv[i + start], strlen (argv[i + start]));
         }
     }
 
@@ -3102,6 +3517,67 @@ insert_exec_ok (const char *action,
    Used by -amin, -cmin, -mmin, -used, -atime, -ctime and -mtime (parsers) to
    get the appropriate information for a time predicate processor. */
 
+/* Return the timestamp adjacent to T: one nanosecond later if DIR is
+   positive, one nanosecond earlier otherwise.  The extreme values are
+   returned unchanged.  */
+static struct timespec
+adjacent_timespec (struct timespec t, int dir)
+{
+  if (dir > 0)
+    {
+      if (t.tv_nsec < TIMESPEC_HZ - 1)
+        t.tv_nsec++;
+      else if (t.tv_sec < TYPE_MAXIMUM (time_t))
+        {
+          t.tv_sec++;
+          t.tv_nsec = 0;
+        }
+    }
+  else
+    {
+      if (t.tv_nsec > 0)
+        t.tv_nsec--;
+      else if (t.tv_sec > TYPE_MINIMUM (time_t))
+        {
+          t.tv_sec--;
+          t.tv_nsec = TIMESPEC_HZ - 1;
+        }
+    }
+  return t;
+}
+
+/* Work out the inclusive range of timestamps matched by the time
+   window test described by TVAL, so that evaluating the test needs no
+   arithmetic.  WINDOW is the width of the window for COMP_EQ.  */
+static void
+set_time_bounds (struct time_val *tval, double window)
+{
+  const struct timespec earliest = { TYPE_MINIMUM (time_t), 0 };
+  const struct timespec latest = { TYPE_MAXIMUM (time_t), TIMESPEC_HZ - 1 };
+
+  switch (tval->kind)
+    {
+    case COMP_GT:
+      tval->lower = adjacent_timespec (tval->ts, 1);
+      tval->upper = latest;
+      break;
+
+    case COMP_LT:
+      tval->lower = earliest;
+      tval->upper = adjacent_timespec (tval->ts, -1);
+      break;
+
+    case COMP_EQ:
+      /* See the comment in pred_timewindow. */
+      tval->lower = adjacent_timespec (tval->ts, 1);
+      tval->upper = tval->ts;
+      if (INT_ADD_WRAPV (tval->ts.tv_sec, (time_t) window,
+                         &tval->upper.tv_sec))
+        tval->upper = latest;
+      break;
+    }
+}
+
 static bool
 get_relative_timestamp (const char *str,
                         struct time_val *result,
@@ -3163,6 +3639,7 @@ get_relative_timestamp (const char *str,
               result->ts.tv_nsec += nanosec_per_sec;
               result->ts.tv_sec -= 1;
             }
+          set_time_bounds (result, sec_per_unit);
           return true;
         }
       else
@@ -3392,7 +3869,10 @@ static void
 open_output_file (const char *path, struct format_val *p)
 {
   p->segment = NULL;
+  p->ops = NULL;
+  p->n_ops = 0;
   p->quote_opts = clone_quoting_options (NULL);
+  p->shared = NULL;
 
   if (!strcmp (path, "/dev/stderr"))
     {
@@ -3401,21 +3881,31 @@ open_output_file (const char *path, struct format_val *p)
     }
   else if (!strcmp (path, "/dev/stdout"))
     {
+      static bool stdout_buffer_set = false;
+
       p->stream = stdout;
       p->filename = _("standard output");
+      if (!stdout_buffer_set)
+        {
+          /* Nothing has been written to stdout yet.  The buffer is
+           * never freed, as stdout is only closed at exit.
+           */
+          enlarge_output_buffer (stdout);
+          stdout_buffer_set = true;
+        }
     }
   else
     {
-      p->stream = sharefile_fopen (state.shared_files, path);
+      p->shared = sharefile_open (state.shared_files, path);
       p->filename = path;
 
-      if (p->stream == NULL)
+      if (p->shared == NULL)
         {
           fatal_nontarget_file_error (errno, path);
         }
     }
 
-  p->dest_is_tty = stream_is_tty (p->stream);
+  p->dest_is_tty = stream_is_tty (output_stream (p));
 }
 
 static void
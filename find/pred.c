@@ -35,16 +35,20 @@
 #include <unistd.h>             /* for unlinkat() */
 
 /* gnulib headers. */
-#include "areadlink.h"
 #include "dirname.h"
 #include "fcntl--.h"
 #include <fnmatch.h>
+#include "modechange.h"
+#include "renameatu.h"
 #include "stat-size.h"
 #include "stat-time.h"
+#include "xalloc.h"
 #include "yesno.h"
 
 /* find headers. */
 #include "defs.h"
+#include "contextcache.h"
+#include "delqueue.h"
 #include "dircallback.h"
 #include "listfile.h"
 #include "printquoted.h"
@@ -76,42 +80,30 @@ static bool match_lname (const char *pathname, struct stat *stat_buf,
  * Returns true if THE_TIME is
  * COMP_GT: after the specified time
  * COMP_LT: before the specified time
- * COMP_EQ: after the specified time but by not more than WINDOW seconds.
+ * COMP_EQ: after the specified time but by not more than WINDOW seconds,
+ * WINDOW being 60 for -amin and so forth and DAYSECS for -atime.
+ *
+ * consider "find . -mtime 0".
+ *
+ * Here, the origin is exactly 86400 seconds before the start of the
+ * program (since -daystart was not specified).  Hence a file created
+ * the instant the program starts will show a time difference of
+ * 86400.  Similarly, a file created exactly 24h ago would be the
+ * newest file which was _not_ created today.  So, if the difference is
+ * 0, the file was not created today.  If it is 86400, the file was
+ * created this instant.
+ *
+ * All of this is worked out at parse time (see set_time_bounds), so
+ * here we need only check that THE_TIME falls in the inclusive range
+ * [lower, upper].  Both comparisons are always made, so that there is
+ * no data-dependent branch.
  */
 static bool
-pred_timewindow (struct timespec ts, struct predicate const *pred_ptr,
-                 int window)
+pred_timewindow (struct timespec ts, struct predicate const *pred_ptr)
 {
-  switch (pred_ptr->args.reftime.kind)
-    {
-    case COMP_GT:
-      return timespec_cmp (ts, pred_ptr->args.reftime.ts) > 0;
-
-    case COMP_LT:
-      return timespec_cmp (ts, pred_ptr->args.reftime.ts) < 0;
-
-    case COMP_EQ:
-      {
-        /* consider "find . -mtime 0".
-         *
-         * Here, the origin is exactly 86400 seconds before the start
-         * of the program (since -daystart was not specified).   This
-         * function will be called with window=86400 and
-         * pred_ptr->args.reftime.ts as the origin.  Hence a file
-         * created the instant the program starts will show a time
-         * difference (value of delta) of 86400.   Similarly, a file
-         * created exactly 24h ago would be the newest file which was
-         * _not_ created today.   So, if delta is 0.0, the file
-         * was not created today.  If the delta is 86400, the file
-         * was created this instant.
-         */
-        struct timespec delta = timespec_sub (ts, pred_ptr->args.reftime.ts);
-        return (timespec_cmp (delta, make_timespec (0, 0)) > 0
-                && timespec_cmp (delta, make_timespec (window, 0)) <= 0);
-      }
-    }
-  assert (0);
-  abort ();
+  const struct time_val *r = &pred_ptr->args.reftime;
+  return ((timespec_cmp (r->lower, ts) <= 0)
+          & (timespec_cmp (ts, r->upper) <= 0));
 }
 
 
@@ -120,7 +112,7 @@ pred_amin (const char *pathname, struct stat *stat_buf,
            struct predicate *pred_ptr)
 {
   (void) &pathname;
-  return pred_timewindow (get_stat_atime (stat_buf), pred_ptr, 60);
+  return pred_timewindow (get_stat_atime (stat_buf), pred_ptr);
 }
 
 bool
@@ -151,7 +143,67 @@ pred_atime (const char *pathname, struct stat *stat_buf,
             struct predicate *pred_ptr)
 {
   (void) &pathname;
-  return pred_timewindow (get_stat_atime (stat_buf), pred_ptr, DAYSECS);
+  return pred_timewindow (get_stat_atime (stat_buf), pred_ptr);
+}
+
+/* Report that an in-process action failed on PATHNAME in the way the
+   corresponding coreutils command would, and return false.  FORMAT is
+   the message, which contains one %s for the file name.  A file which
+   disappeared is only reported if -noignore_readdir_race is in effect.  */
+static bool
+action_failed (const char *format, const char *pathname)
+{
+  if (ENOENT == errno && options.ignore_readdir_race)
+    {
+      errno = 0;
+      return false;
+    }
+  error (0, errno, format, safely_quote_err_filename (0, pathname));
+  state.exit_status = EXIT_FAILURE;
+  return false;
+}
+
+bool
+pred_chmod (const char *pathname, struct stat *stat_buf,
+            struct predicate *pred_ptr)
+{
+  const struct chmod_val *cv = &pred_ptr->args.chmod;
+  mode_t mode;
+
+  /* As with chmod -R, symbolic links are left alone, since their
+     permissions mean nothing.  */
+  if (S_ISLNK (stat_buf->st_mode))
+    return true;
+
+  mode = mode_adjust (stat_buf->st_mode, S_ISDIR (stat_buf->st_mode),
+                      cv->umask, cv->change, NULL);
+  if (mode == (stat_buf->st_mode & MODE_ALL))
+    return true;                /* Nothing to do. */
+  if (0 == fchmodat (state.cwd_dir_fd, state.rel_pathname, mode, 0))
+    return true;
+  return action_failed (_("changing permissions of %s"), pathname);
+}
+
+bool
+pred_chown (const char *pathname, struct stat *stat_buf,
+            struct predicate *pred_ptr)
+{
+  const struct chown_val *cv = &pred_ptr->args.chown;
+  int flags = 0;
+
+  if ((cv->uid == (uid_t) -1 || cv->uid == stat_buf->st_uid)
+      && (cv->gid == (gid_t) -1 || cv->gid == stat_buf->st_gid))
+    return true;                /* Nothing to do. */
+
+  /* Change what we examined: the link itself, unless we followed it. */
+  if (S_ISLNK (stat_buf->st_mode))
+    flags |= AT_SYMLINK_NOFOLLOW;
+  if (0 == fchownat (state.cwd_dir_fd, state.rel_pathname,
+                     cv->uid, cv->gid, flags))
+    return true;
+  return action_failed (cv->uid == (uid_t) -1
+                        ? _("changing group of %s")
+                        : _("changing ownership of %s"), pathname);
 }
 
 bool
@@ -170,7 +222,7 @@ pred_cmin (const char *pathname, struct stat *stat_buf,
            struct predicate *pred_ptr)
 {
   (void) pathname;
-  return pred_timewindow (get_stat_ctime (stat_buf), pred_ptr, 60);
+  return pred_timewindow (get_stat_ctime (stat_buf), pred_ptr);
 }
 
 bool
@@ -200,7 +252,7 @@ pred_ctime (const char *pathname, struct stat *stat_buf,
             struct predicate *pred_ptr)
 {
   (void) &pathname;
-  return pred_timewindow (get_stat_ctime (stat_buf), pred_ptr, DAYSECS);
+  return pred_timewindow (get_stat_ctime (stat_buf), pred_ptr);
 }
 
 static bool
@@ -214,13 +266,18 @@ bool
 pred_delete (const char *pathname, struct stat *stat_buf,
              struct predicate *pred_ptr)
 {
-  (void) pred_ptr;
   (void) stat_buf;
   if (strcmp (state.rel_pathname, "."))
     {
       int flags = 0;
       if (state.have_stat && S_ISDIR (stat_buf->st_mode))
         flags |= AT_REMOVEDIR;
+      /* When nothing needs to know whether the removal worked, let the
+       * delete queue do it alongside others.  It reports failures
+       * itself.
+       */
+      if (pred_ptr->args.status_unused && delqueue_unlink (pathname, flags))
+        return true;
       if (perform_delete (flags))
         {
           return true;
@@ -301,6 +358,9 @@ pred_empty (const char *pathname, struct stat *stat_buf,
       struct dirent *dp;
       bool empty = true;
 
+      /* Files below may still be waiting to be deleted. */
+      delqueue_wait (state.curdepth);
+
       errno = 0;
       if ((fd = openat (state.cwd_dir_fd, state.rel_pathname, O_RDONLY
 #if defined O_LARGEFILE
@@ -372,6 +432,13 @@ pred_execdir (const char *pathname, struct stat *stat_buf,
   return impl_pred_exec (state.rel_pathname, stat_buf, pred_ptr);
 }
 
+bool
+pred_execworker (const char *pathname, struct stat *stat_buf,
+                 struct predicate *pred_ptr)
+{
+  return impl_pred_execworker (pathname, stat_buf, pred_ptr);
+}
+
 bool
 pred_false (const char *pathname, struct stat *stat_buf,
             struct predicate *pred_ptr)
@@ -388,7 +455,7 @@ bool
 pred_fls (const char *pathname, struct stat *stat_buf,
           struct predicate *pred_ptr)
 {
-  FILE *stream = pred_ptr->args.printf_vec.stream;
+  FILE *stream = output_stream (&pred_ptr->args.printf_vec);
   list_file (pathname, state.cwd_dir_fd, state.rel_pathname, stat_buf,
              options.start_time.tv_sec,
              options.output_block_size,
@@ -403,7 +470,7 @@ pred_fprint (const char *pathname, struct stat *stat_buf,
   (void) &pathname;
   (void) &stat_buf;
 
-  print_quoted (pred_ptr->args.printf_vec.stream,
+  print_quoted (output_stream (&pred_ptr->args.printf_vec),
                 pred_ptr->args.printf_vec.quote_opts,
                 pred_ptr->args.printf_vec.dest_is_tty, "%s\n", pathname);
   return true;
@@ -413,12 +480,12 @@ bool
 pred_fprint0 (const char *pathname, struct stat *stat_buf,
               struct predicate *pred_ptr)
 {
-  FILE *fp = pred_ptr->args.printf_vec.stream;
+  FILE *fp = output_stream (&pred_ptr->args.printf_vec);
 
   (void) &stat_buf;
 
-  fputs (pathname, fp);
-  putc (0, fp);
+  /* Write the terminating NUL along with the name. */
+  fwrite (pathname, 1, strlen (pathname) + 1, fp);
   return true;
 }
 
@@ -473,18 +540,28 @@ static bool
 pred_name_common (const char *pathname, const char *str, int flags)
 {
   bool b;
+  char *base;
+
+  /* FNM_PERIOD is not used here because POSIX requires that it not be.
+   * See https://standards.ieee.org/reading/ieee/interp/1003-2-92_int/pasc-1003.2-126.html
+   */
+  if (state.path_base)
+    {
+      /* Below a starting point, fts has already found the base name
+       * for us, and it never has a trailing slash.
+       */
+      return fnmatch (str, state.path_base, flags) == 0;
+    }
+
   /* We used to use last_component() here, but that would not allow us to modify the
    * input string, which is const.   We could optimize by duplicating the string only
    * if we need to modify it, and I'll do that if there is a measurable
    * performance difference on a machine built after 1990...
    */
-  char *base = base_name (pathname);
+  base = base_name (pathname);
   /* remove trailing slashes, but leave  "/" or "//foo" unchanged. */
   strip_trailing_slashes (base);
 
-  /* FNM_PERIOD is not used here because POSIX requires that it not be.
-   * See https://standards.ieee.org/reading/ieee/interp/1003-2-92_int/pasc-1003.2-126.html
-   */
   b = fnmatch (str, base, flags) == 0;
   free (base);
   return b;
@@ -529,6 +606,44 @@ pred_links (const char *pathname, struct stat *stat_buf,
                       pred_ptr->args.numinfo.l_val, stat_buf->st_nlink);
 }
 
+/* Return the name of the file -moveto or -linkto would make in TARGET
+   for the file being examined, for use in a diagnostic.  */
+static char *
+target_file_name (const struct target_dir *target)
+{
+  const char *base = last_component (state.rel_pathname);
+  const size_t dirlen = strlen (target->name);
+  char *name = xmalloc (dirlen + strlen (base) + 2);
+
+  memcpy (name, target->name, dirlen);
+  name[dirlen] = '/';
+  strcpy (name + dirlen + 1, base);
+  return name;
+}
+
+bool
+pred_linkto (const char *pathname, struct stat *stat_buf,
+             struct predicate *pred_ptr)
+{
+  const struct target_dir *target = &pred_ptr->args.target;
+  char *name;
+
+  (void) stat_buf;
+  if (0 == linkat (state.cwd_dir_fd, state.rel_pathname, target->fd,
+                   last_component (state.rel_pathname), 0))
+    return true;
+  if (ENOENT == errno && options.ignore_readdir_race)
+    return false;
+
+  name = target_file_name (target);
+  error (0, errno, _("failed to create hard link %s => %s"),
+         safely_quote_err_filename (0, name),
+         safely_quote_err_filename (1, pathname));
+  free (name);
+  state.exit_status = EXIT_FAILURE;
+  return false;
+}
+
 bool
 pred_lname (const char *pathname, struct stat *stat_buf,
             struct predicate *pred_ptr)
@@ -544,7 +659,7 @@ match_lname (const char *pathname, struct stat *stat_buf,
 #ifdef S_ISLNK
   if (S_ISLNK (stat_buf->st_mode))
     {
-      char *linkname = areadlinkat (state.cwd_dir_fd, state.rel_pathname);
+      const char *linkname = get_link_target ();
       if (linkname)
         {
           if (fnmatch (pred_ptr->args.str, linkname,
@@ -556,7 +671,6 @@ match_lname (const char *pathname, struct stat *stat_buf,
           nonfatal_target_file_error (errno, pathname);
           state.exit_status = EXIT_FAILURE;
         }
-      free (linkname);
     }
 #endif /* S_ISLNK */
   return ret;
@@ -574,7 +688,7 @@ pred_mmin (const char *pathname, struct stat *stat_buf,
            struct predicate *pred_ptr)
 {
   (void) &pathname;
-  return pred_timewindow (get_stat_mtime (stat_buf), pred_ptr, 60);
+  return pred_timewindow (get_stat_mtime (stat_buf), pred_ptr);
 }
 
 bool
@@ -582,7 +696,33 @@ pred_mtime (const char *pathname, struct stat *stat_buf,
             struct predicate *pred_ptr)
 {
   (void) pathname;
-  return pred_timewindow (get_stat_mtime (stat_buf), pred_ptr, DAYSECS);
+  return pred_timewindow (get_stat_mtime (stat_buf), pred_ptr);
+}
+
+bool
+pred_moveto (const char *pathname, struct stat *stat_buf,
+             struct predicate *pred_ptr)
+{
+  const struct target_dir *target = &pred_ptr->args.target;
+  char *name;
+
+  (void) stat_buf;
+  /* Like mv -n, never replace a file already in DIR; that fails with
+     EEXIST instead.  */
+  if (0 == renameatu (state.cwd_dir_fd, state.rel_pathname, target->fd,
+                      last_component (state.rel_pathname), RENAME_NOREPLACE))
+    return true;
+  if (ENOENT == errno && options.ignore_readdir_race)
+    return false;
+
+  /* Unlike mv, we do not copy files to another file system (EXDEV). */
+  name = target_file_name (target);
+  error (0, errno, _("cannot move %s to %s"),
+         safely_quote_err_filename (0, pathname),
+         safely_quote_err_filename (1, name));
+  free (name);
+  state.exit_status = EXIT_FAILURE;
+  return false;
 }
 
 bool
@@ -699,7 +839,7 @@ bool
 predicate_uses_exec (const struct predicate *p)
 {
   return pred_is (p, pred_exec)
-    || pred_is (p, pred_execdir)
+    || pred_is (p, pred_execdir) || pred_is (p, pred_execworker)
     || pred_is (p, pred_ok) || pred_is (p, pred_okdir);
 }
 
@@ -708,7 +848,7 @@ bool
 pred_ok (const char *pathname, struct stat *stat_buf,
          struct predicate *pred_ptr)
 {
-  if (is_ok (pred_ptr->args.exec_vec.replace_vec[0], pathname))
+  if (is_ok (pred_ptr->args.exec_vec.replace_tpl[0].arg, pathname))
     return impl_pred_exec (pathname, stat_buf, pred_ptr);
   else
     return false;
@@ -718,7 +858,7 @@ bool
 pred_okdir (const char *pathname, struct stat *stat_buf,
             struct predicate *pred_ptr)
 {
-  if (is_ok (pred_ptr->args.exec_vec.replace_vec[0], pathname))
+  if (is_ok (pred_ptr->args.exec_vec.replace_tpl[0].arg, pathname))
     return impl_pred_exec (state.rel_pathname, stat_buf, pred_ptr);
   else
     return false;
@@ -841,7 +981,7 @@ pred_print (const char *pathname, struct stat *stat_buf,
   (void) stat_buf;
   (void) pred_ptr;
 
-  print_quoted (pred_ptr->args.printf_vec.stream,
+  print_quoted (output_stream (&pred_ptr->args.printf_vec),
                 pred_ptr->args.printf_vec.quote_opts,
                 pred_ptr->args.printf_vec.dest_is_tty, "%s\n", pathname);
   return true;
@@ -884,13 +1024,11 @@ pred_quit (const char *pathname, struct stat *stat_buf,
   (void) pred_ptr;
 
   /* Run any cleanups.  This includes executing any command lines
-   * we have partly built but not executed.
+   * we have partly built but not executed, and waiting for any
+   * commands still running in the background (see -maxprocs).
    */
   cleanup ();
 
-  /* Since -exec and friends don't leave child processes running in the
-   * background, there is no need to wait for them here.
-   */
   exit (state.exit_status);     /* 0 for success, etc. */
 }
 
@@ -913,8 +1051,12 @@ pred_size (const char *pathname, struct stat *stat_buf,
   uintmax_t f_val;
 
   (void) pathname;
-  f_val = ((stat_buf->st_size / pred_ptr->args.size.blocksize)
-           + (stat_buf->st_size % pred_ptr->args.size.blocksize != 0));
+  if (stat_buf->st_size >= 0)
+    f_val = convert_blocks (&pred_ptr->args.size.blocks,
+                            stat_buf->st_size);
+  else
+    f_val = ((stat_buf->st_size / pred_ptr->args.size.blocksize)
+             + (stat_buf->st_size % pred_ptr->args.size.blocksize != 0));
 
   return compare_num (pred_ptr->args.size.kind,
                       pred_ptr->args.size.size, f_val);
@@ -962,6 +1104,22 @@ pred_samefile (const char *pathname, struct stat *stat_buf,
     }
 }
 
+bool
+pred_touch (const char *pathname, struct stat *stat_buf,
+            struct predicate *pred_ptr)
+{
+  const mode_t mode = state.have_stat ? stat_buf->st_mode : state.type;
+  int flags = 0;
+
+  (void) pred_ptr;
+  /* Touch what we examined: the link itself, unless we followed it. */
+  if (S_ISLNK (mode))
+    flags |= AT_SYMLINK_NOFOLLOW;
+  if (0 == utimensat (state.cwd_dir_fd, state.rel_pathname, NULL, flags))
+    return true;
+  return action_failed (_("setting times of %s"), pathname);
+}
+
 bool
 pred_true (const char *pathname, struct stat *stat_buf,
            struct predicate *pred_ptr)
@@ -1101,7 +1259,7 @@ pred_used (const char *pathname, struct stat *stat_buf,
       delta.tv_nsec += 1000000000;
       delta.tv_sec -= 1;
     }
-  return pred_timewindow (delta, pred_ptr, DAYSECS);
+  return pred_timewindow (delta, pred_ptr);
 }
 
 bool
@@ -1135,22 +1293,20 @@ pred_xtype (const char *pathname, struct stat *stat_buf,
             struct predicate *pred_ptr)
 {
   struct stat sbuf;             /* local copy, not stat_buf because we're using a different stat method */
-  int (*ystat) (const char *, struct stat * p);
-
 
   /* If we would normally stat the link itself, stat the target instead.
    * If we would normally follow the link, stat the link itself instead.
    */
-  const bool ystat_follows_links = !following_links ();
-  if (ystat_follows_links)
-    ystat = optionl_stat;
-  else
-    ystat = optionp_stat;
-
-  set_stat_placeholders (&sbuf);
-  if ((*ystat) (state.rel_pathname, &sbuf) != 0)
+  if (!following_links ())
     {
-      if (ystat_follows_links && err_signals_broken_link (errno))
+      /* The usual case; the result may already be known from %Y. */
+      const struct stat *target;
+      if (0 == get_link_target_stat (&target))
+        {
+          sbuf = *target;
+          return pred_type (pathname, &sbuf, pred_ptr);
+        }
+      if (err_signals_broken_link (errno))
         {
           /* If we failed to follow the symlink,
            * fall back on looking at the symlink itself.
@@ -1158,11 +1314,15 @@ pred_xtype (const char *pathname, struct stat *stat_buf,
           /* Mimic behavior of ls -lL. */
           return pred_type (pathname, stat_buf, pred_ptr);
         }
-      else
-        {
-          error (0, errno, "%s", safely_quote_err_filename (0, pathname));
-          state.exit_status = EXIT_FAILURE;
-        }
+      error (0, errno, "%s", safely_quote_err_filename (0, pathname));
+      state.exit_status = EXIT_FAILURE;
+      return false;
+    }
+
+  if (optionp_stat (state.rel_pathname, &sbuf) != 0)
+    {
+      error (0, errno, "%s", safely_quote_err_filename (0, pathname));
+      state.exit_status = EXIT_FAILURE;
       return false;
     }
   /* Now that we have our stat() information, query it in the same
@@ -1176,21 +1336,16 @@ bool
 pred_context (const char *pathname, struct stat *stat_buf,
               struct predicate *pred_ptr)
 {
-  char *scontext;
-  int rv = (*options.x_getfilecon) (state.cwd_dir_fd, state.rel_pathname,
-                                    &scontext);
-  (void) stat_buf;
+  struct file_context *ctx = get_file_context (stat_buf);
 
-  if (rv < 0)
+  if (!ctx)
     {
       error (0, errno, _("getfilecon failed: %s"),
              safely_quote_err_filename (0, pathname));
       return false;
     }
 
-  rv = (fnmatch (pred_ptr->args.scontext, scontext, 0) == 0);
-  freecon (scontext);
-  return rv;
+  return file_context_matches (ctx, pred_ptr->args.scontext);
 }
 
 /* Copy STR into BUF and trim blanks from the end of BUF.
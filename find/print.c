@@ -23,25 +23,30 @@
 #include <ctype.h>
 #include <errno.h>
 #include <grp.h>
+#include <limits.h>
+#include <locale.h>
 #include <math.h>
 #include <pwd.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 /* gnulib headers. */
-#include "areadlink.h"
 #include "dirname.h"
 #include "filemode.h"
 #include "human.h"
 #include "printquoted.h"
 #include "stat-size.h"
 #include "stat-time.h"
-#include "verify.h"
 #include "xalloc.h"
 
 /* find-specific headers. */
 #include "system.h"
+#include "contextcache.h"
 #include "defs.h"
 #include "print.h"
 
@@ -51,15 +56,93 @@
 #else
 # define ISDIGIT(c) (isascii ((unsigned char)c) && isdigit ((unsigned char)c))
 #endif
-#undef MAX
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/* In theory, we use an extra 10 characters for 9 digits of nanoseconds
+ * and 1 for the decimal point.  See format_ns for why this is larger.
+ */
+enum
+{
+  NS_BUF_LEN = 32
+};
+
+/* Value of cache_ns_offset meaning that no nanoseconds are printed. */
+#define NO_NS_OFFSET SIZE_MAX
+
+/* A date directive (%A, %B, %C or %T followed by a format character),
+ * prepared when the -printf format is parsed, together with the
+ * rendering of the last timestamp formatted with it.
+ */
+struct time_format
+{
+  char kind;                    /* strftime conversion, or '+' or '@' */
+  bool need_ns_suffix;          /* print nanoseconds after the seconds */
+  char *timefmt;                /* format for strftime, see make_time_format */
+
+  bool cache_valid;
+  time_t cache_sec;             /* the tv_sec last rendered */
+  char *cache_text;             /* its rendering, with a leading '_' */
+  size_t cache_size;            /* allocated size of cache_text */
+  size_t cache_len;             /* length of cache_text */
+  size_t cache_ns_offset;       /* where nanoseconds go, or NO_NS_OFFSET */
+};
 
 /* *INDENT-OFF* */
 static void
-checked_fprintf (struct format_val *dest, const char *fmt, ...)
+outbuf_printf (struct format_val *dest, const char *fmt, ...)
 _GL_ATTRIBUTE_FORMAT_PRINTF_STANDARD (2, 3);
 /* *INDENT-ON* */
 
+static void compile_printf (struct format_val *vec);
+
+
+/* Return a new date directive for the strftime conversion KIND, or
+   '+' (date and time separated by '+') or '@' (seconds since the
+   epoch).  */
+static struct time_format *
+make_time_format (char kind)
+{
+  struct time_format *tf = xzalloc (sizeof *tf);
+
+  tf->kind = kind;
+  switch (kind)
+    {
+    case '+':
+    case 'S':
+    case 'T':
+    case 'X':
+    case '@':
+      tf->need_ns_suffix = true;
+      break;
+    default:
+      tf->need_ns_suffix = false;
+      break;
+    }
+
+  /* If the format expands to nothing (%p in some locales, for
+   * example), strftime can return 0.  We actually want to distinguish
+   * the error case where the buffer is too short, so we just prepend
+   * an otherwise uninteresting character to prevent the no-output
+   * case.
+   */
+  if (kind == '+')
+    {
+      /* Avoid %F, some Unix versions lack it.  For example:
+         HP Tru64 UNIX V5.1B (Rev. 2650); Wed Feb 17 22:59:59 CST 2016
+         Also, some older HP-UX versions expand %F as the full month (like %B).
+         Reported by Steven M. Schweda <sms@antinode.info> */
+      tf->timefmt = xstrdup ("_%Y-%m-%d+%T");
+    }
+  else
+    {
+      /* %a, %c, and %t are handled in ctime_format() */
+      tf->timefmt = xmalloc (sizeof "_%x");
+      tf->timefmt[0] = '_';
+      tf->timefmt[1] = '%';
+      tf->timefmt[2] = kind;
+      tf->timefmt[3] = '\0';
+    }
+  return tf;
+}
 
 /* Create a new fprintf segment in *SEGMENT, with type KIND,
    from the text in FORMAT, which has length LEN.
@@ -85,6 +168,8 @@ make_segment (struct segment **segment,
   (*segment)->format_char[1] = aux_format_char;
   (*segment)->next = NULL;
   (*segment)->text_len = len;
+  (*segment)->time_format =
+    aux_format_char ? make_time_format (aux_format_char) : NULL;
 
   fmt = (*segment)->text = xmalloc (len + sizeof "d");
   strncpy (fmt, format, len);
@@ -133,11 +218,13 @@ make_segment (struct segment **segment,
     case 'C':                  /* ctime in user-specified strftime format */
     case 'F':                  /* file system type */
     case 'g':                  /* group name */
+    case 'j':                  /* size with an SI suffix */
     case 'M':                  /* mode in `ls -l' format (eg., "drwxr-xr-x") */
     case 's':                  /* size in bytes */
     case 't':                  /* mtime in `ctime' format */
     case 'T':                  /* mtime in user-specified strftime format */
     case 'u':                  /* user name */
+    case 'z':                  /* size with a binary suffix, as `ls -lh' */
       pred->need_stat = true;
       mycost = NeedsStatInfo;
       *fmt++ = 's';
@@ -280,7 +367,7 @@ get_format_flags_length (const char *p)
 static size_t
 get_format_specifer_length (char ch)
 {
-  if (strchr ("abcdDfFgGhHiklmMnpPsStuUyYZ%", ch))
+  if (strchr ("abcdDfFgGhHijklmMnpPsStuUyYzZ%", ch))
     {
       return 1;
     }
@@ -322,6 +409,7 @@ insert_fprintf (struct format_val *vec,
                         KIND_STOP, 0, 0, our_pred);
           if (our_pred->need_stat && (our_pred->p_cost < NeedsStatInfo))
             our_pred->p_cost = NeedsStatInfo;
+          compile_printf (&our_pred->args.printf_vec);
           return true;
         }
       else if (*fmt_editpos == '\\')
@@ -423,6 +511,7 @@ insert_fprintf (struct format_val *vec,
   if (fmt_editpos > segstart)
     make_segment (segmentp, segstart, fmt_editpos - segstart, KIND_PLAIN, 0,
                   0, our_pred);
+  compile_printf (&our_pred->args.printf_vec);
   return true;
 }
 
@@ -470,43 +559,25 @@ scan_for_digit_differences (const char *p, const char *q,
   return true;
 }
 
-static char *
-do_time_format (const char *fmt, const struct tm *p, const char *ns,
-                size_t ns_size)
+/* Render the broken-down time P according to TF->timefmt into
+ * TF->cache_text, recording in TF->cache_ns_offset where (if
+ * anywhere) the nanoseconds belong.  Return false if strftime fails.
+ */
+static bool
+do_time_format (struct time_format *tf, const struct tm *p)
 {
-  static char *buf = NULL;
-  static size_t buf_size;
-  char *timefmt = NULL;
+  static char *altbuf = NULL;
+  static size_t altbuf_size = 0;
   struct tm altered_time;
 
-
-  /* If the format expands to nothing (%p in some locales, for
-   * example), strftime can return 0.  We actually want to distinguish
-   * the error case where the buffer is too short, so we just prepend
-   * an otherwise uninteresting character to prevent the no-output
-   * case.
-   */
-  timefmt = xmalloc (strlen (fmt) + 2u);
-  timefmt[0] = '_';
-  memcpy (timefmt + 1, fmt, strlen (fmt) + 1);
-
-  /* altered_time is a similar time, but in which both
-   * digits of the seconds field are different.
-   */
-  altered_time = *p;
-  if (altered_time.tm_sec >= 11)
-    altered_time.tm_sec -= 11;
-  else
-    altered_time.tm_sec += 11;
-
   /* If we call strftime() with buf_size=0, the program will coredump
    * on Solaris, since it unconditionally writes the terminating null
    * character.
    */
-  if (buf == NULL)
+  if (tf->cache_text == NULL)
     {
-      buf_size = 1u;
-      buf = xmalloc (buf_size);
+      tf->cache_size = 64u;
+      tf->cache_text = xmalloc (tf->cache_size);
     }
   while (true)
     {
@@ -514,214 +585,178 @@ do_time_format (const char *fmt, const struct tm *p, const char *ns,
        * Therefore we do not check for (buf_used != 0) as the termination
        * condition.
        */
-      size_t buf_used = strftime (buf, buf_size, timefmt, p);
+      size_t buf_used = strftime (tf->cache_text, tf->cache_size,
+                                  tf->timefmt, p);
       if (buf_used              /* Conforming POSIX system */
-          && (buf_used < buf_size))     /* Solaris workaround */
-        {
-          char *altbuf;
-          size_t i = 0, n = 0;
-          size_t final_len = (buf_used + 1u     /* for \0 */
-                              + ns_size);
-          buf = xrealloc (buf, final_len);
-          buf_size = final_len;
-          altbuf = xmalloc (final_len);
-          strftime (altbuf, buf_size, timefmt, &altered_time);
-
-          /* Find the seconds digits; they should be the only changed part.
-           * In theory the result of the two formatting operations could differ in
-           * more than just one sequence of decimal digits (for example %X might
-           * in theory return a spelled-out time like "thirty seconds past noon").
-           * When that happens, we just avoid inserting the nanoseconds field.
-           */
-          if (scan_for_digit_differences (buf, altbuf, &i, &n)
-              && (2 == n) && !isdigit ((unsigned char) buf[i + n]))
-            {
-              const size_t end_of_seconds = i + n;
-              const size_t suffix_len = buf_used - (end_of_seconds) + 1;
-
-              /* Move the tail (including the \0).  Note that this
-               * is a move of an overlapping memory block, so we
-               * must use memmove instead of memcpy.  Then insert
-               * the nanoseconds (but not its trailing \0).
-               */
-              assert (end_of_seconds + ns_size + suffix_len == final_len);
-              memmove (buf + end_of_seconds + ns_size,
-                       buf + end_of_seconds, suffix_len);
-              memcpy (buf + i + n, ns, ns_size);
-            }
-          else
-            {
-              /* No seconds digits.  No need to insert anything. */
-            }
-          /* The first character of buf is the underscore, which we actually
-           * don't want.
-           */
-          free (timefmt);
-          free (altbuf);
-          return buf + 1;
-        }
-      else
+          && (buf_used < tf->cache_size))       /* Solaris workaround */
         {
-          buf = x2nrealloc (buf, &buf_size, sizeof *buf);
+          tf->cache_len = buf_used;
+          tf->cache_ns_offset = NO_NS_OFFSET;
+          break;
         }
+      tf->cache_text = x2nrealloc (tf->cache_text, &tf->cache_size, 1);
+    }
+
+  if (!tf->need_ns_suffix)
+    return true;
+
+  /* altered_time is a similar time, but in which both
+   * digits of the seconds field are different.
+   */
+  altered_time = *p;
+  if (altered_time.tm_sec >= 11)
+    altered_time.tm_sec -= 11;
+  else
+    altered_time.tm_sec += 11;
+
+  if (altbuf_size < tf->cache_size)
+    {
+      altbuf_size = tf->cache_size;
+      altbuf = xrealloc (altbuf, altbuf_size);
+    }
+  if (strftime (altbuf, altbuf_size, tf->timefmt, &altered_time))
+    {
+      size_t i = 0, n = 0;
+      const char *buf = tf->cache_text;
+
+      /* Find the seconds digits; they should be the only changed part.
+       * In theory the result of the two formatting operations could differ in
+       * more than just one sequence of decimal digits (for example %X might
+       * in theory return a spelled-out time like "thirty seconds past noon").
+       * When that happens, we just avoid inserting the nanoseconds field.
+       */
+      if (scan_for_digit_differences (buf, altbuf, &i, &n)
+          && (2 == n) && !isdigit ((unsigned char) buf[i + n]))
+        tf->cache_ns_offset = i + n;
     }
+  return true;
 }
 
-/* Return a static string formatting the time WHEN according to the
- * strftime format character KIND.
- *
- * This function contains a number of assertions.  These look like
- * runtime checks of the results of computations, which would be a
- * problem since external events should not be tested for with
- * "assert" (instead you should use "if").  However, they are not
- * really runtime checks.  The assertions actually exist to verify
- * that the various buffers are correctly sized.
+/* Render the whole seconds of a timestamp, TV_SEC, into the cache of
+ * TF.  The first character of TF->cache_text is not part of the result
+ * (see make_time_format).
  */
-static char *
-format_date (struct timespec ts, int kind)
+static void
+render_seconds (time_t tv_sec, struct time_format *tf)
 {
-  /* In theory, we use an extra 10 characters for 9 digits of
-   * nanoseconds and 1 for the decimal point.  However, the real
-   * world is more complex than that.
+  char hbuf[LONGEST_HUMAN_READABLE + 2];
+  uintmax_t w = tv_sec;
+  char *p;
+  size_t len;
+
+  tf->cache_valid = true;
+  tf->cache_sec = tv_sec;
+
+  if (tf->kind != '@')
+    {
+      struct tm *tm = localtime (&tv_sec);
+      if (tm && do_time_format (tf, tm))
+        return;
+    }
+
+  /* If we get to here, either the format was %@, or we have fallen back to it
+   * because strftime failed.
    *
-   * For example, some systems return junk in the tv_nsec part of
-   * st_birthtime.  An example of this is the NetBSD-4.0-RELENG kernel
-   * (at Sat Mar 24 18:46:46 2007) running a NetBSD-3.1-RELEASE
-   * runtime and examining files on an msdos filesystem.  So for that
-   * reason we set NS_BUF_LEN to 32, which is simply "long enough" as
-   * opposed to "exactly the right size".  Note that the behaviour of
-   * NetBSD appears to be a result of the use of uninitialized data,
-   * as it's not 100% reproducible (more like 25%).
-   */
-  enum
-  {
-    NS_BUF_LEN = 32,
-    DATE_LEN_PERCENT_APLUS = 21 /* length of result of %A+ (it's longer than %c) */
-  };
-  static char buf[128u + 10u + MAX (DATE_LEN_PERCENT_APLUS,
-                                    MAX (LONGEST_HUMAN_READABLE + 2,
-                                         NS_BUF_LEN + 64 + 200))];
-  char ns_buf[NS_BUF_LEN];      /* -.9999999990 (- sign can happen!) */
-  int charsprinted, need_ns_suffix;
-  struct tm *tm;
-  char fmt[12];
-
-  /* human_readable() assumes we pass a buffer which is at least as
-   * long as LONGEST_HUMAN_READABLE.  We use an assertion here to
-   * ensure that no nasty unsigned overflow happened in our calculation
-   * of the size of buf.  Do the assertion here rather than in the
-   * code for %@ so that we find the problem quickly if it exists.  If
-   * you want to submit a patch to move this into the if statement, go
-   * ahead, I'll apply it.  But include performance timings
-   * demonstrating that the performance difference is actually
-   * measurable.
+   * XXX: note that we are negating an unsigned type which is the
+   * widest possible unsigned type.
    */
-  verify (sizeof (buf) >= LONGEST_HUMAN_READABLE);
-
-  charsprinted = 0;
-  need_ns_suffix = 0;
+  p = human_readable (tv_sec < 0 ? -w : w, hbuf + 1, human_ceiling, 1, 1);
+  if (tv_sec < 0)
+    *--p = '-';                 /* XXX: Ugh, relying on internal details of human_readable(). */
 
-  /* Format the main part of the time. */
-  if (kind == '+')
+  len = strlen (p);
+  if (tf->cache_size < len + 2u)
     {
-      /* Avoid %F, some Unix versions lack it.  For example:
-         HP Tru64 UNIX V5.1B (Rev. 2650); Wed Feb 17 22:59:59 CST 2016
-         Also, some older HP-UX versions expand %F as the full month (like %B).
-         Reported by Steven M. Schweda <sms@antinode.info> */
-      strcpy (fmt, "%Y-%m-%d+%T");
-      need_ns_suffix = 1;
+      tf->cache_size = len + 2u;
+      tf->cache_text = xrealloc (tf->cache_text, tf->cache_size);
     }
-  else
+  tf->cache_text[0] = '_';
+  memcpy (tf->cache_text + 1, p, len + 1);
+  tf->cache_len = len + 1;
+  tf->cache_ns_offset = tf->need_ns_suffix ? tf->cache_len : NO_NS_OFFSET;
+}
+
+/* Format the nanoseconds part of a timestamp into BUF, returning its
+ * length.  Leave a trailing zero to discourage people from writing
+ * scripts which extract the fractional part of the timestamp by using
+ * column offsets.  The reason for discouraging this is that in the
+ * future, the granularity may not be nanoseconds.
+ */
+static size_t
+format_ns (char *buf, long int ns)
+{
+  if (0 <= ns && ns < 1000000000L)
     {
-      fmt[0] = '%';
-      fmt[1] = kind;
-      fmt[2] = '\0';
+      int i;
 
-      /* %a, %c, and %t are handled in ctime_format() */
-      switch (kind)
+      buf[0] = '.';
+      for (i = 9; i > 0; --i)
         {
-        case 'S':
-        case 'T':
-        case 'X':
-        case '@':
-          need_ns_suffix = 1;
-          break;
-        default:
-          need_ns_suffix = 0;
-          break;
+          buf[i] = '0' + ns % 10;
+          ns /= 10;
         }
+      buf[10] = '0';
+      buf[11] = '\0';
+      return 11;
     }
-
-  if (need_ns_suffix)
+  else
     {
-      /* Format the nanoseconds part.  Leave a trailing zero to
-       * discourage people from writing scripts which extract the
-       * fractional part of the timestamp by using column offsets.
-       * The reason for discouraging this is that in the future, the
-       * granularity may not be nanoseconds.
+      /* Some systems return junk in the tv_nsec part of st_birthtime.
+       * An example of this is the NetBSD-4.0-RELENG kernel (at Sat Mar
+       * 24 18:46:46 2007) running a NetBSD-3.1-RELEASE runtime and
+       * examining files on an msdos filesystem.  So for that reason we
+       * set NS_BUF_LEN to 32, which is simply "long enough" as opposed
+       * to "exactly the right size".
        */
-      charsprinted =
-        snprintf (ns_buf, NS_BUF_LEN, ".%09ld0", (long int) ts.tv_nsec);
+      int charsprinted = snprintf (buf, NS_BUF_LEN, ".%09ld0", ns);
       assert (charsprinted < NS_BUF_LEN);
+      return charsprinted;
     }
-  else
-    {
-      charsprinted = 0;
-      ns_buf[0] = 0;
-    }
+}
 
-  if (kind != '@')
-    {
-      tm = localtime (&ts.tv_sec);
-      if (tm)
-        {
-          char *s = do_time_format (fmt, tm, ns_buf, charsprinted);
-          if (s)
-            return s;
-        }
-    }
+/* Return a string formatting the time TS according to TF.  The result
+ * is valid until the next call.
+ *
+ * strftime and localtime are expensive, and files are often created
+ * in bulk, so the rendering of the whole seconds is remembered in TF;
+ * for a file with the same tv_sec as the previous one we only need to
+ * splice in the nanoseconds.  This relies on the time zone not
+ * changing while find runs.
+ */
+static const char *
+format_date (struct timespec ts, struct time_format *tf)
+{
+  static char *buf = NULL;
+  static size_t buf_size = 0;
+  char ns_buf[NS_BUF_LEN];      /* -.9999999990 (- sign can happen!) */
+  size_t ns_len, need;
+  const char *text;
+  size_t text_len;
 
-  /* If we get to here, either the format was %@, or we have fallen back to it
-   * because strftime failed.
+  if (!tf->cache_valid || tf->cache_sec != ts.tv_sec)
+    render_seconds (ts.tv_sec, tf);
+
+  /* The first character of the cached text is the underscore, which we
+   * actually don't want.
    */
-  if (1)
+  text = tf->cache_text + 1;
+  text_len = tf->cache_len - 1;
+  if (tf->cache_ns_offset == NO_NS_OFFSET)
+    return text;
+
+  ns_len = format_ns (ns_buf, (long int) ts.tv_nsec);
+  need = text_len + ns_len + 1u;
+  if (buf_size < need)
     {
-      uintmax_t w = ts.tv_sec;
-      size_t used, len, remaining;
-
-      /* XXX: note that we are negating an unsigned type which is the
-       * widest possible unsigned type.
-       */
-      char *p = human_readable (ts.tv_sec < 0 ? -w : w, buf + 1,
-                                human_ceiling, 1, 1);
-      assert (p > buf);
-      assert (p < (buf + (sizeof buf)));
-      if (ts.tv_sec < 0)
-        *--p = '-';             /* XXX: Ugh, relying on internal details of human_readable(). */
-
-      /* Add the nanoseconds part.  Because we cannot enforce a
-       * particular implementation of human_readable, we cannot assume
-       * any particular value for (p-buf).  So we need to be careful
-       * that there is enough space remaining in the buffer.
-       */
-      if (need_ns_suffix)
-        {
-          len = strlen (p);
-          used = (p - buf) + len;       /* Offset into buf of current end */
-          assert (sizeof buf > used);   /* Ensure we can perform subtraction safely. */
-          remaining = sizeof buf - used - 1u;   /* allow space for NUL */
-
-          if (strlen (ns_buf) >= remaining)
-            {
-              error (0, 0,
-                     "charsprinted=%ld but remaining=%lu: ns_buf=%s",
-                     (long) charsprinted, (unsigned long) remaining, ns_buf);
-            }
-          assert (strlen (ns_buf) < remaining);
-          strcat (p, ns_buf);
-        }
-      return p;
+      buf_size = need;
+      buf = xrealloc (buf, buf_size);
     }
+  memcpy (buf, text, tf->cache_ns_offset - 1);
+  memcpy (buf + tf->cache_ns_offset - 1, ns_buf, ns_len);
+  memcpy (buf + tf->cache_ns_offset - 1 + ns_len,
+          text + tf->cache_ns_offset - 1,
+          text_len - (tf->cache_ns_offset - 1) + 1u);
+  return buf;
 }
 
 static const char *weekdays[] = {
@@ -772,7 +807,10 @@ ctime_format (struct timespec ts)
     {
       /* The time cannot be represented as a struct tm.
          Output it as an integer.  */
-      return format_date (ts, '@');
+      static struct time_format *epoch_format = NULL;
+      if (!epoch_format)
+        epoch_format = make_time_format ('@');
+      return (char *) format_date (ts, epoch_format);
     }
 }
 
@@ -794,34 +832,10 @@ file_sparseness (const struct stat *p)
 }
 
 
-static void
-checked_fprintf (struct format_val *dest, const char *fmt, ...)
-{
-  int rv;
-  va_list ap;
-
-  va_start (ap, fmt);
-  rv = vfprintf (dest->stream, fmt, ap);
-  va_end (ap);
-  if (rv < 0)
-    nonfatal_nontarget_file_error (errno, dest->filename);
-}
-
-static void
-checked_print_quoted (struct format_val *dest,
-                      const char *format, const char *s)
-{
-  int rv = print_quoted (dest->stream, dest->quote_opts, dest->dest_is_tty,
-                         format, s);
-  if (rv < 0)
-    nonfatal_nontarget_file_error (errno, dest->filename);
-}
-
-
 static void
 checked_fwrite (void *p, size_t siz, size_t nmemb, struct format_val *dest)
 {
-  const size_t items_written = fwrite (p, siz, nmemb, dest->stream);
+  const size_t items_written = fwrite (p, siz, nmemb, output_stream (dest));
   if (items_written < nmemb)
     nonfatal_nontarget_file_error (errno, dest->filename);
 }
@@ -829,7 +843,7 @@ checked_fwrite (void *p, size_t siz, size_t nmemb, struct format_val *dest)
 static void
 checked_fflush (struct format_val *dest)
 {
-  if (0 != fflush (dest->stream))
+  if (0 != fflush (output_stream (dest)))
     {
       nonfatal_nontarget_file_error (errno, dest->filename);
     }
@@ -868,469 +882,1194 @@ mode_to_filetype (mode_t m)
 
 
 
-static void
-do_fprintf (struct format_val *dest,
-            struct segment *segment,
-            const char *pathname, const struct stat *stat_buf)
+/* Return the permission bits of M using the traditional numbers, for
+ * %m.
+ */
+static unsigned int
+permission_bits (mode_t m)
 {
-  char hbuf[LONGEST_HUMAN_READABLE + 1];
-  const char *cp;
+  /* Output the mode portably using the traditional numbers,
+     even if the host unwisely uses some other numbering
+     scheme.  But help the compiler in the common case where
+     the host uses the traditional numbering scheme.  */
+  bool traditional_numbering_scheme =
+    (S_ISUID == 04000 && S_ISGID == 02000 && S_ISVTX == 01000
+     && S_IRUSR == 00400 && S_IWUSR == 00200 && S_IXUSR == 00100
+     && S_IRGRP == 00040 && S_IWGRP == 00020 && S_IXGRP == 00010
+     && S_IROTH == 00004 && S_IWOTH == 00002 && S_IXOTH == 00001);
+  return (traditional_numbering_scheme
+          ? m & MODE_ALL
+          : ((m & S_ISUID ? 04000 : 0)
+             | (m & S_ISGID ? 02000 : 0)
+             | (m & S_ISVTX ? 01000 : 0)
+             | (m & S_IRUSR ? 00400 : 0)
+             | (m & S_IWUSR ? 00200 : 0)
+             | (m & S_IXUSR ? 00100 : 0)
+             | (m & S_IRGRP ? 00040 : 0)
+             | (m & S_IWGRP ? 00020 : 0)
+             | (m & S_IXGRP ? 00010 : 0)
+             | (m & S_IROTH ? 00004 : 0)
+             | (m & S_IWOTH ? 00002 : 0)
+             | (m & S_IXOTH ? 00001 : 0)));
+}
 
-  switch (segment->segkind)
+/* Write the digits of V in BASE just before END, returning the
+ * address of the first digit.  A buffer of LONGEST_HUMAN_READABLE
+ * bytes is always long enough.
+ */
+static char *
+format_uint (char *end, uintmax_t v, unsigned int base)
+{
+  char *p = end;
+  do
     {
-    case KIND_PLAIN:           /* Plain text string (no % conversion). */
-      /* trusted */
-      checked_fwrite (segment->text, 1, segment->text_len, dest);
-      break;
+      *--p = '0' + v % base;
+      v /= base;
+    }
+  while (v);
+  return p;
+}
 
-    case KIND_STOP:            /* Terminate argument and flush output. */
-      /* trusted */
-      checked_fwrite (segment->text, 1, segment->text_len, dest);
-      checked_fflush (dest);
-      break;
+/* Write SIZE just before END as `ls -lh' does (with BASE 1024) or
+ * `ls -l --si' does (with BASE 1000), returning the address of the
+ * first character: sizes below BASE in full, and larger ones rounded
+ * up to two significant digits, with a unit suffix.  A buffer of
+ * LONGEST_HUMAN_READABLE bytes is always long enough.
+ */
+static char *
+format_human_size (char *end, uintmax_t size, unsigned int base)
+{
+  static const char binary_suffixes[] = "KMGTPE";
+  static const char si_suffixes[] = "kMGTPE";
+  const char *suffixes = 1024 == base ? binary_suffixes : si_suffixes;
+  uintmax_t unit = 1, q, r, tenths;
+  int exponent = 0;
+  char *p = end;
+
+  while (size / unit >= base && exponent < 6)
+    {
+      unit *= base;
+      exponent++;
+    }
+  if (!exponent)
+    return format_uint (end, size, 10);
 
-    case KIND_FORMAT:
-      switch (segment->format_char[0])
+  q = size / unit;
+  r = size % unit;
+  if (q < 10)
+    {
+      /* One decimal place, rounded up.  R * 10 + UNIT - 1 cannot
+       * overflow, since UNIT is at most 1024**6.
+       */
+      tenths = q * 10 + (r * 10 + unit - 1) / unit;
+      if (tenths < 100)
         {
-        case 'a':              /* atime in `ctime' format. */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text,
-                           ctime_format (get_stat_atime (stat_buf)));
-          break;
-        case 'b':              /* size in 512-byte blocks */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text,
-                           human_readable ((uintmax_t) ST_NBLOCKS (*stat_buf),
-                                           hbuf, human_ceiling,
-                                           ST_NBLOCKSIZE, 512));
-          break;
-        case 'c':              /* ctime in `ctime' format */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text,
-                           ctime_format (get_stat_ctime (stat_buf)));
-          break;
-        case 'd':              /* depth in search tree */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text, state.curdepth);
-          break;
-        case 'D':              /* Device on which file exists (stat.st_dev) */
-          /* trusted */
-          checked_fprintf (dest, segment->text,
-                           human_readable ((uintmax_t) stat_buf->st_dev, hbuf,
-                                           human_ceiling, 1, 1));
-          break;
-        case 'f':              /* base name of path */
-          /* sanitised */
-          {
-            char *base = base_name (pathname);
-            checked_print_quoted (dest, segment->text, base);
-            free (base);
-          }
-          break;
-        case 'F':              /* file system type */
-          /* trusted */
-          checked_print_quoted (dest, segment->text,
-                                filesystem_type (stat_buf, pathname));
-          break;
-        case 'g':              /* group name */
-          /* trusted */
-          /* (well, the actual group is selected by the user but
-           * its name was selected by the system administrator)
-           */
-          {
-            struct group *g;
-
-            g = getgrgid (stat_buf->st_gid);
-            if (g)
-              {
-                segment->text[segment->text_len] = 's';
-                checked_fprintf (dest, segment->text, g->gr_name);
-                break;
-              }
-          }
-          FALLTHROUGH;          /*...sometimes, so 'G' case. */
+          const char *point = localeconv ()->decimal_point;
+          *--p = suffixes[exponent - 1];
+          *--p = '0' + tenths % 10;
+          *--p = (point[0] && !point[1]) ? point[0] : '.';
+          *--p = '0' + tenths / 10;
+          return p;
+        }
+      q = 10;
+    }
+  else if (r)
+    {
+      q++;
+      if (q == base && exponent < 6)
+        {
+          /* For example, 1023.5K is shown as 1.0M.  */
+          const char *point = localeconv ()->decimal_point;
+          *--p = suffixes[exponent];
+          *--p = '0';
+          *--p = (point[0] && !point[1]) ? point[0] : '.';
+          *--p = '1';
+          return p;
+        }
+    }
+  *--p = suffixes[exponent - 1];
+  return format_uint (p, q, 10);
+}
 
-        case 'G':              /* GID number */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text,
-                           human_readable ((uintmax_t) stat_buf->st_gid, hbuf,
-                                           human_ceiling, 1, 1));
-          break;
-        case 'h':              /* leading directories part of path */
-          /* sanitised */
-          {
-            char *pname = xstrdup (pathname);
+/* Return a copy of the first LEN bytes of S.  The copy is overwritten
+ * by the next call.
+ */
+static char *
+path_prefix (const char *s, size_t len)
+{
+  static char *buf = NULL;
+  static size_t buf_size = 0;
 
-            /* Remove trailing slashes - unless it's the root '/' directory.  */
-            char *s = pname + strlen (pname) - 1;
-            for (; pname <= s; s--)
-              if (*s != '/')
-                break;
-            if (pname < s && *(s + 1) == '/')
-              *(s + 1) = '\0';
-
-            s = strrchr (pname, '/');
-            if (s == NULL)      /* No leading directories. */
-              {
-                /* If there is no slash in the pathname, we still
-                 * print the string because it contains characters
-                 * other than just '%s'.  The %h expands to ".".
-                 */
-                checked_print_quoted (dest, segment->text, ".");
-              }
-            else
-              {
-                *s = '\0';
-                checked_print_quoted (dest, segment->text, pname);
-              }
-            free (pname);
-          }
-          break;
+  if (buf_size <= len)
+    {
+      buf_size = len + 1;
+      buf = xrealloc (buf, buf_size);
+    }
+  memcpy (buf, s, len);
+  buf[len] = '\0';
+  return buf;
+}
 
-        case 'H':              /* ARGV element file was found under */
-          /* trusted */
-          {
-            char *s = xmalloc (state.starting_path_length + 1);
-            memcpy (s, pathname, state.starting_path_length);
-            s[state.starting_path_length] = 0;
-            checked_fprintf (dest, segment->text, s);
-            free (s);
-          }
-          break;
+/* Return S as print_quoted would print it to DEST.  The result may be
+ * overwritten by the next call.
+ */
+static const char *
+quote_for_dest (const struct format_val *dest, const char *s)
+{
+  static char *buf = NULL;
+  static size_t buf_size = 0;
+  size_t len;
 
-        case 'i':              /* inode number */
-          /* UNTRUSTED, but not exploitable I think */
-          /* POSIX does not guarantee that ino_t is unsigned or even
-           * integral (except as an XSI extension), but we'll work on
-           * fixing that if we ever get a report of a system where
-           * ino_t is indeed a signed integral type or a non-integral
-           * arithmetic type. */
-          checked_fprintf (dest, segment->text,
-                           human_readable ((uintmax_t) stat_buf->st_ino, hbuf,
-                                           human_ceiling, 1, 1));
-          break;
-        case 'k':              /* size in 1K blocks */
-          /* UNTRUSTED, but not exploitable I think */
-          checked_fprintf (dest, segment->text,
-                           human_readable ((uintmax_t) ST_NBLOCKS (*stat_buf),
-                                           hbuf, human_ceiling,
-                                           ST_NBLOCKSIZE, 1024));
-          break;
-        case 'l':              /* object of symlink */
-          /* sanitised */
-#ifdef S_ISLNK
-          {
-            char *linkname = NULL;
-
-            if (S_ISLNK (stat_buf->st_mode))
-              {
-                linkname = areadlinkat (state.cwd_dir_fd, state.rel_pathname);
-                if (linkname == NULL)
-                  {
-                    nonfatal_target_file_error (errno, pathname);
-                    state.exit_status = EXIT_FAILURE;
-                  }
-              }
-            if (linkname)
-              {
-                checked_print_quoted (dest, segment->text, linkname);
-              }
-            else
-              {
-                /* We still need to honour the field width etc., so this is
-                 * not a no-op.
-                 */
-                checked_print_quoted (dest, segment->text, "");
-              }
-            free (linkname);
-          }
-#endif /* S_ISLNK */
-          break;
+  if (!dest->dest_is_tty
+      || quoting_is_identity (dest->quote_opts, s, strlen (s)))
+    return s;                   /* no need to quote things. */
 
-        case 'M':              /* mode as 10 chars (eg., "-rwxr-x--x" */
-          /* UNTRUSTED, probably unexploitable */
-          {
-            char modestring[16];
-            filemodestring (stat_buf, modestring);
-            modestring[10] = '\0';
-            checked_fprintf (dest, segment->text, modestring);
-          }
-          break;
+  len = quotearg_buffer (buf, buf_size, s, -1, dest->quote_opts);
+  if (buf_size <= len)
+    {
+      buf_size = len + 1;
+      buf = xrealloc (buf, buf_size);
+      quotearg_buffer (buf, buf_size, s, -1, dest->quote_opts);
+    }
 
-        case 'm':              /* mode as octal number (perms only) */
-          /* UNTRUSTED, probably unexploitable */
-          {
-            /* Output the mode portably using the traditional numbers,
-               even if the host unwisely uses some other numbering
-               scheme.  But help the compiler in the common case where
-               the host uses the traditional numbering scheme.  */
-            mode_t m = stat_buf->st_mode;
-            bool traditional_numbering_scheme =
-              (S_ISUID == 04000 && S_ISGID == 02000 && S_ISVTX == 01000
-               && S_IRUSR == 00400 && S_IWUSR == 00200 && S_IXUSR == 00100
-               && S_IRGRP == 00040 && S_IWGRP == 00020 && S_IXGRP == 00010
-               && S_IROTH == 00004 && S_IWOTH == 00002 && S_IXOTH == 00001);
-            checked_fprintf (dest, segment->text,
-                             (traditional_numbering_scheme
-                              ? m & MODE_ALL
-                              : ((m & S_ISUID ? 04000 : 0)
-                                 | (m & S_ISGID ? 02000 : 0)
-                                 | (m & S_ISVTX ? 01000 : 0)
-                                 | (m & S_IRUSR ? 00400 : 0)
-                                 | (m & S_IWUSR ? 00200 : 0)
-                                 | (m & S_IXUSR ? 00100 : 0)
-                                 | (m & S_IRGRP ? 00040 : 0)
-                                 | (m & S_IWGRP ? 00020 : 0)
-                                 | (m & S_IXGRP ? 00010 : 0)
-                                 | (m & S_IROTH ? 00004 : 0)
-                                 | (m & S_IWOTH ? 00002 : 0)
-                                 | (m & S_IXOTH ? 00001 : 0))));
-          }
-          break;
+  /* Replace any remaining funny characters with '?'. */
+  len = qmark_chars (buf, len);
+  buf[len] = '\0';
+  return buf;
+}
 
-        case 'n':              /* number of links */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text,
-                           human_readable ((uintmax_t) stat_buf->st_nlink,
-                                           hbuf, human_ceiling, 1, 1));
-          break;
 
-        case 'p':              /* pathname */
-          /* sanitised */
-          checked_print_quoted (dest, segment->text, pathname);
-          break;
+/* Each file's output for -printf is assembled here and then written
+ * with a single call to fwrite.  The buffer only ever grows.
+ */
+static struct
+{
+  char *text;
+  size_t len;
+  size_t size;
+} outbuf;
 
-        case 'P':              /* pathname with ARGV element stripped */
-          /* sanitised */
-          if (state.curdepth > 0)
-            {
-              cp = pathname + state.starting_path_length;
-              if (*cp == '/')
-                /* Move past the slash between the ARGV element
-                   and the rest of the pathname.  But if the ARGV element
-                   ends in a slash, we didn't add another, so we've
-                   already skipped past it.  */
-                cp++;
-            }
-          else
-            {
-              cp = "";
-            }
-          checked_print_quoted (dest, segment->text, cp);
-          break;
+/* Make room for N more bytes in the output buffer and return the
+ * address at which they go.
+ */
+static char *
+outbuf_reserve (size_t n)
+{
+  while (outbuf.size - outbuf.len < n)
+    outbuf.text = x2nrealloc (outbuf.text, &outbuf.size, 1);
+  return outbuf.text + outbuf.len;
+}
 
-        case 's':              /* size in bytes */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text,
-                           human_readable ((uintmax_t) stat_buf->st_size,
-                                           hbuf, human_ceiling, 1, 1));
-          break;
+static void
+outbuf_append (const char *s, size_t n)
+{
+  memcpy (outbuf_reserve (n), s, n);
+  outbuf.len += n;
+}
 
-        case 'S':              /* sparseness */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text, file_sparseness (stat_buf));
-          break;
+static void
+outbuf_pad (size_t n)
+{
+  memset (outbuf_reserve (n), ' ', n);
+  outbuf.len += n;
+}
 
-        case 't':              /* mtime in `ctime' format */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text,
-                           ctime_format (get_stat_mtime (stat_buf)));
-          break;
+/* Append S, of length LEN, in a field of at least WIDTH bytes. */
+static void
+outbuf_append_field (const char *s, size_t len,
+                     size_t width, bool left_justify)
+{
+  if (!left_justify && len < width)
+    outbuf_pad (width - len);
+  outbuf_append (s, len);
+  if (left_justify && len < width)
+    outbuf_pad (width - len);
+}
 
-        case 'u':              /* user name */
-          /* trusted */
-          /* (well, the actual user is selected by the user on systems
-           * where chown is not restricted, but the user name was
-           * selected by the system administrator)
-           */
-          {
-            struct passwd *p;
+/* Append the output of snprintf for FMT, which we use for format
+ * flags that the compiled ops do not handle.
+ */
+static void
+outbuf_printf (struct format_val *dest, const char *fmt, ...)
+{
+  va_list ap;
+  int rv;
 
-            p = getpwuid (stat_buf->st_uid);
-            if (p)
-              {
-                segment->text[segment->text_len] = 's';
-                checked_fprintf (dest, segment->text, p->pw_name);
-                break;
-              }
-          }
-          FALLTHROUGH;          /* .. to case U */
+  outbuf_reserve (1);
+  while (true)
+    {
+      size_t avail = outbuf.size - outbuf.len;
 
-        case 'U':              /* UID number */
-          /* UNTRUSTED, probably unexploitable */
-          checked_fprintf (dest, segment->text,
-                           human_readable ((uintmax_t) stat_buf->st_uid, hbuf,
-                                           human_ceiling, 1, 1));
-          break;
+      va_start (ap, fmt);
+      rv = vsnprintf (outbuf.text + outbuf.len, avail, fmt, ap);
+      va_end (ap);
+      if (rv < 0)
+        {
+          nonfatal_nontarget_file_error (errno, dest->filename);
+          return;
+        }
+      if ((size_t) rv < avail)
+        {
+          outbuf.len += rv;
+          return;
+        }
+      outbuf_reserve (rv + 1u);
+    }
+}
+
+/* Write out whatever has been assembled so far. */
+static void
+outbuf_write (struct format_val *dest)
+{
+  if (outbuf.len)
+    {
+      checked_fwrite (outbuf.text, 1, outbuf.len, dest);
+      outbuf.len = 0;
+    }
+}
 
-          /* %Y: type of file system entry like `ls -l`:
-           *     (d,-,l,s,p,b,c,n) n=nonexistent (symlink)
+
+/* The format of a -printf or -fprintf is compiled by insert_fprintf
+ * into an array of ops, one per segment.  Plain integers, strings and
+ * file names with at most a field width and the `-' flag are
+ * rendered by hand; anything else is passed to snprintf with the text
+ * of the segment as the format.
+ */
+enum printf_op_kind
+{
+  OP_LITERAL,                   /* plain text, %% or \c */
+  OP_INTEGER,                   /* unsigned number */
+  OP_PADDED_INTEGER,            /* unsigned number with a field width */
+  OP_STRING,                    /* trusted string */
+  OP_MODE_STRING,               /* %M */
+  OP_QUOTED_NAME,               /* file name, sanitised for a terminal */
+  OP_FORMATTED                  /* anything else, using snprintf */
+};
+
+struct printf_op
+{
+  enum printf_op_kind kind;
+  const struct segment *segment;        /* segment compiled from */
+  size_t prefix_len;            /* length of the plain text before `%' */
+  size_t width;                 /* minimum field width */
+  bool left_justify;            /* `-' flag */
+  bool flush;                   /* \c: flush the output afterwards */
+  const char *name;             /* field name, for -printjson etc. */
+};
+
+/* The type of value a format directive prints. */
+enum printf_value
+{
+  VALUE_INTEGER,
+  VALUE_STRING,
+  VALUE_NAME,                   /* a string we must sanitise */
+  VALUE_DOUBLE
+};
+
+static enum printf_value
+directive_value (const struct segment *segment)
+{
+  if (segment->format_char[1])  /* Component of date. */
+    return VALUE_STRING;
+
+  switch (segment->format_char[0])
+    {
+    case 'b':
+    case 'd':
+    case 'D':
+    case 'G':
+    case 'i':
+    case 'k':
+    case 'm':
+    case 'n':
+    case 's':
+    case 'U':
+      return VALUE_INTEGER;
+
+    case 'f':
+    case 'F':
+    case 'h':
+    case 'l':
+    case 'p':
+    case 'P':
+      return VALUE_NAME;
+
+    case 'S':
+      return VALUE_DOUBLE;
+
+    default:
+      return VALUE_STRING;
+    }
+}
+
+/* Parse the flags and field width between P and END into OP.  Return
+ * false if they contain anything other than `-' flags and a width.
+ */
+static bool
+parse_simple_flags (const char *p, const char *end, struct printf_op *op)
+{
+  for (; p < end && *p == '-'; p++)
+    op->left_justify = true;
+  if (p < end && *p == '0')     /* zero padding */
+    return false;
+  for (; p < end && ISDIGIT (*p); p++)
+    {
+      if (op->width > (INT_MAX - 9) / 10)
+        return false;           /* let snprintf diagnose it */
+      op->width = op->width * 10 + (*p - '0');
+    }
+  return p == end;
+}
+
+static void
+compile_segment (struct printf_op *op, const struct segment *segment)
+{
+  const char *directive;
+
+  op->segment = segment;
+  op->width = 0;
+  op->left_justify = false;
+  op->flush = (KIND_STOP == segment->segkind);
+  op->name = NULL;
+
+  if (KIND_FORMAT != segment->segkind || '%' == segment->format_char[0])
+    {
+      op->kind = OP_LITERAL;
+      op->prefix_len = segment->text_len;
+      return;
+    }
+
+  /* The plain text before a directive never contains a `%'. */
+  directive = strchr (segment->text, '%');
+  assert (directive != NULL);
+  op->prefix_len = directive - segment->text;
+
+  if (!parse_simple_flags (directive + 1,
+                           segment->text + segment->text_len, op))
+    {
+      op->kind = OP_FORMATTED;
+      return;
+    }
+
+  switch (directive_value (segment))
+    {
+    case VALUE_INTEGER:
+      op->kind = op->width ? OP_PADDED_INTEGER : OP_INTEGER;
+      break;
+    case VALUE_STRING:
+      op->kind = ('M' == segment->format_char[0]
+                  && !segment->format_char[1]) ? OP_MODE_STRING : OP_STRING;
+      break;
+    case VALUE_NAME:
+      op->kind = OP_QUOTED_NAME;
+      break;
+    case VALUE_DOUBLE:
+      op->kind = OP_FORMATTED;
+      break;
+    }
+}
+
+/* The types of value in a -printtlv record. */
+enum tlv_type
+{
+  TLV_BYTES = 0,                /* a string, without a terminating null */
+  TLV_UNSIGNED = 1,             /* an unsigned 64-bit integer */
+  TLV_DOUBLE = 2                /* an IEEE 754 double */
+};
+
+/* Field numbers in a -printtlv record are a single byte. */
+enum
+{
+  TLV_MAX_FIELDS = 256
+};
+
+/* Converters from ST_NBLOCKSIZE-byte blocks, for %b and %k. */
+static struct block_converter sector_blocks;
+static struct block_converter kilobyte_blocks;
+
+/* Build the ops array of VEC from its list of segments. */
+static void
+compile_printf (struct format_val *vec)
+{
+  const struct segment *segment;
+  struct printf_op *op;
+  size_t n = 0;
+
+  block_converter_init (&sector_blocks, ST_NBLOCKSIZE, 512);
+  block_converter_init (&kilobyte_blocks, ST_NBLOCKSIZE, 1024);
+
+  for (segment = vec->segment; segment; segment = segment->next)
+    ++n;
+
+  vec->ops = xnmalloc (n, sizeof *vec->ops);
+  vec->n_ops = n;
+  for (segment = vec->segment, op = vec->ops; segment;
+       segment = segment->next, op++)
+    compile_segment (op, segment);
+}
+
+
+/* Return the value of the integer directive CONV for the current file. */
+static uintmax_t
+integer_value (char conv, const struct stat *stat_buf)
+{
+  switch (conv)
+    {
+    case 'd':                  /* depth in search tree */
+      return state.curdepth;
+    case 'D':                  /* Device on which file exists (stat.st_dev) */
+      return stat_buf->st_dev;
+    case 'G':                  /* GID number */
+      return stat_buf->st_gid;
+    case 'b':                  /* size in 512-byte blocks */
+      return convert_blocks (&sector_blocks, ST_NBLOCKS (*stat_buf));
+    case 'i':                  /* inode number */
+      /* POSIX does not guarantee that ino_t is unsigned or even
+       * integral (except as an XSI extension), but we'll work on
+       * fixing that if we ever get a report of a system where
+       * ino_t is indeed a signed integral type or a non-integral
+       * arithmetic type. */
+      return stat_buf->st_ino;
+    case 'k':                  /* size in 1K blocks */
+      return convert_blocks (&kilobyte_blocks, ST_NBLOCKS (*stat_buf));
+    case 'm':                  /* mode as octal number (perms only) */
+      return permission_bits (stat_buf->st_mode);
+    case 'n':                  /* number of links */
+      return stat_buf->st_nlink;
+    case 's':                  /* size in bytes */
+      return stat_buf->st_size;
+    case 'U':                  /* UID number */
+      return stat_buf->st_uid;
+    default:
+      assert (0);
+      abort ();
+    }
+}
+
+/* Return the text of the date directive SEGMENT. */
+static const char *
+date_value (const struct segment *segment, const struct stat *stat_buf)
+{
+  struct timespec ts;
+  int valid = 0;
+
+  switch (segment->format_char[0])
+    {
+    case 'A':
+      ts = get_stat_atime (stat_buf);
+      valid = 1;
+      break;
+    case 'B':
+      ts = get_stat_birthtime (stat_buf);
+      if ('@' == segment->format_char[1])
+        valid = 1;
+      else
+        valid = (ts.tv_nsec >= 0);
+      break;
+    case 'C':
+      ts = get_stat_ctime (stat_buf);
+      valid = 1;
+      break;
+    case 'T':
+      ts = get_stat_mtime (stat_buf);
+      valid = 1;
+      break;
+    default:
+      assert (0);
+      abort ();
+    }
+  /* We trust the output of format_date not to contain
+   * nasty characters, though the value of the date
+   * is itself untrusted data.
+   */
+  if (valid)
+    return format_date (ts, segment->time_format);
+
+  /* The specified timestamp is not available, output
+   * nothing for the timestamp, but use the rest (so that
+   * for example find foo -printf '[%Bs] %p\n' can print
+   * "[] foo").
+   */
+  return "";
+}
+
+/* Return the text of the string or file name directive SEGMENT for
+ * the current file.  File names are not yet sanitised.  The result
+ * may be in SCRATCH (of LONGEST_HUMAN_READABLE + 1 bytes) or in a
+ * static buffer, so it must be used before the next call.
+ */
+static const char *
+string_value (const struct segment *segment,
+              const char *pathname, const struct stat *stat_buf,
+              char *scratch)
+{
+  char *end = scratch + LONGEST_HUMAN_READABLE;
+
+  if (segment->format_char[1])
+    return date_value (segment, stat_buf);
+
+  *end = '\0';
+  switch (segment->format_char[0])
+    {
+    case 'a':                  /* atime in `ctime' format. */
+      return ctime_format (get_stat_atime (stat_buf));
+
+    case 'c':                  /* ctime in `ctime' format */
+      return ctime_format (get_stat_ctime (stat_buf));
+
+    case 'f':                  /* base name of path */
+      if (state.path_base)
+        {
+          return state.path_base;
+        }
+      else
+        {
+          char *base = base_name (pathname);
+          char *copy = path_prefix (base, strlen (base));
+          free (base);
+          return copy;
+        }
+
+    case 'F':                  /* file system type */
+      return filesystem_type (stat_buf, pathname);
+
+    case 'g':                  /* group name */
+      /* (well, the actual group is selected by the user but
+       * its name was selected by the system administrator)
+       */
+      {
+        struct group *g = getgrgid (stat_buf->st_gid);
+        if (g)
+          return g->gr_name;
+        /* ...sometimes, the GID number. */
+        return format_uint (end, stat_buf->st_gid, 10);
+      }
+
+    case 'h':                  /* leading directories part of path */
+      if (state.path_base)
+        {
+          /* The leading directories are a prefix of the pathname
+           * whose length we already know.
            */
-        case 'Y':              /* in case of symlink */
-          /* trusted */
-          {
+          return path_prefix (pathname, state.path_dirlen);
+        }
+      else
+        {
+          char *pname = path_prefix (pathname, strlen (pathname));
+
+          /* Remove trailing slashes - unless it's the root '/' directory.  */
+          char *s = pname + strlen (pname) - 1;
+          for (; pname <= s; s--)
+            if (*s != '/')
+              break;
+          if (pname < s && *(s + 1) == '/')
+            *(s + 1) = '\0';
+
+          s = strrchr (pname, '/');
+          if (s == NULL)        /* No leading directories. */
+            {
+              /* If there is no slash in the pathname, we still
+               * print the string because it contains characters
+               * other than just '%s'.  The %h expands to ".".
+               */
+              return ".";
+            }
+          *s = '\0';
+          return pname;
+        }
+
+    case 'H':                  /* ARGV element file was found under */
+      return path_prefix (pathname, state.starting_path_length);
+
+    case 'j':                  /* size with an SI suffix */
+      return format_human_size (end, stat_buf->st_size, 1000);
+
+    case 'l':                  /* object of symlink */
 #ifdef S_ISLNK
-            if (S_ISLNK (stat_buf->st_mode))
-              {
-                struct stat sbuf;
-                /* %Y needs to stat the symlink target regardless of
-                 * whether we would normally follow symbolic links or not.
-                 * (Actually we do not even come here when following_links()
-                 *  other than the ENOENT case.)
-                 */
-                if (fstatat (state.cwd_dir_fd, state.rel_pathname, &sbuf, 0)
-                    != 0)
-                  {
-                    if ((errno == ENOENT) || (errno == ENOTDIR))
-                      {
-                        checked_fprintf (dest, segment->text, "N");
-                        break;
-                      }
-                    else if (errno == ELOOP)
-                      {
-                        checked_fprintf (dest, segment->text, "L");
-                        break;
-                      }
-                    else
-                      {
-                        checked_fprintf (dest, segment->text, "?");
-                        error (0, errno, "%s",
-                               safely_quote_err_filename (0, pathname));
-                        /* exit_status = EXIT_FAILURE;
-                           return ; */
-                        break;
-                      }
-                  }
-                checked_fprintf (dest, segment->text,
-                                 mode_to_filetype (sbuf.st_mode & S_IFMT));
-              }
-            else
+      if (S_ISLNK (stat_buf->st_mode))
+        {
+          const char *linkname = get_link_target ();
+          if (linkname)
+            return linkname;
+          nonfatal_target_file_error (errno, pathname);
+          state.exit_status = EXIT_FAILURE;
+        }
 #endif /* S_ISLNK */
-              {
-                checked_fprintf (dest, segment->text,
-                                 mode_to_filetype (stat_buf->st_mode &
-                                                   S_IFMT));
-              }
-          }
-          break;
+      /* We still need to honour the field width etc., so this is
+       * not a no-op.
+       */
+      return "";
 
-        case 'y':
-          /* trusted */
-          {
-            checked_fprintf (dest, segment->text,
-                             mode_to_filetype (stat_buf->st_mode & S_IFMT));
-          }
-          break;
+    case 'M':                  /* mode as 10 chars (eg., "-rwxr-x--x" */
+      filemodestring (stat_buf, scratch);
+      scratch[10] = '\0';
+      return scratch;
 
-        case 'Z':              /* SELinux security context */
-          {
-            char *scontext;
-            int rv =
-              (*options.x_getfilecon) (state.cwd_dir_fd, state.rel_pathname,
-                                       &scontext);
-            if (rv < 0)
-              {
-                /* If getfilecon fails, there will in the general case
-                   still be some text to print.   We just make %Z expand
-                   to an empty string. */
-                checked_fprintf (dest, segment->text, "");
-
-                error (0, errno, _("getfilecon failed: %s"),
-                       safely_quote_err_filename (0, pathname));
-                state.exit_status = EXIT_FAILURE;
-              }
-            else
-              {
-                checked_fprintf (dest, segment->text, scontext);
-                freecon (scontext);
-              }
-          }
-          break;
+    case 'p':                  /* pathname */
+      return pathname;
 
-        case '%':
-          checked_fwrite (segment->text, 1, segment->text_len, dest);
-          break;
+    case 'P':                  /* pathname with ARGV element stripped */
+      if (state.curdepth > 0)
+        {
+          const char *cp = pathname + state.starting_path_length;
+          if (*cp == '/')
+            /* Move past the slash between the ARGV element
+               and the rest of the pathname.  But if the ARGV element
+               ends in a slash, we didn't add another, so we've
+               already skipped past it.  */
+            cp++;
+          return cp;
+        }
+      return "";
 
-        case 0:
-          /* Trailing single %.  This should have been rejected by
-             insert_fprintf.  We use %s here in the error message
-             simply to ensure that the error message matches the one
-             in insert_fprintf, easing the translation burden.
+    case 't':                  /* mtime in `ctime' format */
+      return ctime_format (get_stat_mtime (stat_buf));
+
+    case 'u':                  /* user name */
+      /* (well, the actual user is selected by the user on systems
+       * where chown is not restricted, but the user name was
+       * selected by the system administrator)
+       */
+      {
+        struct passwd *p = getpwuid (stat_buf->st_uid);
+        if (p)
+          return p->pw_name;
+        /* ...sometimes, the UID number. */
+        return format_uint (end, stat_buf->st_uid, 10);
+      }
+
+      /* %Y: type of file system entry like `ls -l`:
+       *     (d,-,l,s,p,b,c,n) n=nonexistent (symlink)
+       */
+    case 'Y':                  /* in case of symlink */
+#ifdef S_ISLNK
+      if (S_ISLNK (stat_buf->st_mode))
+        {
+          const struct stat *target;
+          /* %Y needs to stat the symlink target regardless of
+           * whether we would normally follow symbolic links or not.
+           * (Actually we do not even come here when following_links()
+           *  other than the ENOENT case.)
            */
-          error (EXIT_FAILURE, 0, _("error: %s at end of format string"),
-                 "%");
-           /*NOTREACHED*/ break;
+          if (get_link_target_stat (&target) != 0)
+            {
+              if ((errno == ENOENT) || (errno == ENOTDIR))
+                return "N";
+              if (errno == ELOOP)
+                return "L";
+              error (0, errno, "%s", safely_quote_err_filename (0, pathname));
+              /* exit_status = EXIT_FAILURE; */
+              return "?";
+            }
+          return mode_to_filetype (target->st_mode & S_IFMT);
+        }
+#endif /* S_ISLNK */
+      return mode_to_filetype (stat_buf->st_mode & S_IFMT);
+
+    case 'y':
+      return mode_to_filetype (stat_buf->st_mode & S_IFMT);
+
+    case 'z':                  /* size with a binary suffix */
+      return format_human_size (end, stat_buf->st_size, 1024);
+
+    case 'Z':                  /* SELinux security context */
+      {
+        const struct file_context *ctx = get_file_context (stat_buf);
+        if (ctx)
+          return file_context_text (ctx);
+
+        /* If getfilecon fails, there will in the general case
+           still be some text to print.   We just make %Z expand
+           to an empty string. */
+        error (0, errno, _("getfilecon failed: %s"),
+               safely_quote_err_filename (0, pathname));
+        state.exit_status = EXIT_FAILURE;
+        return "";
+      }
+
+    default:
+      assert (0);
+      abort ();
+    }
+}
+
+/* Render the directive SEGMENT, which has flags the compiled ops do
+ * not handle, using its text as a format for snprintf.
+ */
+static void
+render_formatted (struct format_val *dest, const struct segment *segment,
+                  const char *pathname, const struct stat *stat_buf,
+                  char *scratch)
+{
+  switch (directive_value (segment))
+    {
+    case VALUE_INTEGER:
+      /* Only %d and %m honour the #, 0 and + flags; the other numbers
+       * are printed as strings.
+       */
+      if ('d' == segment->format_char[0])
+        {
+          outbuf_printf (dest, segment->text, state.curdepth);
+        }
+      else if ('m' == segment->format_char[0])
+        {
+          outbuf_printf (dest, segment->text,
+                         permission_bits (stat_buf->st_mode));
+        }
+      else
+        {
+          char *end = scratch + LONGEST_HUMAN_READABLE;
+          *end = '\0';
+          outbuf_printf (dest, segment->text,
+                         format_uint (end,
+                                      integer_value (segment->format_char[0],
+                                                     stat_buf), 10));
         }
-      /* end of KIND_FORMAT case */
+      break;
+
+    case VALUE_STRING:
+      outbuf_printf (dest, segment->text,
+                     string_value (segment, pathname, stat_buf, scratch));
+      break;
+
+    case VALUE_NAME:
+      outbuf_printf (dest, segment->text,
+                     quote_for_dest (dest,
+                                     string_value (segment, pathname,
+                                                   stat_buf, scratch)));
+      break;
+
+    case VALUE_DOUBLE:
+      outbuf_printf (dest, segment->text, file_sparseness (stat_buf));
       break;
     }
 }
 
+static void
+render_op (struct format_val *dest, const struct printf_op *op,
+           const char *pathname, const struct stat *stat_buf)
+{
+  char scratch[LONGEST_HUMAN_READABLE + 1];
+  const struct segment *segment = op->segment;
+  const char *s;
+  char *end;
+
+  if (OP_FORMATTED == op->kind)
+    {
+      render_formatted (dest, segment, pathname, stat_buf, scratch);
+      return;
+    }
+
+  outbuf_append (segment->text, op->prefix_len);
+  switch (op->kind)
+    {
+    case OP_LITERAL:
+      break;
+
+    case OP_INTEGER:
+    case OP_PADDED_INTEGER:
+      end = scratch + sizeof scratch;
+      s = format_uint (end,
+                       integer_value (segment->format_char[0], stat_buf),
+                       'm' == segment->format_char[0] ? 8 : 10);
+      if (OP_INTEGER == op->kind)
+        outbuf_append (s, end - s);
+      else
+        outbuf_append_field (s, end - s, op->width, op->left_justify);
+      break;
+
+    case OP_MODE_STRING:
+      filemodestring (stat_buf, scratch);
+      outbuf_append_field (scratch, 10, op->width, op->left_justify);
+      break;
+
+    case OP_STRING:
+      s = string_value (segment, pathname, stat_buf, scratch);
+      outbuf_append_field (s, strlen (s), op->width, op->left_justify);
+      break;
+
+    case OP_QUOTED_NAME:
+      s = quote_for_dest (dest,
+                          string_value (segment, pathname, stat_buf,
+                                        scratch));
+      outbuf_append_field (s, strlen (s), op->width, op->left_justify);
+      break;
+
+    case OP_FORMATTED:
+      assert (0);
+      abort ();
+    }
+}
+
 bool
 pred_fprintf (const char *pathname, struct stat *stat_buf,
               struct predicate *pred_ptr)
 {
   struct format_val *dest = &pred_ptr->args.printf_vec;
-  struct segment *segment;
+  size_t i;
 
-  for (segment = dest->segment; segment; segment = segment->next)
+  for (i = 0; i < dest->n_ops; i++)
     {
-      if ((KIND_FORMAT == segment->segkind) && segment->format_char[1]) /* Component of date. */
+      const struct printf_op *op = &dest->ops[i];
+
+      render_op (dest, op, pathname, stat_buf);
+      if (op->flush)            /* \c: terminate argument and flush output. */
         {
-          struct timespec ts;
-          int valid = 0;
+          outbuf_write (dest);
+          checked_fflush (dest);
+        }
+    }
+  outbuf_write (dest);
+  return true;
+}
 
-          switch (segment->format_char[0])
-            {
-            case 'A':
-              ts = get_stat_atime (stat_buf);
-              valid = 1;
-              break;
-            case 'B':
-              ts = get_stat_birthtime (stat_buf);
-              if ('@' == segment->format_char[1])
-                valid = 1;
-              else
-                valid = (ts.tv_nsec >= 0);
-              break;
-            case 'C':
-              ts = get_stat_ctime (stat_buf);
-              valid = 1;
-              break;
-            case 'T':
-              ts = get_stat_mtime (stat_buf);
-              valid = 1;
-              break;
-            default:
-              assert (0);
-              abort ();
-            }
-          /* We trust the output of format_date not to contain
-           * nasty characters, though the value of the date
-           * is itself untrusted data.
-           */
-          if (valid)
+
+/* -printjson, -fprintjson, -printtlv and -fprinttlv print a record for
+ * each file, made of fields given as a comma-separated list of -printf
+ * directives, each optionally preceded by NAME=.  Each field becomes
+ * one segment (and so one op), whose op carries the field's name.
+ */
+bool
+insert_fprint_fields (struct format_val *vec,
+                      const struct parser_table *entry, char *fields)
+{
+  struct predicate *our_pred;
+  struct segment **segmentp;
+  const char **names = NULL;
+  size_t names_alloc = 0, n_fields = 0, i;
+  char *item, *next;
+
+  our_pred = insert_primary (entry, fields);
+  our_pred->side_effects = our_pred->no_default_print = true;
+  our_pred->args.printf_vec = *vec;
+  our_pred->need_type = false;
+  our_pred->need_stat = false;
+  our_pred->p_cost = NeedsNothing;
+
+  segmentp = &our_pred->args.printf_vec.segment;
+  *segmentp = NULL;
+
+  for (item = fields; item; item = next)
+    {
+      char *directive;
+      const char *name;
+      size_t len;
+
+      next = strchr (item, ',');
+      if (next)
+        *next++ = '\0';
+
+      directive = strchr (item, '=');
+      if (directive)
+        {
+          *directive++ = '\0';
+          name = item;
+        }
+      else
+        {
+          directive = item;
+          name = item + 1;      /* the directive without the `%' */
+        }
+
+      len = ('%' == directive[0])
+        ? get_format_specifer_length (directive[1]) : 0;
+      if (0 == len || '%' == directive[1] || '\0' == *name
+          || strlen (directive + 1) != len)
+        {
+          error (EXIT_FAILURE, 0,
+                 _("invalid field %s for %s: expected a -printf directive "
+                   "such as %%p, optionally preceded by NAME="),
+                 quote (directive), entry->parser_name);
+        }
+      if (TLV_MAX_FIELDS == n_fields && pred_is (our_pred, pred_fprinttlv))
+        {
+          error (EXIT_FAILURE, 0, _("%s supports at most %d fields"),
+                 entry->parser_name, (int) TLV_MAX_FIELDS);
+        }
+
+      segmentp = make_segment (segmentp, directive, 1, KIND_FORMAT,
+                               directive[1], 2 == len ? directive[2] : 0,
+                               our_pred);
+      if (names_alloc == n_fields)
+        names = x2nrealloc (names, &names_alloc, sizeof *names);
+      names[n_fields++] = name;
+    }
+
+  compile_printf (&our_pred->args.printf_vec);
+  assert (our_pred->args.printf_vec.n_ops == n_fields);
+  for (i = 0; i < n_fields; i++)
+    our_pred->args.printf_vec.ops[i].name = names[i];
+  free (names);
+  return true;
+}
+
+/* Return the length of the UTF-8 sequence at S, or 0 if S does not
+ * start with a valid multibyte sequence (RFC 3629).  S is terminated
+ * by a null character, which is never a continuation byte.
+ */
+static size_t
+utf8_sequence_length (const unsigned char *s)
+{
+#define CONT(c) (0x80 <= (c) && (c) <= 0xBF)
+  if (0xC2 <= s[0] && s[0] <= 0xDF)
+    return CONT (s[1]) ? 2 : 0;
+  if (0xE0 <= s[0] && s[0] <= 0xEF)
+    {
+      const unsigned char lo = (0xE0 == s[0]) ? 0xA0 : 0x80;
+      const unsigned char hi = (0xED == s[0]) ? 0x9F : 0xBF;   /* surrogates */
+      return (lo <= s[1] && s[1] <= hi && CONT (s[2])) ? 3 : 0;
+    }
+  if (0xF0 <= s[0] && s[0] <= 0xF4)
+    {
+      const unsigned char lo = (0xF0 == s[0]) ? 0x90 : 0x80;
+      const unsigned char hi = (0xF4 == s[0]) ? 0x8F : 0xBF;   /* U+10FFFF */
+      return (lo <= s[1] && s[1] <= hi && CONT (s[2]) && CONT (s[3]))
+        ? 4 : 0;
+    }
+  return 0;
+#undef CONT
+}
+
+/* Append S as a JSON string.  File names need not be valid UTF-8, so
+ * each byte which is not part of a valid sequence is written as a
+ * lone low surrogate, \udcXX, as Python's "surrogateescape" does.
+ * This keeps the output pure ASCII or valid UTF-8, and lets consumers
+ * recover the original bytes.
+ */
+static void
+outbuf_append_json_string (const char *s)
+{
+  static const char hexdigits[] = "0123456789abcdef";
+  const unsigned char *p = (const unsigned char *) s;
+
+  outbuf_append ("\"", 1);
+  while (*p)
+    {
+      const unsigned char *run = p;
+      size_t n;
+      char *out;
+
+      /* Copy the longest run of characters which need no escaping. */
+      while (true)
+        {
+          if (*p < 0x80)
             {
-              /* trusted */
-              checked_fprintf (dest, segment->text,
-                               format_date (ts, segment->format_char[1]));
+              if (*p < 0x20 || '"' == *p || '\\' == *p)
+                break;
+              p++;
             }
+          else if ((n = utf8_sequence_length (p)) != 0)
+            p += n;
           else
-            {
-              /* The specified timestamp is not available, output
-               * nothing for the timestamp, but use the rest (so that
-               * for example find foo -printf '[%Bs] %p\n' can print
-               * "[] foo").
-               */
-              /* trusted */
-              checked_fprintf (dest, segment->text, "");
-            }
+            break;
         }
-      else
+      outbuf_append ((const char *) run, p - run);
+
+      switch (*p)
+        {
+        case '\0':
+          break;
+        case '"':
+        case '\\':
+          out = outbuf_reserve (2);
+          out[0] = '\\';
+          out[1] = *p++;
+          outbuf.len += 2;
+          break;
+        case '\b':
+          outbuf_append ("\\b", 2);
+          p++;
+          break;
+        case '\f':
+          outbuf_append ("\\f", 2);
+          p++;
+          break;
+        case '\n':
+          outbuf_append ("\\n", 2);
+          p++;
+          break;
+        case '\r':
+          outbuf_append ("\\r", 2);
+          p++;
+          break;
+        case '\t':
+          outbuf_append ("\\t", 2);
+          p++;
+          break;
+        default:
+          /* Another control character, or a byte which is not valid
+             UTF-8. */
+          out = outbuf_reserve (6);
+          memcpy (out, (*p < 0x80) ? "\\u00" : "\\udc", 4);
+          out[4] = hexdigits[*p >> 4];
+          out[5] = hexdigits[*p & 0xF];
+          outbuf.len += 6;
+          p++;
+          break;
+        }
+    }
+  outbuf_append ("\"", 1);
+}
+
+/* Append D as a JSON number, or null if it is not finite.  JSON
+ * requires a `.' whatever the locale's decimal point is.
+ */
+static void
+outbuf_append_json_double (double d)
+{
+  char buf[64];
+  const char *point = localeconv ()->decimal_point;
+  const size_t point_len = strlen (point);
+  char *p;
+
+  if (!isfinite (d))
+    {
+      outbuf_append ("null", 4);
+      return;
+    }
+  snprintf (buf, sizeof buf, "%g", d);
+  if (point_len && !(1 == point_len && '.' == point[0])
+      && (p = strstr (buf, point)) != NULL)
+    {
+      *p = '.';
+      memmove (p + 1, p + point_len, strlen (p + point_len) + 1);
+    }
+  outbuf_append (buf, strlen (buf));
+}
+
+bool
+pred_fprintjson (const char *pathname, struct stat *stat_buf,
+                 struct predicate *pred_ptr)
+{
+  struct format_val *dest = &pred_ptr->args.printf_vec;
+  char scratch[LONGEST_HUMAN_READABLE + 1];
+  char *end = scratch + sizeof scratch;
+  size_t i;
+
+  outbuf_append ("{", 1);
+  for (i = 0; i < dest->n_ops; i++)
+    {
+      const struct segment *segment = dest->ops[i].segment;
+      const char conv = segment->format_char[0];
+      const char *s;
+
+      if (i)
+        outbuf_append (",", 1);
+      outbuf_append_json_string (dest->ops[i].name);
+      outbuf_append (":", 1);
+
+      switch (directive_value (segment))
+        {
+        case VALUE_INTEGER:
+          s = format_uint (end, integer_value (conv, stat_buf),
+                           'm' == conv ? 8 : 10);
+          /* %m is a string of octal digits, as for -printf. */
+          if ('m' == conv)
+            outbuf_append ("\"", 1);
+          outbuf_append (s, end - s);
+          if ('m' == conv)
+            outbuf_append ("\"", 1);
+          break;
+
+        case VALUE_STRING:
+        case VALUE_NAME:
+          outbuf_append_json_string (string_value (segment, pathname,
+                                                   stat_buf, scratch));
+          break;
+
+        case VALUE_DOUBLE:
+          outbuf_append_json_double (file_sparseness (stat_buf));
+          break;
+        }
+    }
+  outbuf_append ("}\n", 2);
+  outbuf_write (dest);
+  return true;
+}
+
+/* Append the N low-order bytes of V, least significant first. */
+static void
+outbuf_append_le (uintmax_t v, size_t n)
+{
+  char *out = outbuf_reserve (n);
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      out[i] = v & 0xFF;
+      v >>= 8;
+    }
+  outbuf.len += n;
+}
+
+static void
+outbuf_append_tlv_header (size_t field, enum tlv_type type, size_t len)
+{
+  outbuf_append_le (field, 1);
+  outbuf_append_le (type, 1);
+  outbuf_append_le (len, 4);
+}
+
+/* Each record written by -printtlv is a 4-byte length followed by
+ * that many bytes of fields.  Each field is a 1-byte field number
+ * (its position in the list of fields, from 0), a 1-byte type, a
+ * 4-byte length and the value.  All numbers are little-endian.
+ */
+bool
+pred_fprinttlv (const char *pathname, struct stat *stat_buf,
+                struct predicate *pred_ptr)
+{
+  struct format_val *dest = &pred_ptr->args.printf_vec;
+  char scratch[LONGEST_HUMAN_READABLE + 1];
+  const size_t start = outbuf.len;
+  size_t i, body_len;
+
+  outbuf_append_le (0, 4);      /* filled in below. */
+  for (i = 0; i < dest->n_ops; i++)
+    {
+      const struct segment *segment = dest->ops[i].segment;
+
+      switch (directive_value (segment))
         {
-          /* Print a segment which is not a date. */
-          do_fprintf (dest, segment, pathname, stat_buf);
+        case VALUE_INTEGER:
+          outbuf_append_tlv_header (i, TLV_UNSIGNED, 8);
+          outbuf_append_le (integer_value (segment->format_char[0],
+                                           stat_buf), 8);
+          break;
+
+        case VALUE_STRING:
+        case VALUE_NAME:
+          {
+            const char *s = string_value (segment, pathname, stat_buf,
+                                          scratch);
+            const size_t len = strlen (s);
+            outbuf_append_tlv_header (i, TLV_BYTES, len);
+            outbuf_append (s, len);
+          }
+          break;
+
+        case VALUE_DOUBLE:
+          {
+            const double d = file_sparseness (stat_buf);
+            uint64_t bits;
+
+            memcpy (&bits, &d, sizeof bits);
+            outbuf_append_tlv_header (i, TLV_DOUBLE, 8);
+            outbuf_append_le (bits, 8);
+          }
+          break;
         }
     }
+
+  /* A record holds at most a few file names, which cannot come close
+   * to 4GiB.
+   */
+  body_len = outbuf.len - start - 4;
+  for (i = 0; i < 4; i++)
+    {
+      outbuf.text[start + i] = body_len & 0xFF;
+      body_len >>= 8;
+    }
+  outbuf_write (dest);
   return true;
 }
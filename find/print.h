@@ -31,5 +31,8 @@ struct segment **make_segment (struct segment **segment,
 bool
 insert_fprintf (struct format_val *vec,
                 const struct parser_table *entry, char *format);
+bool
+insert_fprint_fields (struct format_val *vec,
+                      const struct parser_table *entry, char *fields);
 
 #endif /* PRINT_H */
@@ -21,30 +21,57 @@
 /* system headers. */
 #include <assert.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#if HAVE_GETRLIMIT
+# include <sys/resource.h>
+#endif
 
 /* gnulib headers. */
 #include "cloexec.h"
 #include "hash.h"
 #include "stdio--.h"
+#include "xalloc.h"
 
 /* find headers. */
 #include "sharefile.h"
 #include "defs.h"
+#include "system.h"
 
 
 enum
 {
-  DefaultHashTableSize = 11
+  DefaultHashTableSize = 64,
+
+  /* The total size of the large output buffers we give to shared
+   * files.  Files opened once this is used up keep the buffer stdio
+   * chose for them.
+   */
+  BufferBudget = 64 * OutputBufferSize,
+
+  /* The number of file descriptors we leave for everything else
+   * (directories being searched, commands being run, and so on).
+   */
+  ReservedFds = 32
 };
 
 struct sharefile
 {
   char *mode;
   Hash_table *table;
+
+  /* All the entries, open or not, for finding the ones to close.  */
+  struct SharefileEntry **entries;
+  size_t n_entries;
+  size_t entries_alloc;
+
+  size_t n_open;                /* Entries whose fp is not NULL. */
+  size_t max_open;              /* Close some files before exceeding this. */
+  size_t buffer_bytes;          /* Large buffers handed out so far. */
+  uintmax_t clock;              /* Counts calls to sharefile_stream. */
 };
 
 
@@ -55,14 +82,18 @@ struct sharefile
  *
  * However, we remember the name of each file that we opened.  This
  * allows us to issue a fatal error message when (flushing and)
- * closing a file fails.
+ * closing a file fails, and to open the file again after we have
+ * closed it to stay within the limit on open files.
  */
 struct SharefileEntry
 {
   dev_t device;
   ino_t inode;
-  char *name;                   /* not the only name for this file; error messages only */
-  FILE *fp;
+  char *name;                   /* not the only name for this file */
+  FILE *fp;                     /* NULL while the file is closed */
+  char *buffer;                 /* stdio buffer of fp, if we supplied one */
+  bool closable;                /* may be closed and opened again */
+  uintmax_t last_use;           /* value of the clock when last used */
 };
 
 
@@ -74,14 +105,30 @@ entry_comparator (const void *av, const void *bv)
 }
 
 static void
-entry_free (void *pv)
+entry_close (struct sharefile *p, struct SharefileEntry *e)
 {
-  struct SharefileEntry *p = pv;
-  if (p->fp)
+  if (e->fp)
+    {
+      if (0 != fclose (e->fp))
+        fatal_nontarget_file_error (errno, e->name);
+      e->fp = NULL;
+      if (p)
+        p->n_open--;
+    }
+  if (e->buffer)
     {
-      if (0 != fclose (p->fp))
-        fatal_nontarget_file_error (errno, p->name);
+      free (e->buffer);
+      e->buffer = NULL;
+      if (p)
+        p->buffer_bytes -= OutputBufferSize;
     }
+}
+
+static void
+entry_free (void *pv)
+{
+  struct SharefileEntry *p = pv;
+  entry_close (NULL, p);
   free (p->name);
   free (p);
 }
@@ -90,7 +137,105 @@ static size_t
 entry_hashfunc (const void *pv, size_t buckets)
 {
   const struct SharefileEntry *p = pv;
-  return (p->device ^ p->inode) % buckets;
+  /* Inode numbers in one directory are often consecutive; spread
+   * them over the table.
+   */
+  uintmax_t h = (uintmax_t) p->inode * 0x9E3779B97F4A7C15u ^ p->device;
+  return (h ^ (h >> 32)) % buckets;
+}
+
+/* Give the stream of E a large buffer if there is room for one in the
+ * budget.  E must not have been written to.
+ */
+static void
+entry_set_buffer (struct sharefile *p, struct SharefileEntry *e)
+{
+  if (p->buffer_bytes + OutputBufferSize <= BufferBudget)
+    {
+      e->buffer = enlarge_output_buffer (e->fp);
+      if (e->buffer)
+        p->buffer_bytes += OutputBufferSize;
+    }
+}
+
+static int
+compare_last_use (const void *av, const void *bv)
+{
+  const struct SharefileEntry *a = *(struct SharefileEntry * const *) av;
+  const struct SharefileEntry *b = *(struct SharefileEntry * const *) bv;
+  return (a->last_use > b->last_use) - (a->last_use < b->last_use);
+}
+
+/* Close the least recently used eighth of the files which we can open
+ * again later.  Closing them in batches means that when many files
+ * are in use we sort the entries only once every few opens.  Return
+ * false if there was nothing to close.
+ */
+static bool
+close_some_files (struct sharefile *p)
+{
+  struct SharefileEntry **victims;
+  size_t n = 0, n_close, i;
+
+  victims = xnmalloc (p->n_entries + 1, sizeof *victims);
+  for (i = 0; i < p->n_entries; i++)
+    if (p->entries[i]->fp && p->entries[i]->closable)
+      victims[n++] = p->entries[i];
+  if (n == 0)
+    {
+      free (victims);
+      return false;
+    }
+
+  qsort (victims, n, sizeof *victims, compare_last_use);
+  n_close = n / 8 ? n / 8 : 1;
+  for (i = 0; i < n_close; i++)
+    entry_close (p, victims[i]);
+  free (victims);
+  return true;
+}
+
+/* Open NAME with MODE, closing some of our other files first if we
+ * are at (or, as fopen tells us, past) the limit on open files.
+ */
+static FILE *
+open_within_limit (struct sharefile *p, const char *name, const char *mode)
+{
+  FILE *fp;
+
+  if (p->n_open >= p->max_open)
+    close_some_files (p);
+  while (NULL == (fp = fopen (name, mode)))
+    {
+      const int save_errno = errno;
+      if ((save_errno != EMFILE && save_errno != ENFILE)
+          || !close_some_files (p))
+        {
+          errno = save_errno;
+          return NULL;
+        }
+    }
+  set_cloexec_flag (fileno (fp), true);
+  return fp;
+}
+
+static size_t
+get_max_open (void)
+{
+  size_t limit = SIZE_MAX;
+
+#if defined HAVE_GETRLIMIT && defined RLIMIT_NOFILE
+  struct rlimit fd_limit;
+  if (0 == getrlimit (RLIMIT_NOFILE, &fd_limit)
+      && fd_limit.rlim_cur != RLIM_INFINITY && fd_limit.rlim_cur < SIZE_MAX)
+    limit = fd_limit.rlim_cur;
+#endif
+  if (limit == SIZE_MAX)
+    return limit;
+  else if (limit > 2 * ReservedFds)
+    return limit - ReservedFds;
+  else
+    return limit / 2 ? limit / 2 : 1;
 }
 
 
@@ -103,6 +248,12 @@ sharefile_init (const char *mode)
   struct sharefile *p = malloc (sizeof (struct sharefile));
   if (p)
     {
+      p->entries = NULL;
+      p->n_entries = p->entries_alloc = 0;
+      p->n_open = 0;
+      p->max_open = get_max_open ();
+      p->buffer_bytes = 0;
+      p->clock = 0;
       p->mode = strdup (mode);
       if (p->mode)
         {
@@ -133,11 +284,13 @@ sharefile_destroy (sharefile_handle pv)
   struct sharefile *p = pv;
   free (p->mode);
   hash_free (p->table);
+  free (p->entries);
+  free (p);
 }
 
 
-FILE *
-sharefile_fopen (sharefile_handle h, const char *filename)
+struct SharefileEntry *
+sharefile_open (sharefile_handle h, const char *filename)
 {
   struct sharefile *p = h;
   struct SharefileEntry *new_entry;
@@ -145,6 +298,8 @@ sharefile_fopen (sharefile_handle h, const char *filename)
   new_entry = malloc (sizeof (struct SharefileEntry));
   if (!new_entry)
     return NULL;
+  new_entry->buffer = NULL;
+  new_entry->fp = NULL;
 
   new_entry->name = strdup (filename);
   if (NULL == new_entry->name)
@@ -153,7 +308,7 @@ sharefile_fopen (sharefile_handle h, const char *filename)
       return NULL;
     }
 
-  if (NULL == (new_entry->fp = fopen (filename, p->mode)))
+  if (NULL == (new_entry->fp = open_within_limit (p, filename, p->mode)))
     {
       entry_free (new_entry);
       return NULL;
@@ -164,7 +319,6 @@ sharefile_fopen (sharefile_handle h, const char *filename)
       const int fd = fileno (new_entry->fp);
       assert (fd >= 0);
 
-      set_cloexec_flag (fd, true);
       if (fstat (fd, &st) < 0)
         {
           entry_free (new_entry);
@@ -176,18 +330,29 @@ sharefile_fopen (sharefile_handle h, const char *filename)
 
           new_entry->device = st.st_dev;
           new_entry->inode = st.st_ino;
+          /* Closing a pipe or a device and opening it again is not
+           * the same as keeping it open.
+           */
+          new_entry->closable = S_ISREG (st.st_mode);
+          new_entry->last_use = p->clock;
 
           existing = hash_lookup (p->table, new_entry);
           if (existing)         /* We have previously opened that file. */
             {
               entry_free (new_entry);   /* don't need new_entry. */
-              return ((const struct SharefileEntry *) existing)->fp;
+              return existing;
             }
           else                  /* We didn't open it already */
             {
+              if (p->n_entries == p->entries_alloc)
+                p->entries = x2nrealloc (p->entries, &p->entries_alloc,
+                                         sizeof *p->entries);
               if (hash_insert (p->table, new_entry))
                 {
-                  return new_entry->fp;
+                  p->entries[p->n_entries++] = new_entry;
+                  p->n_open++;
+                  entry_set_buffer (p, new_entry);
+                  return new_entry;
                 }
               else              /* failed to insert in hashtable. */
                 {
@@ -200,3 +365,37 @@ sharefile_fopen (sharefile_handle h, const char *filename)
         }
     }
 }
+
+FILE *
+sharefile_stream (sharefile_handle h, struct SharefileEntry *e)
+{
+  struct sharefile *p = h;
+
+  e->last_use = ++p->clock;
+  if (!e->fp)
+    {
+      /* We closed the file to make room for others.  Everything we
+       * wrote to it was flushed then, so carry on at the end.
+       */
+      struct stat st;
+
+      e->fp = open_within_limit (p, e->name, "a");
+      if (!e->fp)
+        fatal_nontarget_file_error (errno, e->name);
+      p->n_open++;
+      if (fstat (fileno (e->fp), &st) < 0)
+        fatal_nontarget_file_error (errno, e->name);
+      if (st.st_dev != e->device || st.st_ino != e->inode)
+        error (EXIT_FAILURE, 0,
+               _("%s was replaced by another file while find was "
+                 "writing to it"), safely_quote_err_filename (0, e->name));
+      entry_set_buffer (p, e);
+    }
+  return e->fp;
+}
+
+void
+sharefile_keep_open (struct SharefileEntry *e)
+{
+  e->closable = false;
+}
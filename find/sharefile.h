@@ -23,9 +23,28 @@
 # include <stdio.h>
 
 typedef void *sharefile_handle;
+struct SharefileEntry;
 
 sharefile_handle sharefile_init (const char *mode);
-FILE *sharefile_fopen (sharefile_handle, const char *filename);
+
+/* Open FILENAME, or return the entry for it if it is already open
+ * under any name.  Return NULL (setting errno) on failure.
+ */
+struct SharefileEntry *sharefile_open (sharefile_handle,
+                                       const char *filename);
+
+/* Return the stream for an entry.  To stay within the limit on open
+ * files, regular files which have not been used recently are closed,
+ * so do not keep the result across calls which may open another
+ * file; call this before each use instead.
+ */
+FILE *sharefile_stream (sharefile_handle, struct SharefileEntry *);
+
+/* Never close this entry's stream before sharefile_destroy, for
+ * callers which must keep it.
+ */
+void sharefile_keep_open (struct SharefileEntry *);
+
 void sharefile_destroy (sharefile_handle);
 
 #endif
@@ -951,6 +951,8 @@ static struct pred_cost_lookup costlookup[] = {
   {pred_and, NeedsNothing,},
   {pred_anewer, NeedsStatInfo,},
   {pred_atime, NeedsStatInfo,},
+  {pred_chmod, NeedsSyncDiskHit},
+  {pred_chown, NeedsSyncDiskHit},
   {pred_closeparen, NeedsNothing},
   {pred_cmin, NeedsStatInfo,},
   {pred_cnewer, NeedsStatInfo,},
@@ -961,11 +963,15 @@ static struct pred_cost_lookup costlookup[] = {
   {pred_empty, NeedsStatInfo},
   {pred_exec, NeedsEventualExec},
   {pred_execdir, NeedsEventualExec},
+  {pred_execworker, NeedsImmediateExec},
   {pred_executable, NeedsAccessInfo},
   {pred_false, NeedsNothing},
   {pred_fprint, NeedsNothing},
   {pred_fprint0, NeedsNothing},
+  {pred_fprintcolumns, NeedsStatInfo},
   {pred_fprintf, NeedsNothing},
+  {pred_fprintjson, NeedsNothing},
+  {pred_fprinttlv, NeedsNothing},
   {pred_fstype, NeedsStatInfo}, /* true for amortised cost */
   {pred_gid, NeedsStatInfo},
   {pred_group, NeedsStatInfo},
@@ -974,10 +980,12 @@ static struct pred_cost_lookup costlookup[] = {
   {pred_inum, NeedsInodeNumber},
   {pred_ipath, NeedsNothing},
   {pred_links, NeedsStatInfo},
+  {pred_linkto, NeedsSyncDiskHit},
   {pred_lname, NeedsLinkName},
   {pred_ls, NeedsStatInfo},
   {pred_fls, NeedsStatInfo},
   {pred_mmin, NeedsStatInfo},
+  {pred_moveto, NeedsSyncDiskHit},
   {pred_mtime, NeedsStatInfo},
   {pred_name, NeedsNothing},
   {pred_negate, NeedsNothing,},
@@ -999,6 +1007,7 @@ static struct pred_cost_lookup costlookup[] = {
   {pred_regex, NeedsNothing},
   {pred_samefile, NeedsStatInfo},
   {pred_size, NeedsStatInfo},
+  {pred_touch, NeedsSyncDiskHit},
   {pred_true, NeedsNothing},
   {pred_type, NeedsType},
   {pred_uid, NeedsStatInfo},
@@ -1079,7 +1088,8 @@ get_pred_cost (const struct predicate *p)
       else
         inherent_cost = NeedsImmediateExec;
     }
-  else if (pred_is (p, pred_fprintf))
+  else if (pred_is (p, pred_fprintf) || pred_is (p, pred_fprintjson)
+           || pred_is (p, pred_fprinttlv))
     {
       /* the parser calculated the cost for us. */
       inherent_cost = p->p_cost;
@@ -1146,6 +1156,45 @@ estimate_costs (struct predicate *tree)
     }
 }
 
+/* The target of a symbolic link is read at most once per file (see
+   get_link_target), so a predicate which needs it costs little more
+   than the stat information when another one is sure to have read it
+   already.  SEEN says whether that is so when P is evaluated.  Charge
+   such predicates only for the stat information, and return true if
+   evaluating P always reads the link target.
+
+   Only the arm of an operator which is evaluated first, or both arms
+   of a comma, can be relied on; the right arm of -a or -o may not be
+   evaluated at all.  */
+static bool
+amortise_link_name_costs (struct predicate *p, bool seen)
+{
+  bool left;
+
+  if (NULL == p)
+    return seen;
+
+  switch (p->p_type)
+    {
+    case UNI_OP:
+      return amortise_link_name_costs (p->pred_right, seen);
+
+    case BI_OP:
+      left = amortise_link_name_costs (p->pred_left, seen);
+      if (pred_is (p, pred_comma))
+        return amortise_link_name_costs (p->pred_right, left);
+      amortise_link_name_costs (p->pred_right, left);
+      return left;
+
+    default:
+      if (NeedsLinkName != p->p_cost)
+        return seen;
+      if (seen)
+        p->p_cost = NeedsStatInfo;
+      return true;
+    }
+}
+
 struct predicate *
 get_eval_tree (void)
 {
@@ -1252,6 +1301,55 @@ check_normalization (struct predicate *p, bool at_root)
     }
 }
 
+/* Record which -exec and -execdir predicates terminated by ';', and
+ * which -delete predicates, have a result that nothing looks at, so
+ * that their commands may be left to run in the background and their
+ * files may be removed by the delete queue.  The value of "A -a B",
+ * "A -o B" and "A , B" is that of B whenever B is evaluated, the value
+ * of A in "A , B" is discarded, and so is the value of the whole
+ * expression.
+ */
+static void
+mark_unused_results (struct predicate *p, bool unused)
+{
+  if (NULL == p)
+    return;
+
+  if (pred_is (p, pred_exec) || pred_is (p, pred_execdir)
+      || pred_is (p, pred_execworker))
+    {
+      p->args.exec_vec.status_unused = unused;
+    }
+  else if (pred_is (p, pred_delete))
+    {
+      p->args.status_unused = unused;
+    }
+  else if (BI_OP == p->p_type)
+    {
+      mark_unused_results (p->pred_left, pred_is (p, pred_comma));
+      mark_unused_results (p->pred_right, unused);
+    }
+  else if (UNI_OP == p->p_type)
+    {
+      mark_unused_results (p->pred_right, false);
+    }
+}
+
+/* With -batchtime, tune the size of the command lines built by each
+ * -exec ... {} + and -execdir ... {} + in the list starting at P.  This
+ * is done once parsing is over because -batchtime may come after them.
+ */
+static void
+start_batch_tuning (struct predicate *p)
+{
+  for (; p; p = p->pred_next)
+    {
+      if ((pred_is (p, pred_exec) || pred_is (p, pred_execdir))
+          && p->args.exec_vec.multiple)
+        bc_init_tuner (&p->args.exec_vec.ctl, options.batch_time);
+    }
+}
+
 struct predicate *
 build_expression_tree (int argc, char *argv[], int end_of_leading_options)
 {
@@ -1436,6 +1534,7 @@ build_expression_tree (int argc, char *argv[], int end_of_leading_options)
     }
 
   estimate_costs (eval_tree);
+  amortise_link_name_costs (eval_tree, false);
 
   /* Rearrange the eval tree in optimal-predicate order. */
   opt_expr (&eval_tree);
@@ -1451,6 +1550,10 @@ build_expression_tree (int argc, char *argv[], int end_of_leading_options)
   /* Check that the tree is still in normalised order */
   check_normalization (eval_tree, true);
 
+  mark_unused_results (eval_tree, true);
+  if (options.batch_time > 0)
+    start_batch_tuning (predicates);
+
   if (options.debug_options & (DebugExpressionTree | DebugTreeOpt))
     {
       fprintf (stderr, "Optimized Eval Tree:\n");
@@ -30,6 +30,7 @@
 #include <sys/utsname.h>
 
 /* gnulib headers. */
+#include "areadlink.h"
 #include "fdleak.h"
 #include "progname.h"
 #include "quotearg.h"
@@ -38,8 +39,10 @@
 #include "xalloc.h"
 
 /* find headers. */
+#include "columns.h"
+#include "contextcache.h"
 #include "defs.h"
-#include "dircallback.h"
+#include "delqueue.h"
 #include "bugreports.h"
 #include "system.h"
 
@@ -181,8 +184,10 @@ Positional options (always true):\n\
       -daystart -follow -nowarn -regextype -warn\n"));
   HTL (_("\n\
 Normal options (always true, specified before other expressions):\n\
-      -depth -files0-from FILE -maxdepth LEVELS -mindepth LEVELS\n\
-      -mount -noleaf -xdev -ignore_readdir_race -noignore_readdir_race\n"));
+      -batchtime SECONDS -depth -files0-from FILE -groupoutput ORDER\n\
+      -links-once -maxdepth LEVELS -mindepth LEVELS -maxprocs N -mount\n\
+      -noleaf -xdev\n\
+      -ignore_readdir_race -noignore_readdir_race\n"));
   HTL (_("\n\
 Tests (N can be +N or -N or N):\n\
       -amin N -anewer FILE -atime N -cmin N -cnewer FILE -context CONTEXT\n\
@@ -197,8 +202,12 @@ Tests (N can be +N or -N or N):\n\
 Actions:\n\
       -delete -print0 -printf FORMAT -fprintf FILE FORMAT -print \n\
       -fprint0 FILE -fprint FILE -ls -fls FILE -prune -quit\n\
+      -printjson FIELDS -fprintjson FILE FIELDS\n\
+      -printtlv FIELDS -fprinttlv FILE FIELDS -fprintcolumns FILE COLUMNS\n\
       -exec COMMAND ; -exec COMMAND {} + -ok COMMAND ;\n\
-      -execdir COMMAND ; -execdir COMMAND {} + -okdir COMMAND ;\n"));
+      -execdir COMMAND ; -execdir COMMAND {} + -okdir COMMAND ;\n\
+      -execworker COMMAND ;\n\
+      -chmod MODE -chown OWNER[:GROUP] -touch -moveto DIR -linkto DIR\n"));
 
   HTL (_("\n\
 Other common options:\n"));
@@ -363,26 +372,6 @@ check_nofollow (void)
 #endif
 
 
-static int
-exec_cb (void *context)
-{
-  struct exec_val *execp = context;
-  bc_do_exec (&execp->ctl, &execp->state);
-  return 0;
-}
-
-static void
-do_exec (struct exec_val *execp)
-{
-  run_in_dir (execp->wd_for_exec, exec_cb, execp);
-  if (execp->wd_for_exec != initial_wd)
-    {
-      free_cwd (execp->wd_for_exec);
-      free (execp->wd_for_exec);
-      execp->wd_for_exec = NULL;
-    }
-}
-
 
 /* Examine the predicate list for instances of -execdir or -okdir
  * which have been terminated with '+' (build argument list) rather
@@ -400,8 +389,8 @@ do_complete_pending_execdirs (struct predicate *p)
   do_complete_pending_execdirs (p->pred_left);
 
   /* We only want to do work here if there is a dir-local pending
-   * exec.  This is because the completion of work for -exec ... {} +
-   * happens when the program exits, not when we leave a directory.
+   * exec.  The work for -exec ... {} + is completed by
+   * complete_pending_execs.
    */
   if (pred_is (p, pred_okdir) || pred_is (p, pred_execdir))
     {
@@ -412,13 +401,9 @@ do_complete_pending_execdirs (struct predicate *p)
           struct exec_val *execp = &p->args.exec_vec;
 
           /* This one was terminated by '+' and so might have some
-           * left... Run it if necessary.
+           * left, for any number of directories... Run them.
            */
-          if (execp->state.todo)
-            {
-              /* There are not-yet-executed arguments. */
-              do_exec (execp);
-            }
+          complete_execdir (execp);
         }
     }
 
@@ -461,9 +446,14 @@ complete_pending_execs (struct predicate *p)
       if (execp->state.todo)
         {
           /* There are not-yet-executed arguments. */
-          bc_do_exec (&execp->ctl, &execp->state);
+          complete_exec (execp);
         }
     }
+  else if (pred_is (p, pred_execworker))
+    {
+      /* Let the workers finish. */
+      complete_execworker (&p->args.exec_vec);
+    }
 
   complete_pending_execs (p->pred_right);
 }
@@ -539,10 +529,12 @@ undangle_file_pointers (struct predicate *p)
 {
   if (pred_is (p, pred_fprint)
       || pred_is (p, pred_fprintf)
+      || pred_is (p, pred_fprintjson) || pred_is (p, pred_fprinttlv)
       || pred_is (p, pred_fls) || pred_is (p, pred_fprint0))
     {
       /* The file was already fclose()d by sharefile_destroy. */
       p->args.printf_vec.stream = NULL;
+      p->args.printf_vec.shared = NULL;
     }
 }
 
@@ -553,10 +545,17 @@ void
 cleanup (void)
 {
   struct predicate *eval_tree = get_eval_tree ();
+
+  /* Finish removing files first, so that commands still to be run
+   * see them gone.
+   */
+  delqueue_finish ();
   if (eval_tree)
     {
       traverse_tree (eval_tree, complete_pending_execs);
       complete_pending_execdirs ();
+      wait_for_running_commands ();
+      traverse_tree (eval_tree, finish_column_output);
     }
 
   /* Close output files and NULL out references to them. */
@@ -564,6 +563,8 @@ cleanup (void)
   if (eval_tree)
     traverse_tree (eval_tree, undangle_file_pointers);
 
+  contextcache_free ();
+
   cleanup_initial_cwd ();
 
   if (fd_leak_check_is_enabled ())
@@ -697,6 +698,179 @@ debug_stat (const char *file, struct stat *bufp)
 }
 
 
+/* Return the target of the symbolic link currently being visited,
+ * reading it on first use.  Return NULL with errno set if it cannot
+ * be read.  The result remains valid until forget_link_target is
+ * called (that is, until we move on to the next file).
+ */
+const char *
+get_link_target (void)
+{
+  if (!state.have_link_target)
+    {
+      state.link_target = areadlinkat (state.cwd_dir_fd, state.rel_pathname);
+      state.link_target_errno = state.link_target ? 0 : errno;
+      state.have_link_target = true;
+    }
+  errno = state.link_target_errno;
+  return state.link_target;
+}
+
+/* Stat the file currently being visited, following symbolic links
+ * whether or not we would normally do so.  The result is remembered
+ * in the same way as for get_link_target.  Return 0 and set *TARGET
+ * on success, or return -1 with errno set.
+ */
+int
+get_link_target_stat (const struct stat **target)
+{
+  if (!state.have_target_stat)
+    {
+      if (fstatat (state.cwd_dir_fd, state.rel_pathname,
+                   &state.target_stat, 0) != 0)
+        state.target_stat_errno = errno;
+      else
+        state.target_stat_errno = 0;
+      state.have_target_stat = true;
+    }
+  if (state.target_stat_errno)
+    {
+      errno = state.target_stat_errno;
+      return -1;
+    }
+  *target = &state.target_stat;
+  return 0;
+}
+
+/* Discard the information collected by get_link_target and
+ * get_link_target_stat.
+ */
+void
+forget_link_target (void)
+{
+  if (state.have_link_target)
+    {
+      free (state.link_target);
+      state.link_target = NULL;
+      state.have_link_target = false;
+    }
+  state.have_target_stat = false;
+}
+
+
+/* Give the output stream FP a large buffer, unless it is a terminal
+ * or something other than a pipe, socket or regular file.  This must
+ * be called before anything is written to FP.  Return the buffer,
+ * which must not be freed until FP has been closed, or NULL if FP
+ * keeps the buffering stdio chose for it.
+ */
+char *
+enlarge_output_buffer (FILE *fp)
+{
+  const int fd = fileno (fp);
+  struct stat st;
+  char *buf;
+
+  if (fd < 0 || isatty (fd) || fstat (fd, &st) != 0)
+    return NULL;
+  if (!S_ISFIFO (st.st_mode) && !S_ISSOCK (st.st_mode)
+      && !S_ISREG (st.st_mode))
+    return NULL;
+
+  buf = malloc (OutputBufferSize);
+  if (buf == NULL)
+    return NULL;                /* the default buffer will do. */
+  if (setvbuf (fp, buf, _IOFBF, OutputBufferSize) != 0)
+    {
+      free (buf);
+      return NULL;
+    }
+
+#if defined F_GETPIPE_SZ && defined F_SETPIPE_SZ
+  /* If the pipe can hold a whole buffer, each flush is a single write
+   * which does not have to wait for the reader to catch up.  This may
+   * fail (for example if it would exceed the limit on the memory used
+   * by this user's pipes), which is harmless.
+   */
+  if (S_ISFIFO (st.st_mode))
+    {
+      const int capacity = fcntl (fd, F_GETPIPE_SZ);
+      if (0 <= capacity && capacity < OutputBufferSize)
+        fcntl (fd, F_SETPIPE_SZ, (int) OutputBufferSize);
+    }
+#endif
+  return buf;
+}
+
+/* Return the stream to write output for DEST to.  Output files may
+ * be closed and opened again behind our back (see sharefile.c), so
+ * this must be called for each use rather than keeping the stream.
+ */
+FILE *
+output_stream (struct format_val *dest)
+{
+  if (dest->shared)
+    dest->stream = sharefile_stream (state.shared_files, dest->shared);
+  return dest->stream;
+}
+
+/* Set up C to convert counts of FROM-byte units into TO-byte units.
+ * The block sizes find uses are powers of two, so the conversion
+ * is almost always a shift rather than a division.
+ */
+void
+block_converter_init (struct block_converter *c, uintmax_t from,
+                      uintmax_t to)
+{
+  uintmax_t a = from, b = to;
+  int shift;
+
+  while (b)
+    {
+      uintmax_t t = a % b;
+      a = b;
+      b = t;
+    }
+  c->mul = from / a;
+  c->div = to / a;
+
+  c->div_shift = -1;
+  for (shift = 0; shift < CHAR_BIT * sizeof c->div; shift++)
+    if (c->div == (uintmax_t) 1 << shift)
+      {
+        c->div_shift = shift;
+        break;
+      }
+}
+
+/* Return N FROM-byte units in TO-byte units (see block_converter_init),
+ * rounded up.
+ */
+uintmax_t
+convert_blocks (const struct block_converter *c, uintmax_t n)
+{
+  uintmax_t q, r;
+
+  if (c->div_shift >= 0)
+    {
+      q = n >> c->div_shift;
+      r = n & (c->div - 1);
+    }
+  else
+    {
+      q = n / c->div;
+      r = n % c->div;
+    }
+
+  if (c->mul == 1)
+    return q + (r != 0);
+  else
+    /* R * MUL is less than DIV * MUL, which is at most FROM * TO;
+     * that does not overflow for any block sizes we use.
+     */
+    return q * c->mul + (r * c->mul + c->div - 1) / c->div;
+}
+
 bool
 following_links (void)
 {
@@ -1027,6 +1201,7 @@ set_option_defaults (struct options *p)
   p->full_days = false;
   p->mount = p->xdev = false;
   p->ignore_readdir_race = false;
+  p->links_once = false;
 
   if (p->posixly_correct)
     p->output_block_size = 512;
@@ -1061,6 +1236,9 @@ set_option_defaults (struct options *p)
 
   p->files0_from = NULL;
   p->ok_prompt_stdin = false;
+  p->max_procs = 1;
+  p->group_output = GROUP_OUTPUT_NONE;
+  p->batch_time = 0.0;
 }
 
 
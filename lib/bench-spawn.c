@@ -0,0 +1,162 @@
+/* bench-spawn - compare the cost of starting commands with fork and
+   with posix_spawn from a large process.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* Usage: bench-spawn [MEGABYTES [COUNT [COMMAND]]]
+
+   Grow the heap by MEGABYTES (default 512) of touched memory, as a
+   find process walking a large tree might, and then run COMMAND
+   (default "true") COUNT times (default 2000) in each of two ways,
+   doing the same child setup as find's -execdir: change to a saved
+   directory and take standard input from /dev/null.  Print the mean
+   time per command for each.  This is not run by "make check"; build
+   it with "make bench-spawn".  */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static int dir_fd;
+static int null_fd;
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+reap (pid_t pid)
+{
+  int status;
+  while (waitpid (pid, &status, 0) < 0)
+    if (errno != EINTR)
+      {
+        perror ("waitpid");
+        exit (EXIT_FAILURE);
+      }
+  if (!WIFEXITED (status) || WEXITSTATUS (status))
+    {
+      fprintf (stderr, "bench-spawn: command failed\n");
+      exit (EXIT_FAILURE);
+    }
+}
+
+static void
+run_fork (char **argv)
+{
+  pid_t pid = fork ();
+  if (pid < 0)
+    {
+      perror ("fork");
+      exit (EXIT_FAILURE);
+    }
+  if (pid == 0)
+    {
+      if (fchdir (dir_fd) < 0 || dup2 (null_fd, STDIN_FILENO) < 0)
+        _exit (1);
+      execvp (argv[0], argv);
+      _exit (1);
+    }
+  reap (pid);
+}
+
+static void
+run_spawn (char **argv)
+{
+  posix_spawn_file_actions_t actions;
+  pid_t pid;
+  int err;
+
+  posix_spawn_file_actions_init (&actions);
+  posix_spawn_file_actions_adddup2 (&actions, null_fd, STDIN_FILENO);
+  posix_spawn_file_actions_addfchdir (&actions, dir_fd);
+  err = posix_spawnp (&pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy (&actions);
+  if (err)
+    {
+      fprintf (stderr, "bench-spawn: posix_spawnp: %s\n", strerror (err));
+      exit (EXIT_FAILURE);
+    }
+  reap (pid);
+}
+
+static double
+measure (void (*run) (char **), char **argv, long count)
+{
+  double start = now ();
+  long i;
+
+  for (i = 0; i < count; i++)
+    run (argv);
+  return (now () - start) / count;
+}
+
+int
+main (int argc, char **argv)
+{
+  long megabytes = argc > 1 ? atol (argv[1]) : 512;
+  long count = argc > 2 ? atol (argv[2]) : 2000;
+  char *command[] = { argc > 3 ? argv[3] : (char *) "true", NULL };
+  size_t size = (size_t) megabytes << 20;
+  char *heap;
+  double t_fork, t_spawn;
+
+  dir_fd = open (".", O_RDONLY | O_CLOEXEC);
+  null_fd = open ("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (dir_fd < 0 || null_fd < 0)
+    {
+      perror ("open");
+      return EXIT_FAILURE;
+    }
+
+  /* Touch every page, so that each one is mapped and fork has to copy
+     its page table entry.  Ask for ordinary pages: a heap built from
+     many small allocations is rarely backed by huge pages, which would
+     make the page tables (and so fork) much cheaper.  */
+  heap = mmap (NULL, size ? size : 1, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (heap == MAP_FAILED)
+    {
+      perror ("mmap");
+      return EXIT_FAILURE;
+    }
+#ifdef MADV_NOHUGEPAGE
+  madvise (heap, size, MADV_NOHUGEPAGE);
+#endif
+  memset (heap, 1, size);
+
+  t_fork = measure (run_fork, command, count);
+  t_spawn = measure (run_spawn, command, count);
+  printf ("heap %ld MiB, %ld runs of %s\n", megabytes, count, command[0]);
+  printf ("fork+exec:   %8.1f us per command\n", t_fork * 1e6);
+  printf ("posix_spawn: %8.1f us per command (%.1fx)\n",
+          t_spawn * 1e6, t_fork / t_spawn);
+
+  munmap (heap, size ? size : 1);
+  return EXIT_SUCCESS;
+}
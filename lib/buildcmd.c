@@ -20,18 +20,26 @@
 /* system headers. */
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #ifndef _POSIX_SOURCE
 # include <sys/param.h>
 #endif
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #include <wchar.h>
 #include <xalloc.h>
 
 /* gnulib headers. */
+#include "full-write.h"
+#include "safe-read.h"
+#include "timespec.h"
 #include "xstrtol.h"
 
 /* find headers. */
@@ -48,8 +56,32 @@
 #endif
 
 
+#ifdef __linux__
+/* The most that Linux lets the arguments and environment take up:
+   three quarters of its default stack size limit (_STK_LIM).  */
+# define BC_LINUX_ARG_MAX_CAP (6L * 1024L * 1024L)
+#endif
+
+/* Room for the file name of the program being run (up to PATH_MAX on
+   Linux) and for the interpreter named on the #! line of a script,
+   which the kernel copies onto the stack along with the arguments.  */
+enum { BC_EXEC_SLACK = 4096 + 256 };
+
+/* How much the weight of earlier commands in the batch size tuner's
+   reckoning falls with each command, and the most by which it changes
+   the number of arguments per command at a time.  */
+#define BC_TUNER_DECAY 0.75
+enum { BC_TUNER_STEP = 4 };
+
+
 static const char *special_terminating_arg = "do_not_care";
 
+static char *start_arg (struct buildcmd_control *ctl,
+                        struct buildcmd_state *state,
+                        size_t len, int initial_args);
+static void finish_arg (struct buildcmd_control *ctl,
+                        struct buildcmd_state *state, int initial_args);
+
 
 
 /* Add a terminator to the argument list. */
@@ -60,88 +92,111 @@ bc_args_complete (struct buildcmd_control *ctl, struct buildcmd_state *state)
 }
 
 
-/* Replace all instances of `replace_pat' in ARG with `linebuf',
-   and add the resulting string to the list of arguments for the command
-   to execute.
-   ARGLEN is the length of ARG, not including the null.
-   LBLEN is the length of LINEBUF, not including the null.
-   PFXLEN is the length of PREFIX.  Substitution is not performed on
-   the prefix.   The prefix is used if the argument contains replace_pat.
+/* Prepare to replace each instance of `replace_pat' in ARG, which is
+   ARGLEN bytes long (not including the null).  ARG is not copied, so
+   it must stay valid for as long as TPL is used.  The occurrences are
+   found once here, so bc_do_insert does not search for them each time
+   it is called.
 
    COMPAT: insertions on the SYSV version are limited to 255 chars per line,
    and a max of 5 occurrences of replace_pat in the initial-arguments.
    Those restrictions do not exist here.  */
 
 void
-bc_do_insert (struct buildcmd_control *ctl,
-              struct buildcmd_state *state,
-              char *arg, size_t arglen,
-              const char *prefix, size_t pfxlen,
-              const char *linebuf, size_t lblen, int initial_args)
+bc_init_insert (const struct buildcmd_control *ctl,
+                struct bc_insert_template *tpl,
+                const char *arg, size_t arglen)
 {
-  /* Temporary copy of each arg with the replace pattern replaced by the
-     real arg.  */
-  static char *insertbuf;
-  char *p;
-  size_t bytes_left = ctl->arg_max - 1; /* Bytes left on the command line.  */
+  size_t alloc = 0;
+  const char *p = arg;
 
-  /* XXX: on systems lacking an upper limit for exec args, ctl->arg_max
-   *      may have been set to LONG_MAX (see bc_get_arg_max()).  Hence
-   *      this xmalloc call may be a bad idea, especially since we are
-   *      adding 1 to it...
-   */
-  if (!insertbuf)
-    insertbuf = xmalloc (ctl->arg_max + 1);
-  p = insertbuf;
+  tpl->arg = arg;
+  tpl->arglen = arglen;
+  tpl->nsubs = 0;
+  tpl->offsets = NULL;
+  tpl->unbounded = false;
 
-  do
+  if (0 == ctl->rplen)
     {
-      size_t len;               /* Length in ARG before `replace_pat'.  */
-      char *s = mbsstr (arg, ctl->replace_pat);
-      if (s)
-        {
-          len = s - arg;
-        }
+      /* An empty pattern occurs everywhere, so each insertion would be
+         endless unless the argument is empty.  */
+      if (arglen)
+        tpl->unbounded = true;
       else
         {
-          len = arglen;
+          tpl->offsets = xmalloc (sizeof *tpl->offsets);
+          tpl->offsets[tpl->nsubs++] = 0;
         }
+      return;
+    }
 
-      if (bytes_left <= len)
+  while (*p)
+    {
+      const char *s = mbsstr (p, ctl->replace_pat);
+      if (!s)
         break;
-      else
-        bytes_left -= len;
+      if (tpl->nsubs == alloc)
+        tpl->offsets = x2nrealloc (tpl->offsets, &alloc,
+                                   sizeof *tpl->offsets);
+      tpl->offsets[tpl->nsubs++] = s - arg;
+      p = s + ctl->rplen;
+    }
+}
+
+void
+bc_free_insert (struct bc_insert_template *tpl)
+{
+  free (tpl->offsets);
+  tpl->offsets = NULL;
+  tpl->nsubs = 0;
+}
 
-      strncpy (p, arg, len);
-      p += len;
-      arg += len;
-      arglen -= len;
 
-      if (s)
-        {
-          if (bytes_left <= (lblen + pfxlen))
-            break;
-          else
-            bytes_left -= (lblen + pfxlen);
+/* Replace all instances of `replace_pat' in the argument of TPL with
+   `linebuf', and add the resulting string to the list of arguments for
+   the command to execute.  The result is built in place at the end of
+   the argument list.
+   LBLEN is the length of LINEBUF, not including the null.
+   PFXLEN is the length of PREFIX.  Substitution is not performed on
+   the prefix.   The prefix is used if the argument contains replace_pat.  */
 
-          if (prefix)
-            {
-              strcpy (p, prefix);
-              p += pfxlen;
-            }
-          strcpy (p, linebuf);
-          p += lblen;
+void
+bc_do_insert (struct buildcmd_control *ctl,
+              struct buildcmd_state *state,
+              const struct bc_insert_template *tpl,
+              const char *prefix, size_t pfxlen,
+              const char *linebuf, size_t lblen, int initial_args)
+{
+  const size_t sublen = pfxlen + lblen;
+  const size_t fixed = tpl->arglen - tpl->nsubs * ctl->rplen;
+  size_t i, src;
+  char *p;
 
-          arg += ctl->rplen;
-          arglen -= ctl->rplen;
-        }
-    }
-  while (*arg);
-  if (*arg)
+  /* The result, without its null, must be shorter than arg_max - 1.  */
+  if (tpl->unbounded
+      || fixed >= ctl->arg_max - 1
+      || (tpl->nsubs
+          && sublen > (ctl->arg_max - 1 - fixed - 1) / tpl->nsubs))
     error (EXIT_FAILURE, 0, _("command too long"));
-  *p++ = '\0';
 
-  bc_push_arg (ctl, state, insertbuf, p - insertbuf, NULL, 0, initial_args);
+  p = start_arg (ctl, state, fixed + tpl->nsubs * sublen + 1, initial_args);
+  src = 0;
+  for (i = 0; i < tpl->nsubs; i++)
+    {
+      memcpy (p, tpl->arg + src, tpl->offsets[i] - src);
+      p += tpl->offsets[i] - src;
+      if (prefix)
+        {
+          memcpy (p, prefix, pfxlen);
+          p += pfxlen;
+        }
+      memcpy (p, linebuf, lblen);
+      p += lblen;
+      src = tpl->offsets[i] + ctl->rplen;
+    }
+  memcpy (p, tpl->arg + src, tpl->arglen - src);
+  p[tpl->arglen - src] = '\0';
+  finish_arg (ctl, state, initial_args);
 }
 
 
@@ -253,15 +308,32 @@ bc_do_exec (struct buildcmd_control *ctl, struct buildcmd_state *state)
   assert (state->cmd_argc > 0);
   assert (state->cmd_argv[state->cmd_argc - 1] == NULL);
 
-  working_args = xmalloc ((1 + state->cmd_argc) * sizeof (char *));
+  working_args = NULL;
   done = 0;
   limit = state->cmd_argc;
 
   do
     {
-      const size_t dst_pos = copy_args (ctl, state, working_args,
-                                        limit, done);
-      if (ctl->exec_callback (ctl, state->usercontext, dst_pos, working_args))
+      char **argv;
+      size_t dst_pos;
+
+      if (0 == done && limit >= state->cmd_argc)
+        {
+          /* All of the arguments fit (as they usually do), and
+           * `cmd_argv' is already a null-terminated list of them, so
+           * pass it on as it is.
+           */
+          argv = state->cmd_argv;
+          dst_pos = state->cmd_argc;
+        }
+      else
+        {
+          if (!working_args)
+            working_args = xmalloc ((1 + state->cmd_argc) * sizeof (char *));
+          argv = working_args;
+          dst_pos = copy_args (ctl, state, working_args, limit, done);
+        }
+      if (ctl->exec_callback (ctl, state->usercontext, dst_pos, argv))
         {
           limit = update_limit (ctl, state, true, limit);
           done += (dst_pos - ctl->initial_argc);
@@ -292,6 +364,52 @@ bc_do_exec (struct buildcmd_control *ctl, struct buildcmd_state *state)
 }
 
 
+void
+bc_do_exec_split (struct buildcmd_control *ctl,
+                  struct buildcmd_state *state, size_t parts)
+{
+  const size_t nargs = state->cmd_argc - ctl->initial_argc;
+  char **working_args;
+  size_t done, i;
+
+  if (parts > nargs)
+    parts = nargs;
+  if (parts < 2)
+    {
+      bc_do_exec (ctl, state);
+      return;
+    }
+
+  working_args = xnmalloc (ctl->initial_argc + nargs / parts + 2,
+                           sizeof *working_args);
+  for (i = 0, done = 0; i < parts; i++)
+    {
+      /* The first NARGS % PARTS commands get one argument more. */
+      const size_t n = nargs / parts + (i < nargs % parts);
+      const size_t argc = copy_args (ctl, state, working_args,
+                                     ctl->initial_argc + n, done);
+
+      if (!ctl->exec_callback (ctl, state->usercontext, argc, working_args))
+        {
+          /* E2BIG, which the whole list should not have given us.  Let
+           * bc_do_exec find a size that works for the rest.
+           */
+          memmove (state->cmd_argv + ctl->initial_argc,
+                   state->cmd_argv + ctl->initial_argc + done,
+                   (nargs - done) * sizeof *state->cmd_argv);
+          state->cmd_argc -= done;
+          free (working_args);
+          bc_do_exec (ctl, state);
+          return;
+        }
+      done += n;
+    }
+
+  free (working_args);
+  bc_clear_args (ctl, state);
+}
+
+
 /* Return nonzero if there would not be enough room for an additional
  * argument.  We check the total number of arguments only, not the space
  * occupied by those arguments.
@@ -309,6 +427,13 @@ bc_argc_limit_reached (int initial_args,
       ((state->cmd_argc - ctl->initial_argc) == ctl->args_per_exec))
     return 1;
 
+  /* The batch size tuner may have lowered its limit since the list was
+   * started, so this test has to be >=.
+   */
+  if (!initial_args && ctl->tuner.limit
+      && state->cmd_argc - ctl->initial_argc >= ctl->tuner.limit)
+    return 1;
+
   /* We deliberately use an equality test here rather than >= in order
    * to force a software failure if the code is modified in such a way
    * that it fails to call this function for every new argument.
@@ -317,50 +442,26 @@ bc_argc_limit_reached (int initial_args,
 }
 
 
-/* Add ARG to the end of the list of arguments `cmd_argv' to pass
-   to the command.
-   LEN is the length of ARG, including the terminating null.
-   If this brings the list up to its maximum size, execute the command.
-*/
-void
-bc_push_arg (struct buildcmd_control *ctl,
-             struct buildcmd_state *state,
-             const char *arg, size_t len,
-             const char *prefix, size_t pfxlen, int initial_args)
+/* Return true if an argument of LEN bytes, including its null, would
+   make the command line too long, either for the user's limit
+   `arg_max' or for the system, which also charges a pointer for each
+   argument.  */
+static bool
+arg_does_not_fit (const struct buildcmd_control *ctl,
+                  const struct buildcmd_state *state, size_t len)
 {
-  const int terminate = (arg == special_terminating_arg);
-
-  assert (arg != NULL);
-
-  if (!terminate)
-    {
-      if (state->cmd_argv_chars + len + pfxlen > ctl->arg_max)
-        {
-          if (initial_args || state->cmd_argc == ctl->initial_argc)
-            {
-              error (EXIT_FAILURE, 0,
-                     _
-                     ("cannot fit single argument within argument list size limit"));
-            }
+  const size_t chars = state->cmd_argv_chars + len;
 
-          /* xargs option -i (replace_pat) implies -x (exit_if_size_exceeded) */
-          if (ctl->replace_pat
-              || (ctl->exit_if_size_exceeded &&
-                  (ctl->lines_per_exec || ctl->args_per_exec)))
-            {
-              error (EXIT_FAILURE, 0, _("argument list too long"));
-            }
-          bc_do_exec (ctl, state);
-        }
-      if (bc_argc_limit_reached (initial_args, ctl, state))
-        bc_do_exec (ctl, state);
-    }
+  if (chars > ctl->arg_max)
+    return true;
+  return chars + (state->cmd_argc + 1) * sizeof (char *) > ctl->exec_budget;
+}
 
-  if (!initial_args)
-    {
-      state->todo = 1;
-    }
 
+/* Make room for the terminating NULL or another entry in `cmd_argv'. */
+static void
+grow_argv (struct buildcmd_state *state)
+{
   if (state->cmd_argc >= state->cmd_argv_alloc)
     {
       /* XXX: we could use extendbuf() here. */
@@ -377,29 +478,68 @@ bc_push_arg (struct buildcmd_control *ctl,
                                       state->cmd_argv_alloc);
         }
     }
+}
 
-  if (terminate)
-    state->cmd_argv[state->cmd_argc++] = NULL;
-  else
+
+/* Add an argument of LEN bytes, including the terminating null, to the
+   end of the list of arguments `cmd_argv', executing the command first
+   if the argument would not fit.  Return where in `argbuf' the caller
+   must store the argument, and then call finish_arg.  */
+static char *
+start_arg (struct buildcmd_control *ctl, struct buildcmd_state *state,
+           size_t len, int initial_args)
+{
+  char *p;
+
+  if (len > ctl->max_arg_len)
+    error (EXIT_FAILURE, 0,
+           _("cannot fit single argument within argument list size limit"));
+
+  if (arg_does_not_fit (ctl, state, len))
     {
-      state->cmd_argv[state->cmd_argc++] =
-        state->argbuf + state->cmd_argv_chars;
-      if (prefix)
+      if (initial_args || state->cmd_argc == ctl->initial_argc)
         {
-          strcpy (state->argbuf + state->cmd_argv_chars, prefix);
-          state->cmd_argv_chars += pfxlen;
+          error (EXIT_FAILURE, 0,
+                 _
+                 ("cannot fit single argument within argument list size limit"));
         }
 
-      strcpy (state->argbuf + state->cmd_argv_chars, arg);
-      state->cmd_argv_chars += len;
-
-      /* If we have now collected enough arguments,
-       * do the exec immediately.
-       */
-      if (bc_argc_limit_reached (initial_args, ctl, state))
+      /* xargs option -i (replace_pat) implies -x (exit_if_size_exceeded) */
+      if (ctl->replace_pat
+          || (ctl->exit_if_size_exceeded &&
+              (ctl->lines_per_exec || ctl->args_per_exec)))
         {
-          bc_do_exec (ctl, state);
+          error (EXIT_FAILURE, 0, _("argument list too long"));
         }
+      bc_do_exec (ctl, state);
+    }
+  if (bc_argc_limit_reached (initial_args, ctl, state))
+    bc_do_exec (ctl, state);
+
+  if (!initial_args)
+    {
+      state->todo = 1;
+    }
+
+  grow_argv (state);
+  p = state->argbuf + state->cmd_argv_chars;
+  state->cmd_argv[state->cmd_argc++] = p;
+  state->cmd_argv_chars += len;
+  return p;
+}
+
+
+/* Finish adding the argument started by start_arg. */
+static void
+finish_arg (struct buildcmd_control *ctl, struct buildcmd_state *state,
+            int initial_args)
+{
+  /* If we have now collected enough arguments,
+   * do the exec immediately.
+   */
+  if (bc_argc_limit_reached (initial_args, ctl, state))
+    {
+      bc_do_exec (ctl, state);
     }
 
   /* If this is an initial argument, set the high-water mark. */
@@ -410,6 +550,44 @@ bc_push_arg (struct buildcmd_control *ctl,
 }
 
 
+/* Add ARG to the end of the list of arguments `cmd_argv' to pass
+   to the command.
+   LEN is the length of ARG, including the terminating null.
+   If this brings the list up to its maximum size, execute the command.
+*/
+void
+bc_push_arg (struct buildcmd_control *ctl,
+             struct buildcmd_state *state,
+             const char *arg, size_t len,
+             const char *prefix, size_t pfxlen, int initial_args)
+{
+  char *p;
+
+  assert (arg != NULL);
+
+  if (arg == special_terminating_arg)
+    {
+      if (!initial_args)
+        state->todo = 1;
+      grow_argv (state);
+      state->cmd_argv[state->cmd_argc++] = NULL;
+      if (initial_args)
+        state->cmd_initial_argv_chars = state->cmd_argv_chars;
+      return;
+    }
+
+  p = start_arg (ctl, state, len + pfxlen, initial_args);
+  if (prefix)
+    {
+      memcpy (p, prefix, pfxlen);
+      p += pfxlen;
+    }
+  memcpy (p, arg, len - 1);
+  p[len - 1] = '\0';
+  finish_arg (ctl, state, initial_args);
+}
+
+
 size_t
 bc_get_arg_max (void)
 {
@@ -426,7 +604,18 @@ bc_get_arg_max (void)
 #endif
 
   if (val > 0)
-    return val;
+    {
+#ifdef __linux__
+      /* Linux lets the arguments and environment take up a quarter of
+       * the stack size limit, which is what sysconf reports, but (since
+       * Linux 4.13) never more than three quarters of the default 8 MiB
+       * stack size limit, however large the limit is.
+       */
+      if (val > BC_LINUX_ARG_MAX_CAP)
+        val = BC_LINUX_ARG_MAX_CAP;
+#endif
+      return val;
+    }
 
   /* either _SC_ARG_MAX was not available or
    * there is no particular limit.
@@ -475,10 +664,67 @@ bc_size_of_environment (void)
 }
 
 
+/* The environment measured by measure_environment, the number of
+ * variables in it and their total size (including the nulls).
+ */
+static char **measured_environ = NULL;
+static size_t environ_count;
+static size_t environ_size;
+
+/* Measure the environment, unless it is the one we measured last
+ * time; find sets up a command line for each -exec, and the
+ * environment is the same for all of them.  Changes made in place by
+ * setenv and unsetenv are not noticed, but neither find nor xargs
+ * changes its environment after this except to remove a variable,
+ * which only makes the estimate cautious.
+ */
+static void
+measure_environment (void)
+{
+  char **envp;
+
+  if (measured_environ == environ)
+    return;
+  environ_count = environ_size = 0u;
+  for (envp = environ; *envp; envp++)
+    {
+      environ_count++;
+      environ_size += strlen (*envp) + 1;
+    }
+  measured_environ = environ;
+}
+
+
+/* Work out how much room the system really leaves for the arguments,
+ * given that LIMIT bytes are left after the environment strings and
+ * HEADROOM.
+ *
+ * Linux (like several other systems) counts a pointer for each
+ * argument and environment variable as well as the strings.  It also
+ * copies the file name of the program, and for a script the
+ * interpreter named on its #! line, onto the same stack; BC_EXEC_SLACK
+ * allows for those.  The strings are not aligned, and neither the
+ * check nor the space available depends on where the stack was
+ * placed, so nothing more is needed.
+ */
+static size_t
+exec_budget (size_t limit)
+{
+  const size_t env_pointers = environ_count * sizeof (char *);
+
+  if (limit <= env_pointers + BC_EXEC_SLACK)
+    return limit;               /* Let E2BIG sort it out.  */
+  return limit - env_pointers - BC_EXEC_SLACK;
+}
+
+
 enum BC_INIT_STATUS
 bc_init_controlinfo (struct buildcmd_control *ctl, size_t headroom)
 {
-  size_t size_of_environment = bc_size_of_environment ();
+  size_t size_of_environment;
+
+  measure_environment ();
+  size_of_environment = environ_size;
 
   /* POSIX requires that _POSIX_ARG_MAX is 4096.  That is the lowest
    * possible value for ARG_MAX on a POSIX compliant system.  See
@@ -509,6 +755,14 @@ bc_init_controlinfo (struct buildcmd_control *ctl, size_t headroom)
       ctl->posix_arg_size_max -= headroom;
     }
 
+  ctl->exec_budget = exec_budget (ctl->posix_arg_size_max);
+#ifdef __linux__
+  /* Linux refuses any single string longer than 32 pages.  */
+  ctl->max_arg_len = 32u * sysconf (_SC_PAGESIZE);
+#else
+  ctl->max_arg_len = SIZE_MAX;
+#endif
+
   /* need to subtract 2 on the following line - for Linux/PPC */
   ctl->max_arg_count = (ctl->posix_arg_size_max / sizeof (char *)) - 2u;
   assert (ctl->max_arg_count > 0);
@@ -518,6 +772,7 @@ bc_init_controlinfo (struct buildcmd_control *ctl, size_t headroom)
   ctl->exec_callback = cb_exec_noop;
   ctl->lines_per_exec = 0;
   ctl->args_per_exec = 0;
+  memset (&ctl->tuner, 0, sizeof ctl->tuner);
 
   /* Set the initial value of arg_max to the largest value we can
    * tolerate.
@@ -586,49 +841,550 @@ bc_clear_args (const struct buildcmd_control *ctl,
 }
 
 
-/* Return nonzero if the value stored in the environment variable ENV_VAR_NAME
- * exceeds QUANTITY.
+void
+bc_init_tuner (struct buildcmd_control *ctl, double target)
+{
+  memset (&ctl->tuner, 0, sizeof ctl->tuner);
+  ctl->tuner.target = target;
+  ctl->tuner.limit = 1u;
+}
+
+/* Return the time in seconds from some fixed point. */
+double
+bc_now (void)
+{
+  struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC
+  /* Unlike the time of day, this does not jump when the clock is set. */
+  if (0 == clock_gettime (CLOCK_MONOTONIC, &ts))
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+  ts = current_timespec ();
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Return the number of arguments in ARGV after the initial ones. */
+size_t
+bc_batch_size (const struct buildcmd_control *ctl, char *const *argv)
+{
+  size_t n = 0;
+
+  while (argv[n])
+    n++;
+  return n > ctl->initial_argc ? n - ctl->initial_argc : 0u;
+}
+
+/* Record that a command with NARGS arguments (not counting the initial
+ * ones) took SECONDS to run, and choose the number of arguments for the
+ * next commands.
  */
-static int
-exceeds (const char *env_var_name, size_t quantity)
+void
+bc_note_batch_time (struct buildcmd_control *ctl, size_t nargs,
+                    double seconds)
+{
+  struct bc_tuner *t = &ctl->tuner;
+  const double n = nargs;
+  double fixed, per_arg, spread, wanted;
+
+  if (!(t->target > 0) || 0 == nargs)
+    return;
+  if (seconds < 0)
+    seconds = 0;
+
+  t->weight = t->weight * BC_TUNER_DECAY + 1;
+  t->sum_n = t->sum_n * BC_TUNER_DECAY + n;
+  t->sum_nn = t->sum_nn * BC_TUNER_DECAY + n * n;
+  t->sum_t = t->sum_t * BC_TUNER_DECAY + seconds;
+  t->sum_nt = t->sum_nt * BC_TUNER_DECAY + n * seconds;
+
+  /* Fit SECONDS = FIXED + PER_ARG * NARGS by least squares.  Until the
+   * commands have had different enough numbers of arguments to tell
+   * the two costs apart, or if the fit makes no sense, charge all of
+   * the time to the arguments.
+   */
+  spread = t->weight * t->sum_nn - t->sum_n * t->sum_n;
+  fixed = -1;
+  per_arg = 0;
+  if (spread > 0.01 * t->sum_n * t->sum_n)
+    {
+      per_arg = (t->weight * t->sum_nt - t->sum_n * t->sum_t) / spread;
+      fixed = (t->sum_t - per_arg * t->sum_n) / t->weight;
+    }
+  if (fixed < 0 || per_arg < 0)
+    {
+      fixed = 0;
+      per_arg = t->sum_t / t->sum_n;
+    }
+
+  if (fixed >= t->target || !(per_arg > 0))
+    wanted = ctl->max_arg_count;        /* As many as will fit. */
+  else
+    wanted = (t->target - fixed) / per_arg;
+
+  /* Change the number gradually, since one command may be unusual. */
+  if (wanted > (double) t->limit * BC_TUNER_STEP)
+    wanted = (double) t->limit * BC_TUNER_STEP;
+  if (wanted < (double) t->limit / BC_TUNER_STEP)
+    wanted = (double) t->limit / BC_TUNER_STEP;
+  if (wanted > ctl->max_arg_count)
+    wanted = ctl->max_arg_count;
+  t->limit = wanted < 1 ? 1u : (size_t) wanted;
+}
+
+
+/* Read the limit stored in the environment variable ENV_VAR_NAME into
+ * *LIMIT.  Return false if the variable is not set.
+ */
+static bool
+get_testing_limit (const char *env_var_name, unsigned long *limit)
 {
   const char *val = getenv (env_var_name);
   if (val)
     {
       char *tmp;
-      unsigned long limit;
 
-      if (xstrtoul (val, &tmp, 10, &limit, NULL) == LONGINT_OK)
-        {
-          if (quantity > limit)
-            return 1;
-        }
-      else
-        {
-          error (EXIT_FAILURE, errno,
-                 _("Environment variable %s is not set to a "
-                   "valid decimal number"), env_var_name);
-          return 0;
-        }
+      if (xstrtoul (val, &tmp, 10, limit, NULL) == LONGINT_OK)
+        return true;
+      error (EXIT_FAILURE, errno,
+             _("Environment variable %s is not set to a "
+               "valid decimal number"), env_var_name);
     }
-  return 0;
+  return false;
 }
 
 /* Return nonzero if the indicated argument list exceeds a testing limit.
+ * The limits are read from the environment the first time, and the
+ * argument list is only measured if one of them is set.
  * NOTE: argv could be declared 'const char *const *argv', but it works as
  * expected only with C++ compilers <http://c-faq.com/ansi/constmismatch.html>.
  */
 bool
 bc_args_exceed_testing_limit (char **argv)
 {
+  static bool limits_read = false;
+  static bool have_count_limit, have_length_limit;
+  static unsigned long count_limit, length_limit;
   size_t chars, args;
 
+  if (!limits_read)
+    {
+      have_count_limit =
+        get_testing_limit ("__GNU_FINDUTILS_EXEC_ARG_COUNT_LIMIT",
+                           &count_limit);
+      have_length_limit =
+        get_testing_limit ("__GNU_FINDUTILS_EXEC_ARG_LENGTH_LIMIT",
+                           &length_limit);
+      limits_read = true;
+    }
+  if (!have_count_limit && !have_length_limit)
+    return false;
+
   for (chars = args = 0; *argv; ++argv)
     {
       ++args;
       chars += strlen (*argv);
     }
 
-  return (exceeds ("__GNU_FINDUTILS_EXEC_ARG_COUNT_LIMIT", args) ||
-          exceeds ("__GNU_FINDUTILS_EXEC_ARG_LENGTH_LIMIT", chars));
+  return ((have_count_limit && args > count_limit)
+          || (have_length_limit && chars > length_limit));
+}
+
+
+
+/* Workers. */
+
+void
+bc_worker_pool_init (struct bc_worker_pool *pool, char **argv,
+                     size_t max_workers, size_t max_pending,
+                     void *usercontext)
+{
+  pool->argv = argv;
+  pool->max_workers = max_workers;
+  pool->max_pending = max_pending ? max_pending : 1u;
+  pool->prepare = NULL;
+  pool->spawn = NULL;
+  pool->status_callback = NULL;
+  pool->exit_callback = NULL;
+  pool->usercontext = usercontext;
+  pool->workers = NULL;
+  pool->workers_alloc = 0u;
+  pool->slots_used = 0u;
+}
+
+static void
+close_fd (int *fd)
+{
+  if (*fd >= 0)
+    {
+      close (*fd);
+      *fd = -1;
+    }
+}
+
+/* Return FD, moved if need be so that it is above the descriptors a
+ * worker is given its pipes as, and so that making it one of those
+ * clears its close-on-exec flag.  Return -1 if it cannot be moved.
+ */
+static int
+move_above_worker_fds (int fd)
+{
+  int moved;
+
+  if (fd < 0 || fd > BC_WORKER_STATUS_FD)
+    return fd;
+  moved = fcntl (fd, F_DUPFD_CLOEXEC, BC_WORKER_STATUS_FD + 1);
+  close (fd);
+  return moved;
+}
+
+/* Start a worker in the free slot SLOT.  Return zero or an error
+ * number.
+ */
+static int
+start_worker (struct bc_worker_pool *pool, size_t slot)
+{
+  struct bc_worker *w = &pool->workers[slot];
+  posix_spawn_file_actions_t actions;
+  /* The ends of the worker's standard input, then of its status
+   * channel.
+   */
+  int fds[4] = { -1, -1, -1, -1 };
+  int err = 0;
+
+  if (pipe2 (fds, O_CLOEXEC) != 0 || pipe2 (fds + 2, O_CLOEXEC) != 0)
+    err = errno;
+  else if ((fds[0] = move_above_worker_fds (fds[0])) < 0
+           || (fds[3] = move_above_worker_fds (fds[3])) < 0)
+    err = errno;
+  else if (0 == (err = posix_spawn_file_actions_init (&actions)))
+    {
+      if (pool->prepare)
+        err = pool->prepare (pool, slot, &actions);
+      if (!err)
+        err = posix_spawn_file_actions_adddup2 (&actions, fds[0],
+                                                STDIN_FILENO);
+      if (!err)
+        err = posix_spawn_file_actions_adddup2 (&actions, fds[3],
+                                                BC_WORKER_STATUS_FD);
+      if (!err)
+        err = pool->spawn (pool, slot, &actions, &w->pid);
+      posix_spawn_file_actions_destroy (&actions);
+    }
+
+  /* The worker has its own copies of these. */
+  close_fd (&fds[0]);
+  close_fd (&fds[3]);
+  if (err)
+    {
+      close_fd (&fds[1]);
+      close_fd (&fds[2]);
+      w->pid = 0;
+      return err;
+    }
+  w->record_fd = fds[1];
+  w->status_fd = fds[2];
+  w->pending = 0u;
+  w->statlen = 0u;
+  w->reaped = false;
+  return 0;
+}
+
+/* Return the status in the LEN bytes at P, or -1 if they are not one. */
+static int
+parse_status (const char *p, size_t len)
+{
+  int status = 0;
+
+  if (len < 1u || len > 3u)
+    return -1;
+  for (; len; p++, len--)
+    {
+      if (*p < '0' || *p > '9')
+        return -1;
+      status = status * 10 + (*p - '0');
+    }
+  return status <= 255 ? status : -1;
+}
+
+/* Read what worker SLOT has written to its status channel, waiting
+ * for something if need be, and pass on the statuses.  Return false
+ * if the worker has closed the channel or broken the protocol.
+ */
+static bool
+read_statuses (struct bc_worker_pool *pool, size_t slot)
+{
+  struct bc_worker *w = &pool->workers[slot];
+  char *p = w->statbuf;
+  char *end, *nul;
+  size_t n;
+
+  n = safe_read (w->status_fd, w->statbuf + w->statlen,
+                 sizeof w->statbuf - w->statlen);
+  if (n == SAFE_READ_ERROR || n == 0)
+    return false;
+  end = w->statbuf + w->statlen + n;
+
+  while ((nul = memchr (p, '\0', end - p)) != NULL)
+    {
+      int status = parse_status (p, nul - p);
+
+      if (status < 0 || !w->pending)
+        return false;
+      w->pending--;
+      p = nul + 1;
+      pool->status_callback (pool, slot, status);
+    }
+  w->statlen = end - p;
+  memmove (w->statbuf, p, w->statlen);
+  /* No status is this long. */
+  return w->statlen < sizeof w->statbuf;
+}
+
+/* Stop sending arguments to worker SLOT, and wait for it to exit.  If
+ * DRAIN, first read the statuses it has still to send.  The arguments
+ * it does not report on are lost.
+ */
+static void
+retire_worker (struct bc_worker_pool *pool, size_t slot, bool drain)
+{
+  struct bc_worker *w = &pool->workers[slot];
+  int wait_status;
+  pid_t pid;
+
+  close_fd (&w->record_fd);
+  while (drain && w->pending && read_statuses (pool, slot))
+    ;
+  close_fd (&w->status_fd);
+  while (w->pending)
+    {
+      w->pending--;
+      pool->status_callback (pool, slot, BC_WORKER_LOST);
+    }
+
+  if (w->reaped)
+    {
+      pid = w->pid;
+      wait_status = w->wait_status;
+    }
+  else
+    while ((pid = waitpid (w->pid, &wait_status, 0)) == (pid_t) -1
+           && errno == EINTR)
+      ;
+  /* If something else reaped the worker without telling us (see
+   * bc_worker_pool_reaped), we cannot tell how it exited.
+   */
+  if (pid != (pid_t) -1)
+    pool->exit_callback (pool, slot, wait_status);
+  w->pid = 0;
+}
+
+/* Wait until some worker reports on an argument, or exits.  There
+ * must be a worker with a status to send.
+ */
+static void
+wait_for_status (struct bc_worker_pool *pool)
+{
+  static struct pollfd *pfd = NULL;
+  static size_t *pfd_slot = NULL;
+  static size_t pfd_alloc = 0u;
+  size_t i, n = 0u;
+
+  if (pfd_alloc < pool->slots_used)
+    {
+      pfd = xnrealloc (pfd, pool->slots_used, sizeof *pfd);
+      pfd_slot = xnrealloc (pfd_slot, pool->slots_used, sizeof *pfd_slot);
+      pfd_alloc = pool->slots_used;
+    }
+  for (i = 0; i < pool->slots_used; i++)
+    {
+      if (pool->workers[i].pid && pool->workers[i].pending)
+        {
+          pfd[n].fd = pool->workers[i].status_fd;
+          pfd[n].events = POLLIN;
+          pfd_slot[n] = i;
+          n++;
+        }
+    }
+  assert (n > 0u);
+
+  /* With just one worker to wait for, reading is enough. */
+  if (n > 1u)
+    {
+      while (poll (pfd, n, -1) < 0)
+        {
+          if (errno != EINTR)
+            {
+              /* Wait for the first, then. */
+              n = 1u;
+              pfd[0].revents = POLLIN;
+              break;
+            }
+        }
+    }
+  else
+    {
+      pfd[0].revents = POLLIN;
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      if (pfd[i].revents && !read_statuses (pool, pfd_slot[i]))
+        retire_worker (pool, pfd_slot[i], false);
+    }
+}
+
+/* Make *SLOT the worker to send the next argument to.  Return zero or
+ * an error number.
+ */
+static int
+choose_worker (struct bc_worker_pool *pool, size_t *slot)
+{
+  for (;;)
+    {
+      size_t i, running = 0u, free_slot = pool->slots_used;
+      size_t best = SIZE_MAX;   /* The least busy worker. */
+
+      for (i = 0; i < pool->slots_used; i++)
+        {
+          const struct bc_worker *w = &pool->workers[i];
+          if (!w->pid)
+            {
+              if (free_slot == pool->slots_used)
+                free_slot = i;
+            }
+          else
+            {
+              running++;
+              if (best == SIZE_MAX || w->pending < pool->workers[best].pending)
+                best = i;
+            }
+        }
+
+      /* Start another worker rather than make one wait. */
+      if ((best == SIZE_MAX || pool->workers[best].pending)
+          && (!pool->max_workers || running < pool->max_workers))
+        {
+          int err;
+
+          if (free_slot == pool->workers_alloc)
+            pool->workers = x2nrealloc (pool->workers, &pool->workers_alloc,
+                                        sizeof *pool->workers);
+          err = start_worker (pool, free_slot);
+          if (!err)
+            {
+              if (free_slot == pool->slots_used)
+                pool->slots_used++;
+              *slot = free_slot;
+              return 0;
+            }
+          if (best == SIZE_MAX)
+            return err;
+          /* Make do with the workers we have. */
+          pool->max_workers = running;
+        }
+
+      if (pool->workers[best].pending < pool->max_pending)
+        {
+          *slot = best;
+          return 0;
+        }
+      wait_for_status (pool);
+    }
+}
+
+/* Write the LEN bytes at ARG to FD, which is the standard input of a
+ * worker.  Return zero or an error number.
+ */
+static int
+write_record (int fd, const char *arg, size_t len)
+{
+  struct sigaction ignore, saved;
+  int err = 0;
+
+  /* If the worker has exited, report that as EPIPE rather than let
+   * SIGPIPE kill us.
+   */
+  ignore.sa_handler = SIG_IGN;
+  sigemptyset (&ignore.sa_mask);
+  ignore.sa_flags = 0;
+  sigaction (SIGPIPE, &ignore, &saved);
+  if (full_write (fd, arg, len) < len)
+    err = errno;
+  sigaction (SIGPIPE, &saved, NULL);
+  return err;
+}
+
+int
+bc_worker_pool_send (struct bc_worker_pool *pool, const char *arg,
+                     size_t len)
+{
+  for (;;)
+    {
+      size_t slot;
+      int err = choose_worker (pool, &slot);
+
+      if (err)
+        return err;
+      if (0 == write_record (pool->workers[slot].record_fd, arg, len))
+        {
+          pool->workers[slot].pending++;
+          return 0;
+        }
+      /* The worker will take no more; try again with another. */
+      retire_worker (pool, slot, true);
+    }
+}
+
+bool
+bc_worker_pool_reaped (struct bc_worker_pool *pool, pid_t pid,
+                       int wait_status)
+{
+  size_t i;
+
+  for (i = 0; i < pool->slots_used; i++)
+    {
+      struct bc_worker *w = &pool->workers[i];
+
+      if (w->pid == pid && !w->reaped)
+        {
+          w->reaped = true;
+          w->wait_status = wait_status;
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+bc_worker_pool_wait (struct bc_worker_pool *pool)
+{
+  size_t i;
+
+  for (i = 0; i < pool->slots_used; i++)
+    {
+      while (pool->workers[i].pid && pool->workers[i].pending)
+        wait_for_status (pool);
+    }
+}
+
+void
+bc_worker_pool_finish (struct bc_worker_pool *pool)
+{
+  size_t i;
+
+  /* Let them all see the end of their input before waiting for any. */
+  for (i = 0; i < pool->slots_used; i++)
+    {
+      if (pool->workers[i].pid)
+        close_fd (&pool->workers[i].record_fd);
+    }
+  for (i = 0; i < pool->slots_used; i++)
+    {
+      if (pool->workers[i].pid)
+        retire_worker (pool, i, true);
+    }
+  free (pool->workers);
+  pool->workers = NULL;
+  pool->workers_alloc = pool->slots_used = 0u;
 }
@@ -22,6 +22,8 @@
 
 # include <stdbool.h>
 # include <limits.h>
+# include <spawn.h>
+# include <sys/types.h>
 
 struct buildcmd_state
 {
@@ -69,6 +71,15 @@ struct buildcmd_control
   /* The maximum number of characters that can be used per command line.  */
   size_t arg_max;
 
+  /* The most that the arguments may take up in the system's own
+   * reckoning, which also charges a pointer for each of them (see
+   * bc_init_controlinfo).  Keeping within this avoids E2BIG.
+   */
+  size_t exec_budget;
+
+  /* The maximum length of a single argument, including its null.  */
+  size_t max_arg_len;
+
   /* max_arg_count: the maximum number of arguments that can be used.
    *
    * Many systems include the size of the pointers in ARG_MAX.
@@ -103,6 +114,17 @@ struct buildcmd_control
 
   /* The maximum number of arguments to use per command line.  */
   size_t args_per_exec;
+
+  /* If `target' is nonzero, the number of arguments per command line
+   * is adjusted so that each command takes about that many seconds to
+   * run (see bc_note_batch_time).
+   */
+  struct bc_tuner
+  {
+    double target;
+    double weight, sum_n, sum_nn, sum_t, sum_nt; /* Decaying sums. */
+    size_t limit;               /* The current number, or 0. */
+  } tuner;
 };
 
 # define BC_LINES_PER_EXEC_MAX ULONG_MAX
@@ -118,9 +140,32 @@ enum BC_INIT_STATUS
 extern size_t bc_size_of_environment (void);
 
 
+/* An initial argument containing the replace pattern, with the
+ * positions of the pattern found in advance (see bc_init_insert).
+ */
+struct bc_insert_template
+{
+  /* The argument, and its length not including the null. */
+  const char *arg;
+  size_t arglen;
+
+  /* The number of occurrences of the pattern, and their offsets. */
+  size_t nsubs;
+  size_t *offsets;
+
+  /* True if the pattern is empty but the argument is not. */
+  bool unbounded;
+};
+
+extern void bc_init_insert (const struct buildcmd_control *ctl,
+                            struct bc_insert_template *tpl,
+                            const char *arg, size_t arglen);
+
+extern void bc_free_insert (struct bc_insert_template *tpl);
+
 extern void bc_do_insert (struct buildcmd_control *ctl,
                           struct buildcmd_state *state,
-                          char *arg, size_t arglen,
+                          const struct bc_insert_template *tpl,
                           const char *prefix, size_t pfxlen,
                           const char *linebuf, size_t lblen,
                           int initial_args);
@@ -144,4 +189,137 @@ extern void bc_clear_args (const struct buildcmd_control *ctl,
 bool bc_args_exceed_testing_limit (char **argv);
 
 
+/* Adaptive batching.
+ *
+ * bc_init_tuner starts with a single argument per command line.  The
+ * caller times each command and reports how long it took, and how many
+ * arguments it had besides the initial ones, to bc_note_batch_time,
+ * which works out the fixed and per-argument costs from the recent
+ * commands and sets the number of arguments for the next ones from
+ * them.  Other limits (such as on the size of a command line) still
+ * apply.
+ */
+extern void bc_init_tuner (struct buildcmd_control *ctl, double target);
+extern double bc_now (void);
+extern size_t bc_batch_size (const struct buildcmd_control *ctl,
+                             char *const *argv);
+extern void bc_note_batch_time (struct buildcmd_control *ctl, size_t nargs,
+                                double seconds);
+
+/* Run the arguments built up so far as PARTS commands (or fewer, if
+ * there are not enough arguments) with equal shares of them, so that
+ * the last of the input can be spread over idle processes.
+ */
+extern void bc_do_exec_split (struct buildcmd_control *ctl,
+                              struct buildcmd_state *state, size_t parts);
+
+
+/* Workers.
+ *
+ * Instead of being run once for each command line, a worker is a
+ * command which is started once and then sent arguments one at a time
+ * on its standard input, each followed by a NUL.  For each argument,
+ * in order, the worker writes a status (a decimal number from 0 to 255,
+ * where 0 means success) followed by a NUL to file descriptor
+ * BC_WORKER_STATUS_FD, and it exits when it reaches the end of its
+ * standard input.  A pool spreads the arguments over up to a given
+ * number of workers, starting them as they are needed.
+ */
+# define BC_WORKER_STATUS_FD 3
+
+/* The status reported for an argument which a worker exited (or broke
+ * the protocol) without reporting on.
+ */
+# define BC_WORKER_LOST (-1)
+
+struct bc_worker
+{
+  pid_t pid;
+  int record_fd;                /* Its standard input, or -1. */
+  int status_fd;                /* Its status channel, or -1. */
+  size_t pending;               /* Arguments not yet reported on. */
+  char statbuf[16];             /* Part of a status read so far. */
+  size_t statlen;
+  bool reaped;                  /* Waited for by someone else... */
+  int wait_status;              /* ...with this result. */
+};
+
+struct bc_worker_pool
+{
+  /* The worker command. */
+  char **argv;
+
+  /* The most workers to start, or 0 for no limit. */
+  size_t max_workers;
+
+  /* The most arguments sent to a worker which it has not reported on.
+   * Keep this small enough for the statuses to fit in a pipe.
+   */
+  size_t max_pending;
+
+  /* If not NULL, add to ACTIONS what the child for worker SLOT should
+   * do before its standard input and status channel are set up (for
+   * example, change directory).  Return zero or an error number.
+   */
+  int (*prepare) (struct bc_worker_pool *pool, size_t slot,
+                  posix_spawn_file_actions_t *actions);
+
+  /* Start worker SLOT as posix_spawnp would, with ACTIONS, and store
+   * its process ID in *PID.  Return zero or an error number.
+   */
+  int (*spawn) (struct bc_worker_pool *pool, size_t slot,
+                const posix_spawn_file_actions_t *actions, pid_t *pid);
+
+  /* Called with the status of each argument sent to worker SLOT, in
+   * the order they were sent.  Neither this nor EXIT_CALLBACK may call
+   * the functions below.
+   */
+  void (*status_callback) (struct bc_worker_pool *pool, size_t slot,
+                           int status);
+
+  /* Called with the wait status of worker SLOT once it has exited;
+   * workers[SLOT].pid is still its process ID.
+   */
+  void (*exit_callback) (struct bc_worker_pool *pool, size_t slot,
+                         int wait_status);
+
+  void *usercontext;
+
+  /* Slot I is free for a new worker if workers[I].pid is 0. */
+  struct bc_worker *workers;
+  size_t workers_alloc;
+  size_t slots_used;
+};
+
+/* Set up POOL for the worker command ARGV.  The caller fills in the
+ * callbacks.
+ */
+extern void bc_worker_pool_init (struct bc_worker_pool *pool, char **argv,
+                                 size_t max_workers, size_t max_pending,
+                                 void *usercontext);
+
+/* Send ARG, whose length LEN includes the terminating NUL, to a worker,
+ * starting one if all those running are busy and there is room for
+ * another.  This may wait for statuses.  Return zero, or the error
+ * number from starting a worker when none is running.
+ */
+extern int bc_worker_pool_send (struct bc_worker_pool *pool,
+                                const char *arg, size_t len);
+
+/* Tell POOL that the caller's waitpid has collected the wait status
+ * WAIT_STATUS of process PID.  Return true if PID is one of POOL's
+ * workers, whose exit will then be reported as usual.
+ */
+extern bool bc_worker_pool_reaped (struct bc_worker_pool *pool, pid_t pid,
+                                   int wait_status);
+
+/* Wait for the status of every argument sent so far. */
+extern void bc_worker_pool_wait (struct bc_worker_pool *pool);
+
+/* Close the standard input of every worker, wait for their statuses,
+ * and wait for them to exit.  POOL can be used again afterwards.
+ */
+extern void bc_worker_pool_finish (struct bc_worker_pool *pool);
+
+
 #endif
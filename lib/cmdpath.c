@@ -0,0 +1,252 @@
+/* cmdpath.c -- find commands in $PATH once rather than for every exec.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* config.h must be included first. */
+#include <config.h>
+
+/* system headers. */
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* gnulib headers. */
+#include "stat-time.h"
+#include "timespec.h"
+#include "xalloc.h"
+
+/* find headers. */
+#include "cmdpath.h"
+
+
+/* A directory modified less than this many seconds ago may be modified
+   again without its timestamp changing (timestamps can be as coarse
+   as a second, or two on FAT), so it is not trusted to stay as it is.  */
+enum { CMDPATH_SETTLE_SECONDS = 2 };
+
+/* A directory named in $PATH, and how it was when we last looked.  */
+struct path_dir
+{
+  char *name;
+  size_t len;
+  bool stamped;                 /* The fields below are set.  */
+  bool exists;
+  bool settled;                 /* Not modified just before we looked.  */
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime;
+};
+
+/* What we found for one command name.  */
+struct cmdpath_entry
+{
+  char *name;
+  char *file;                   /* Where it is, or NULL if nowhere.  */
+  size_t depends;               /* How many of `dirs' that depends on.  */
+  bool valid;
+  struct cmdpath_entry *next;
+};
+
+/* The value of $PATH the directories come from.  */
+static char *path_value = NULL;
+
+/* True if $PATH is set and names only absolute directories.  */
+static bool path_usable = false;
+
+static struct path_dir *dirs = NULL;
+static size_t ndirs = 0u;
+
+static struct cmdpath_entry *entries = NULL;
+
+
+void
+cmdpath_forget (void)
+{
+  size_t i;
+
+  while (entries)
+    {
+      struct cmdpath_entry *next = entries->next;
+      free (entries->name);
+      free (entries->file);
+      free (entries);
+      entries = next;
+    }
+  for (i = 0; i < ndirs; i++)
+    free (dirs[i].name);
+  free (dirs);
+  dirs = NULL;
+  ndirs = 0u;
+  free (path_value);
+  path_value = NULL;
+  path_usable = false;
+}
+
+/* Start again if $PATH is not the value we have the directories of.  */
+static void
+check_path_value (void)
+{
+  const char *path = getenv ("PATH");
+  const char *p;
+  size_t alloc = 0u;
+
+  if (path && path_value && 0 == strcmp (path, path_value))
+    return;
+  cmdpath_forget ();
+  if (!path)
+    return;
+
+  path_value = xstrdup (path);
+  path_usable = true;
+  for (p = path_value;; p++)
+    {
+      const size_t len = strcspn (p, ":");
+
+      /* An empty entry means the current directory. */
+      if (0 == len || *p != '/')
+        path_usable = false;
+      if (ndirs == alloc)
+        dirs = x2nrealloc (dirs, &alloc, sizeof *dirs);
+      dirs[ndirs].name = xmemdup0 (p, len);
+      dirs[ndirs].len = len;
+      dirs[ndirs].stamped = false;
+      ndirs++;
+      p += len;
+      if (!*p)
+        break;
+    }
+}
+
+/* Look at directory I of `dirs'.  If it may have changed since we last
+   did, forget what depends on it, and return false.  */
+static bool
+check_dir (size_t i)
+{
+  struct path_dir *d = &dirs[i];
+  struct stat st;
+  struct cmdpath_entry *e;
+  bool exists = 0 == stat (d->name, &st);
+
+  if (d->stamped && d->settled && exists == d->exists
+      && (!exists
+          || (st.st_dev == d->dev && st.st_ino == d->ino
+              && 0 == timespec_cmp (get_stat_mtime (&st), d->mtime))))
+    return true;
+
+  for (e = entries; e; e = e->next)
+    if (e->depends > i)
+      e->valid = false;
+
+  d->stamped = true;
+  d->exists = exists;
+  d->settled = true;
+  if (exists)
+    {
+      d->dev = st.st_dev;
+      d->ino = st.st_ino;
+      d->mtime = get_stat_mtime (&st);
+      d->settled = d->mtime.tv_sec + CMDPATH_SETTLE_SECONDS <= time (NULL);
+    }
+  return false;
+}
+
+/* Search `dirs' for the command of entry E, as execvp would.  */
+static void
+resolve (struct cmdpath_entry *e)
+{
+  const size_t namelen = strlen (e->name);
+  size_t i;
+
+  free (e->file);
+  e->file = NULL;
+  e->depends = ndirs;
+  for (i = 0; i < ndirs; i++)
+    {
+      const struct path_dir *d = &dirs[i];
+      char *file;
+      struct stat st;
+
+      /* Note the state of the directory before looking in it, so that
+         a change made while we look is noticed next time.  */
+      check_dir (i);
+      if (!d->exists)
+        continue;
+
+      file = xmalloc (d->len + namelen + 2);
+      memcpy (file, d->name, d->len);
+      file[d->len] = '/';
+      memcpy (file + d->len + 1, e->name, namelen + 1);
+      if (0 == stat (file, &st) && S_ISREG (st.st_mode)
+          && 0 == faccessat (AT_FDCWD, file, X_OK, AT_EACCESS))
+        {
+          e->file = file;
+          e->depends = i + 1;
+          break;
+        }
+      free (file);
+    }
+  e->valid = true;
+}
+
+char **
+cmdpath_script_argv (const char *file, char *const *argv)
+{
+  size_t argc = 0u;
+  char **script_argv;
+
+  while (argv[argc])
+    argc++;
+  script_argv = xnmalloc (argc + 2u, sizeof *script_argv);
+  script_argv[0] = (char *) "/bin/sh";
+  script_argv[1] = (char *) file;
+  /* The rest of ARGV, and its null. */
+  memcpy (script_argv + 2, argv + 1, argc * sizeof *argv);
+  return script_argv;
+}
+
+const char *
+cmdpath_lookup (const char *name)
+{
+  struct cmdpath_entry *e;
+  size_t i;
+
+  check_path_value ();
+  if (!path_usable || !*name || strchr (name, '/'))
+    return name;
+
+  for (e = entries; e && 0 != strcmp (e->name, name); e = e->next)
+    ;
+  if (!e)
+    {
+      e = xmalloc (sizeof *e);
+      e->name = xstrdup (name);
+      e->file = NULL;
+      e->depends = ndirs;
+      e->valid = false;
+      e->next = entries;
+      entries = e;
+    }
+
+  /* Any change to the directories we looked in invalidates E.  */
+  for (i = 0; e->valid && i < e->depends; i++)
+    check_dir (i);
+  if (!e->valid)
+    resolve (e);
+  return e->file ? e->file : name;
+}
@@ -0,0 +1,53 @@
+/* cmdpath.h -- find commands in $PATH once rather than for every exec.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef CMDPATH_H
+# define CMDPATH_H
+
+/* Return the file which execvp would run for the command NAME: the
+ * first executable regular file called NAME in the directories named
+ * in $PATH.  Passing that to execvp or posix_spawnp instead of NAME
+ * saves them searching $PATH again, which for a command far down it
+ * means many failed attempts to run files which do not exist.
+ *
+ * The answer is remembered, and NAME is looked for again only when
+ * $PATH changes or one of the directories which the answer depends on
+ * (those up to the one NAME was found in) is modified.  Checking that
+ * costs a stat call for each of those directories.  Changing the
+ * permissions of a file does not modify its directory, so making a
+ * file executable is not noticed until something else changes there.
+ *
+ * NAME itself is returned if it contains a slash, if $PATH is unset
+ * or contains a relative directory name (which would depend on the
+ * directory the command runs in), or if no such file exists; execvp
+ * and posix_spawnp then do what they would have done with it.  The
+ * result is valid until the next call.
+ */
+extern const char *cmdpath_lookup (const char *name);
+
+/* Return the argument vector with which execvp runs FILE, the file it
+ * found for the command ARGV, when the system cannot execute FILE
+ * itself (ENOEXEC): FILE is taken to be a shell script, and run as
+ * "/bin/sh FILE ARGV[1] ...".  posix_spawnp does not do this, so its
+ * callers must.  The result is allocated with malloc; the strings in it
+ * are not copied.
+ */
+extern char **cmdpath_script_argv (const char *file, char *const *argv);
+
+/* Forget everything cmdpath_lookup has remembered. */
+extern void cmdpath_forget (void);
+
+#endif
@@ -41,10 +41,12 @@
 #include "idcache.h"
 #include "pathmax.h"
 #include "stat-size.h"
+#include "xalloc.h"
 
 /* find headers. */
 #include "system.h"
 #include "listfile.h"
+#include "printquoted.h"
 
 /* Since major is a function on SVR4, we can't use `ifndef major'.  */
 #ifdef MAJOR_IN_MKDEV
@@ -61,8 +63,7 @@
 #endif
 
 
-static bool print_name (register const char *p, FILE * stream,
-                        int literal_control_chars);
+static void print_name (register const char *p, int literal_control_chars);
 
 /* We have some minimum field sizes, though we try to widen these fields on systems
  * where we discover examples where the field width we started with is not enough. */
@@ -78,164 +79,298 @@ static int minor_device_number_width = 3;
 static int file_device_or_size_width = 8;
 static int time_stamp_width = 12;
 
-static bool
-update_width_if_success (int chars_out, int *width)
+/* Each line of output is built up in LINE and then written with a
+   single call to fwrite.  The buffer is kept between calls.  */
+static struct
+{
+  char *text;
+  size_t len;
+  size_t size;
+} line;
+
+/* Make room for at least N more bytes in LINE.  */
+static void
+line_reserve (size_t n)
+{
+  while (line.size - line.len < n)
+    line.text = x2nrealloc (line.text, &line.size, 1);
+}
+
+static void
+line_append (const char *s, size_t n)
 {
-  if (chars_out >= 0)
+  line_reserve (n);
+  memcpy (line.text + line.len, s, n);
+  line.len += n;
+}
+
+static void
+line_append_char (char c)
+{
+  line_reserve (1);
+  line.text[line.len++] = c;
+}
+
+/* Append S, padded with spaces on the left (or on the right if
+   LEFT_JUSTIFY) to *WIDTH bytes, as fprintf's "%*s" would, and widen
+   *WIDTH if S was longer.  S is LEN bytes long.  */
+static void
+line_append_field (const char *s, size_t len, int *width, bool left_justify)
+{
+  size_t pad = len < (size_t) *width ? *width - len : 0;
+
+  line_reserve (len + pad);
+  if (!left_justify)
     {
-      if (*width < chars_out)
-        *width = chars_out;
-      return true;
+      memset (line.text + line.len, ' ', pad);
+      line.len += pad;
+    }
+  memcpy (line.text + line.len, s, len);
+  line.len += len;
+  if (left_justify)
+    {
+      memset (line.text + line.len, ' ', pad);
+      line.len += pad;
     }
-  return false;
+  if (*width < len + pad)
+    *width = len + pad;
 }
 
+static void
+line_append_string_field (const char *s, int *width, bool left_justify)
+{
+  line_append_field (s, strlen (s), width, left_justify);
+}
 
 
-static bool
-print_num (FILE *stream, unsigned long num, int *width)
+static void
+print_num (unsigned long num, int *width)
 {
-  return update_width_if_success (fprintf (stream, "%*lu", *width, num),
-                                  width);
+  char buf[INT_BUFSIZE_BOUND (unsigned long)];
+  line_append_string_field (umaxtostr (num, buf), width, false);
 }
 
 
-static bool
-print_block_count (const struct stat *statp,
-                   int output_block_size, FILE *stream)
+static void
+print_block_count (const struct stat *statp, int output_block_size)
 {
   char hbuf[LONGEST_HUMAN_READABLE + 1];
-  int chars_out = fprintf (stream, "%*s",
-                           block_size_width,
-                           human_readable ((uintmax_t) ST_NBLOCKS (*statp),
-                                           hbuf,
-                                           human_ceiling,
-                                           ST_NBLOCKSIZE, output_block_size));
-  return update_width_if_success (chars_out, &block_size_width);
+  line_append_string_field (human_readable ((uintmax_t) ST_NBLOCKS (*statp),
+                                            hbuf,
+                                            human_ceiling,
+                                            ST_NBLOCKSIZE, output_block_size),
+                            &block_size_width, false);
 }
 
-static bool
-print_file_size (const struct stat *statp,
-                 int output_block_size, FILE *stream)
+static void
+print_file_size (const struct stat *statp, int output_block_size)
 {
   char hbuf[LONGEST_HUMAN_READABLE + 1];
   const int blocksize = output_block_size < 0 ? output_block_size : 1;
-  int chars_out = fprintf (stream, "%*s",
-                           file_device_or_size_width,
-                           human_readable ((uintmax_t) statp->st_size,
-                                           hbuf,
-                                           human_ceiling,
-                                           1, blocksize));
-  return update_width_if_success (chars_out, &file_device_or_size_width);
+  line_append_string_field (human_readable ((uintmax_t) statp->st_size,
+                                            hbuf,
+                                            human_ceiling,
+                                            1, blocksize),
+                            &file_device_or_size_width, false);
 }
 
-static bool
-print_file_inum (const struct stat *statp, FILE *stream)
+static void
+print_file_inum (const struct stat *statp)
 {
   char umaxtostr_buf[INT_BUFSIZE_BOUND (uintmax_t)];
-  int chars_out = fprintf (stream, "%*s", inode_number_width,
-                           umaxtostr (statp->st_ino, umaxtostr_buf));
-  return update_width_if_success (chars_out, &inode_number_width);
+  line_append_string_field (umaxtostr (statp->st_ino, umaxtostr_buf),
+                            &inode_number_width, false);
 }
 
 
-static bool
-print_struct_tm (const struct tm *when_local,
-                 time_t file_timestamp, time_t current_time, FILE *stream)
+/* The last time stamp we formatted.  Every time stamp in
+   [START, START + 60) falls in the same minute of local time, and so
+   is formatted the same way as long as it is on the same side of the
+   six-month cutoff (RECENT).  A directory's files are often modified
+   within the same minute, so this saves calling localtime and
+   strftime for most of them.  */
+static struct
+{
+  bool valid;
+  bool recent;
+  time_t start;
+  char *text;
+  size_t len;
+} time_stamp_cache;
+
+static void
+print_struct_tm (const struct tm *when_local, bool recent)
 {
   char init_bigbuf[256];
   char *buf = init_bigbuf;
   size_t bufsize = sizeof init_bigbuf;
+  size_t len;
 
   /* Use strftime rather than ctime, because the former can produce
-     locale-dependent names for the month (%b).
-
-     Output the year if the file is fairly old or in the future.
-     POSIX says the cutoff is 6 months old;
-     approximate this by 6*30 days.
-     Allow a 1 hour slop factor for what is considered "the future",
-     to allow for NFS server/client clock disagreement.  */
-  char const *fmt =
-    ((current_time - 6 * 30 * 24 * 60 * 60 <= file_timestamp
-      && file_timestamp <= current_time + 60 * 60)
-     ? "%b %e %H:%M" : "%b %e  %Y");
+     locale-dependent names for the month (%b).  */
+  char const *fmt = recent ? "%b %e %H:%M" : "%b %e  %Y";
 
-  while (!strftime (buf, bufsize, fmt, when_local))
+  while (!(len = strftime (buf, bufsize, fmt, when_local)))
     buf = alloca (bufsize *= 2);
 
-  int chars_out = fprintf (stream, "%*s", time_stamp_width, buf);
-  return update_width_if_success (chars_out, &time_stamp_width);
+  /* Only remember the result if the whole minute is in the same
+     local minute; a leap second (tm_sec == 60) is not.  */
+  time_stamp_cache.valid = false;
+  if (when_local->tm_sec < 60)
+    {
+      free (time_stamp_cache.text);
+      time_stamp_cache.text = xmemdup (buf, len);
+      time_stamp_cache.len = len;
+      time_stamp_cache.recent = recent;
+      time_stamp_cache.valid = true;
+    }
+  line_append_field (buf, len, &time_stamp_width, false);
 }
 
 
 /* Print a time which cannot be represented as a local time,
    as a (presumably huge) integer number of seconds.  */
-static bool
-print_raw_timestamp (time_t time_val, FILE *stream)
+static void
+print_raw_timestamp (time_t time_val)
 {
   char intmaxtostr_buf[1 + INT_BUFSIZE_BOUND (intmax_t)];
 
   char const *num = imaxtostr (time_val, intmaxtostr_buf);
-  return update_width_if_success (fprintf (stream, "%s", num),
-                                  &time_stamp_width);
+  size_t len = strlen (num);
+  line_append (num, len);
+  if (time_stamp_width < len)
+    time_stamp_width = len;
 }
 
 
-static bool
-print_file_mtime (const struct stat *statp, time_t current_time, FILE *stream)
+static void
+print_file_mtime (const struct stat *statp, time_t current_time)
 {
-  struct tm const *when_local = localtime (&statp->st_mtime);
+  time_t file_timestamp = statp->st_mtime;
+
+  /* Output the year if the file is fairly old or in the future.
+     POSIX says the cutoff is 6 months old;
+     approximate this by 6*30 days.
+     Allow a 1 hour slop factor for what is considered "the future",
+     to allow for NFS server/client clock disagreement.  */
+  bool recent = (current_time - 6 * 30 * 24 * 60 * 60 <= file_timestamp
+                 && file_timestamp <= current_time + 60 * 60);
+
+  if (time_stamp_cache.valid
+      && time_stamp_cache.recent == recent
+      && time_stamp_cache.start <= file_timestamp
+      && file_timestamp <= time_stamp_cache.start + 59)
+    {
+      line_append_field (time_stamp_cache.text, time_stamp_cache.len,
+                         &time_stamp_width, false);
+      return;
+    }
+
+  struct tm const *when_local = localtime (&file_timestamp);
   if (when_local)
     {
-      return print_struct_tm (when_local, statp->st_mtime, current_time,
-                              stream);
+      time_stamp_cache.start = file_timestamp - when_local->tm_sec;
+      print_struct_tm (when_local, recent);
     }
   else
     {
       /* The time cannot be represented as a local time; print it as
          an integer.  */
-      return print_raw_timestamp (statp->st_mtime, stream);
+      print_raw_timestamp (file_timestamp);
     }
 }
 
 
-static bool
-print_file_owner (const struct stat *statp, FILE *stream)
+/* Owner and group names, and their display widths, by ID.  The names
+   themselves are cached by getuser and getgroup, but computing their
+   width takes longer than formatting the rest of the line.  */
+enum { NAME_CACHE_SIZE = 64 };
+
+struct name_cache_entry
 {
-  char const *user_name = getuser (statp->st_uid);
-  int chars_out;
-  if (user_name)
-    {
-      int len = mbswidth (user_name, 0);
-      if (len > owner_width)
-        owner_width = len;
-      chars_out = fprintf (stream, "%-*s", owner_width, user_name);
-    }
-  else
+  bool valid;
+  unsigned long id;
+  char const *name;             /* NULL if the ID has no name.  */
+  size_t len;
+  int width;
+};
+
+static struct name_cache_entry owner_cache[NAME_CACHE_SIZE];
+static struct name_cache_entry group_cache[NAME_CACHE_SIZE];
+
+static struct name_cache_entry const *
+lookup_name (struct name_cache_entry *cache, unsigned long id,
+             char const *(*lookup) (unsigned long))
+{
+  struct name_cache_entry *e = &cache[id % NAME_CACHE_SIZE];
+  if (!e->valid || e->id != id)
     {
-      chars_out = fprintf (stream, "%-8lu", (unsigned long) statp->st_uid);
+      e->valid = true;
+      e->id = id;
+      e->name = lookup (id);
+      if (e->name)
+        {
+          e->len = strlen (e->name);
+          e->width = mbswidth (e->name, 0);
+        }
     }
-  return update_width_if_success (chars_out, &owner_width);
+  return e;
 }
 
-static bool
-print_file_group (const struct stat *statp, FILE *stream)
+static char const *
+lookup_user (unsigned long uid)
+{
+  return getuser (uid);
+}
+
+static char const *
+lookup_group (unsigned long gid)
 {
-  char const *group_name = getgroup (statp->st_gid);
-  int chars_out;
-  if (group_name)
+  return getgroup (gid);
+}
+
+/* Print the owner or group name E, or the numeric ID if it has none,
+   in a field of *WIDTH.  NUMERIC_WIDTH is the minimum width of a
+   numeric ID.  */
+static void
+print_id (struct name_cache_entry const *e, int *width, int numeric_width)
+{
+  if (e->name)
     {
-      int len = mbswidth (group_name, 0);
-      if (len > group_width)
-        group_width = len;
-      chars_out = fprintf (stream, "%-*s", group_width, group_name);
+      if (e->width > *width)
+        *width = e->width;
+      line_append_field (e->name, e->len, width, true);
     }
   else
     {
-      chars_out = fprintf (stream, "%-*lu",
-                           group_width, (unsigned long) statp->st_gid);
+      char buf[INT_BUFSIZE_BOUND (unsigned long)];
+      char const *num = umaxtostr (e->id, buf);
+      size_t len = strlen (num);
+      size_t pad = len < numeric_width ? numeric_width - len : 0;
+
+      line_append (num, len);
+      line_reserve (pad);
+      memset (line.text + line.len, ' ', pad);
+      line.len += pad;
+      if (*width < len + pad)
+        *width = len + pad;
     }
-  return update_width_if_success (chars_out, &group_width);
+}
+
+static void
+print_file_owner (const struct stat *statp)
+{
+  /* The historical behaviour is to use a width of 8 for a numeric
+     owner, but the current group width for a numeric group.  */
+  print_id (lookup_name (owner_cache, statp->st_uid, lookup_user),
+            &owner_width, 8);
+}
+
+static void
+print_file_group (const struct stat *statp)
+{
+  print_id (lookup_name (group_cache, statp->st_gid, lookup_group),
+            &group_width, group_width);
 }
 
 static void
@@ -249,8 +384,8 @@ delete_single_final_space_if_present (char *s)
 }
 
 
-static bool
-print_file_mode (const struct stat *statp, FILE *stream)
+static void
+print_file_mode (const struct stat *statp)
 {
   char modebuf[12];
   modebuf[0] = 0;
@@ -268,9 +403,7 @@ print_file_mode (const struct stat *statp, FILE *stream)
    * access method).
    */
   delete_single_final_space_if_present (modebuf);
-  return update_width_if_success (fprintf (stream, "%-*s",
-                                           symbolic_mode_width,
-                                           modebuf), &symbolic_mode_width);
+  line_append_string_field (modebuf, &symbolic_mode_width, true);
 }
 
 static bool
@@ -308,7 +441,7 @@ format_dev_major_or_minor (char *buf,
 
 
 static bool
-print_file_device (const struct stat *statp, FILE *stream)
+print_file_device (const struct stat *statp)
 {
   char dev_maj_buf[INT_BUFSIZE_BOUND (unsigned long)];
   char dev_min_buf[INT_BUFSIZE_BOUND (unsigned long)];
@@ -328,39 +461,54 @@ print_file_device (const struct stat *statp, FILE *stream)
   dev_maj_buf[0] = 0;
   dev_min_buf[0] = 0;
 #endif
-  int chars_out = fprintf (stream, "%*s%-2s%*s",
-                           major_device_number_width,
-                           dev_maj_buf,
-                           separator,
-                           minor_device_number_width,
-                           dev_min_buf);
-  return update_width_if_success (chars_out, &file_device_or_size_width);
+  /* This is "%*s%-2s%*s"; the widths used for the major and minor
+     numbers must not be widened here, only the width of the field as
+     a whole.  */
+  size_t start = line.len;
+  int width = major_device_number_width;
+  line_append_string_field (dev_maj_buf, &width, false);
+  width = 2;
+  line_append_string_field (separator, &width, true);
+  width = minor_device_number_width;
+  line_append_string_field (dev_min_buf, &width, false);
+  if (file_device_or_size_width < line.len - start)
+    file_device_or_size_width = line.len - start;
+  return true;
 }
 
 static bool
-print_file_dev_or_size (const struct stat *statp,
-                        int output_block_size, FILE *stream)
+print_file_dev_or_size (const struct stat *statp, int output_block_size)
 {
   if (S_ISCHR (statp->st_mode) || S_ISBLK (statp->st_mode))
     {
-      return print_file_device (statp, stream);
+      return print_file_device (statp);
     }
   else
     {
       const int blocksize = output_block_size < 0 ? output_block_size : 1;
-      return print_file_size (statp, blocksize, stream);
+      print_file_size (statp, blocksize);
+      return true;
     }
 }
 
 
-static bool
-print_link_count (const struct stat *statp, FILE *stream)
+static void
+print_link_count (const struct stat *statp)
 {
   /* This field used to end in a space, but the output of "ls"
      has only one space between the link count and the owner name,
      so we removed the trailing space.  Happily this also makes it
      easier to update nlink_width. */
-  return print_num (stream, statp->st_nlink, &nlink_width);
+  print_num (statp->st_nlink, &nlink_width);
+}
+
+/* Write out the line built so far.  */
+static bool
+flush_line (FILE *stream)
+{
+  size_t len = line.len;
+  line.len = 0;
+  return fwrite (line.text, 1, len, stream) == len;
 }
 
 static bool
@@ -373,21 +521,20 @@ print_file_link_target (const struct stat *statp,
   char *linkname = areadlinkat (dir_fd, relname);
   if (!linkname)
     {
-      error (0, errno, "%s", relname);
+      /* Keep the partial line before the diagnostic, as we always
+         have.  */
+      int saved_errno = errno;
+      if (!flush_line (stream))
+        return false;
+      error (0, saved_errno, "%s", relname);
       *issued_diagnostic = true;
       return false;
     }
 
-  bool result = true;
-  if (fputs (" -> ", stream) < 0)
-    result = false;
-  if (result)
-    {
-      if (!print_name (linkname, stream, literal_control_chars))
-        result = false;
-    }
+  line_append (" -> ", 4);
+  print_name (linkname, literal_control_chars);
   free (linkname);
-  return result;
+  return true;
 }
 
 static bool
@@ -407,14 +554,6 @@ maybe_print_file_link_target (const struct stat *statp,
 }
 
 
-static bool
-print_single_space (FILE *stream)
-{
-  if (EOF == putc (' ', stream))
-    return false;
-  return true;
-}
-
 /* NAME is the name to print.
    RELNAME is the path to access it from the current directory.
    STATP is the results of stat or lstat on it.
@@ -435,67 +574,39 @@ list_file_internal (const char *name,
                     int literal_control_chars,
                     bool *issued_diagnostic, FILE *stream)
 {
+  line.len = 0;
+
+  print_file_inum (statp);
+  line_append_char (' ');
+  print_block_count (statp, output_block_size);
+  line_append_char (' ');
+  print_file_mode (statp);
+  line_append_char (' ');
+  print_link_count (statp);
+  line_append_char (' ');
+  print_file_owner (statp);
+  line_append_char (' ');
+  print_file_group (statp);
+  line_append_char (' ');
+
+  if (!print_file_dev_or_size (statp, output_block_size))
+    {
+      flush_line (stream);
+      return false;
+    }
 
-  if (!print_file_inum (statp, stream))
-    return false;
-
-  if (!print_single_space (stream))
-    return false;
-
-  if (!print_block_count (statp, output_block_size, stream))
-    return false;
-
-  if (!print_single_space (stream))
-    return false;
-
-  if (!print_file_mode (statp, stream))
-    return false;
-
-  if (!print_single_space (stream))
-    return false;
-
-  if (!print_link_count (statp, stream))
-    return false;
-
-  if (!print_single_space (stream))
-    return false;
-
-  if (!print_file_owner (statp, stream))
-    return false;
-
-  if (!print_single_space (stream))
-    return false;
-
-  if (!print_file_group (statp, stream))
-    return false;
-
-  if (!print_single_space (stream))
-    return false;
-
-  if (!print_file_dev_or_size (statp, output_block_size, stream))
-    return false;
-
-  if (!print_single_space (stream))
-    return false;
-
-  if (!print_file_mtime (statp, current_time, stream))
-    return false;
-
-  if (!print_single_space (stream))
-    return false;
-
-  if (!print_name (name, stream, literal_control_chars))
-    return false;
+  line_append_char (' ');
+  print_file_mtime (statp, current_time);
+  line_append_char (' ');
+  print_name (name, literal_control_chars);
 
   if (!maybe_print_file_link_target
       (statp, dir_fd, relname, literal_control_chars, issued_diagnostic,
        stream))
     return false;
 
-  if (EOF == putc ('\n', stream))
-    return false;
-
-  return true;
+  line_append_char ('\n');
+  return flush_line (stream);
 }
 
 
@@ -533,79 +644,96 @@ list_file (const char *name,
     }
 }
 
-static bool
-print_name_without_quoting (const char *p, FILE *stream)
+static void
+print_name_without_quoting (const char *p)
 {
-  return (fprintf (stream, "%s", p) >= 0);
+  line_append (p, strlen (p));
 }
 
 
-static bool
-print_name_with_quoting (register const char *p, FILE *stream)
+static void
+print_name_with_quoting (register const char *p)
 {
   register unsigned char c;
+  size_t len = strlen (p);
+
+  /* Most names need no escapes at all.  */
+  if (printable_ascii_span (p, len) == len && !strpbrk (p, " \\\""))
+    {
+      line_append (p, len);
+      return;
+    }
 
   while ((c = *p++) != '\0')
     {
-      int fprintf_result = -1;
+      if (c > 040 && c < 0177 && c != '\\' && c != '"')
+        {
+          /* Copy the whole run of characters which stand for
+             themselves.  */
+          const char *run = p - 1;
+          while ((c = *p) > 040 && c < 0177 && c != '\\' && c != '"')
+            p++;
+          line_append (run, p - run);
+          continue;
+        }
+
       switch (c)
         {
         case '\\':
-          fprintf_result = fprintf (stream, "\\\\");
+          line_append ("\\\\", 2);
           break;
 
         case '\n':
-          fprintf_result = fprintf (stream, "\\n");
+          line_append ("\\n", 2);
           break;
 
         case '\b':
-          fprintf_result = fprintf (stream, "\\b");
+          line_append ("\\b", 2);
           break;
 
         case '\r':
-          fprintf_result = fprintf (stream, "\\r");
+          line_append ("\\r", 2);
           break;
 
         case '\t':
-          fprintf_result = fprintf (stream, "\\t");
+          line_append ("\\t", 2);
           break;
 
         case '\f':
-          fprintf_result = fprintf (stream, "\\f");
+          line_append ("\\f", 2);
           break;
 
         case ' ':
-          fprintf_result = fprintf (stream, "\\ ");
+          line_append ("\\ ", 2);
           break;
 
         case '"':
-          fprintf_result = fprintf (stream, "\\\"");
+          line_append ("\\\"", 2);
           break;
 
         default:
           if (c > 040 && c < 0177)
             {
-              if (EOF == putc (c, stream))
-                fprintf_result = -1;
-              else
-                fprintf_result = 1;     /* otherwise it's used uninitialized. */
+              line_append_char (c);
             }
           else
             {
-              fprintf_result = fprintf (stream, "\\%03o", (unsigned int) c);
+              char octal[4];
+              octal[0] = '\\';
+              octal[1] = '0' + ((c >> 6) & 7);
+              octal[2] = '0' + ((c >> 3) & 7);
+              octal[3] = '0' + (c & 7);
+              line_append (octal, 4);
             }
         }
-      if (fprintf_result < 0)
-        return false;
     }
-  return true;
 }
 
-static bool
-print_name (register const char *p, FILE *stream, int literal_control_chars)
+static void
+print_name (register const char *p, int literal_control_chars)
 {
   if (literal_control_chars)
-    return print_name_without_quoting (p, stream);
+    print_name_without_quoting (p);
   else
-    return print_name_with_quoting (p, stream);
+    print_name_with_quoting (p);
 }
@@ -0,0 +1,274 @@
+/* outseq.c -- merge the output of concurrent tasks into one stream.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* config.h must be included first. */
+#include <config.h>
+
+/* system headers. */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* gnulib headers. */
+#include "xalloc.h"
+
+/* find headers. */
+#include "outseq.h"
+
+
+struct task
+{
+  char *buf;                    /* Output held back, or NULL.  */
+  size_t len;
+  size_t size;
+  bool finished;
+};
+
+struct outseq
+{
+  FILE *stream;
+  enum outseq_mode mode;
+  size_t limit;
+  size_t buffered;              /* Sum of LEN over all tasks.  */
+
+  /* The tasks with keys from BASE up to (but excluding) NEXT, each at
+   * index KEY % RING_SIZE.  RING_SIZE is a power of two.
+   */
+  struct task *ring;
+  size_t ring_size;
+  uintmax_t base;
+  uintmax_t next;
+
+  /* In unordered mode, the task (if any) writing straight to the
+   * stream.  In ordered mode this is always BASE.
+   */
+  bool have_writer;
+  uintmax_t writer;
+};
+
+
+static struct task *
+task_at (const struct outseq *seq, uintmax_t key)
+{
+  assert (seq->base <= key && key < seq->next);
+  return &seq->ring[key & (seq->ring_size - 1)];
+}
+
+/* Write out and discard the output held back for task T.  */
+static void
+flush_task (struct outseq *seq, struct task *t)
+{
+  if (t->len)
+    fwrite (t->buf, 1, t->len, seq->stream);
+  seq->buffered -= t->len;
+  free (t->buf);
+  t->buf = NULL;
+  t->len = t->size = 0;
+}
+
+static bool
+is_writer (const struct outseq *seq, uintmax_t key)
+{
+  if (seq->mode == OUTSEQ_ORDERED)
+    return key == seq->base;
+  else
+    return seq->have_writer && key == seq->writer;
+}
+
+/* Forget the tasks at the start of the window which are finished and
+ * have nothing left to write.
+ */
+static void
+release_finished (struct outseq *seq)
+{
+  while (seq->base < seq->next)
+    {
+      struct task *t = task_at (seq, seq->base);
+      if (!t->finished || t->len)
+        break;
+      seq->base++;
+    }
+}
+
+/* In ordered mode, write out the tasks at the start of the window for
+ * as long as they have finished.  The first unfinished task becomes
+ * the writer, so its buffer is written too.
+ */
+static void
+advance_ordered (struct outseq *seq)
+{
+  while (seq->base < seq->next)
+    {
+      struct task *t = task_at (seq, seq->base);
+      flush_task (seq, t);
+      if (!t->finished)
+        break;
+      seq->base++;
+    }
+}
+
+/* In unordered mode, after the writer has finished, write out every
+ * finished task and then hand the stream to the unfinished task with
+ * the most output held back, which frees the most memory.
+ */
+static void
+choose_writer_unordered (struct outseq *seq)
+{
+  uintmax_t key;
+  struct task *best = NULL;
+
+  seq->have_writer = false;
+  for (key = seq->base; key < seq->next; key++)
+    {
+      struct task *t = task_at (seq, key);
+      if (t->finished)
+        flush_task (seq, t);
+      else if (t->len && (!best || t->len > best->len))
+        {
+          best = t;
+          seq->writer = key;
+        }
+    }
+  if (best)
+    {
+      seq->have_writer = true;
+      flush_task (seq, best);
+    }
+  release_finished (seq);
+}
+
+
+struct outseq *
+outseq_create (FILE *stream, enum outseq_mode mode, size_t limit)
+{
+  struct outseq *seq = xmalloc (sizeof *seq);
+  seq->stream = stream;
+  seq->mode = mode;
+  seq->limit = limit;
+  seq->buffered = 0;
+  seq->ring_size = 16;
+  seq->ring = xnmalloc (seq->ring_size, sizeof *seq->ring);
+  seq->base = seq->next = 0;
+  seq->have_writer = false;
+  seq->writer = 0;
+  return seq;
+}
+
+uintmax_t
+outseq_start_task (struct outseq *seq)
+{
+  struct task *t;
+
+  if (seq->next - seq->base == seq->ring_size)
+    {
+      /* Move the tasks to the positions they have in a ring twice as
+       * large.
+       */
+      size_t new_size = seq->ring_size * 2;
+      struct task *ring = xnmalloc (new_size, sizeof *ring);
+      uintmax_t key;
+
+      for (key = seq->base; key < seq->next; key++)
+        ring[key & (new_size - 1)] = *task_at (seq, key);
+      free (seq->ring);
+      seq->ring = ring;
+      seq->ring_size = new_size;
+    }
+
+  seq->next++;
+  t = task_at (seq, seq->next - 1);
+  t->buf = NULL;
+  t->len = t->size = 0;
+  t->finished = false;
+  return seq->next - 1;
+}
+
+bool
+outseq_write (struct outseq *seq, uintmax_t key,
+              const void *data, size_t len)
+{
+  struct task *t = task_at (seq, key);
+
+  assert (!t->finished);
+  if (!len)
+    return true;
+  if (seq->mode == OUTSEQ_UNORDERED && !seq->have_writer)
+    {
+      /* Nothing is held back when there is no writer.  */
+      assert (seq->buffered == 0);
+      seq->have_writer = true;
+      seq->writer = key;
+    }
+
+  if (is_writer (seq, key))
+    {
+      fwrite (data, 1, len, seq->stream);
+      return true;
+    }
+
+  if (len > seq->limit - seq->buffered)
+    return false;
+  while (t->size - t->len < len)
+    t->buf = x2nrealloc (t->buf, &t->size, 1);
+  memcpy (t->buf + t->len, data, len);
+  t->len += len;
+  seq->buffered += len;
+  return true;
+}
+
+void
+outseq_finish_task (struct outseq *seq, uintmax_t key)
+{
+  struct task *t = task_at (seq, key);
+
+  assert (!t->finished);
+  t->finished = true;
+  if (seq->mode == OUTSEQ_ORDERED)
+    {
+      if (key == seq->base)
+        advance_ordered (seq);
+    }
+  else if (is_writer (seq, key))
+    choose_writer_unordered (seq);
+  else
+    release_finished (seq);
+}
+
+size_t
+outseq_buffered (const struct outseq *seq)
+{
+  return seq->buffered;
+}
+
+size_t
+outseq_pending (const struct outseq *seq)
+{
+  return seq->next - seq->base;
+}
+
+void
+outseq_destroy (struct outseq *seq)
+{
+  uintmax_t key;
+
+  /* The writer holds nothing back, so this keeps the output of each
+   * task together.
+   */
+  for (key = seq->base; key < seq->next; key++)
+    flush_task (seq, task_at (seq, key));
+  free (seq->ring);
+  free (seq);
+}
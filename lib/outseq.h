@@ -0,0 +1,101 @@
+/* outseq.h -- merge the output of concurrent tasks into one stream.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef OUTSEQ_H
+# define OUTSEQ_H
+
+/* An output sequencer collects the output of tasks which run at the
+ * same time (for example, child processes whose output is read from
+ * pipes) and writes it to a single stream so that the output of one
+ * task is never interleaved with that of another.
+ *
+ * Each task is identified by a sequence key, handed out in increasing
+ * order by outseq_start_task; callers start tasks in the order in
+ * which a serial program would have produced their output (for
+ * example, traversal order or the index of a starting point).
+ *
+ * In OUTSEQ_ORDERED mode the output appears exactly as if the tasks
+ * had run one after another in key order.  In OUTSEQ_UNORDERED mode
+ * the output of each task is still contiguous, but tasks are written
+ * in roughly the order in which they produce output, which avoids
+ * holding back the output of fast tasks behind a slow one.
+ *
+ * At any time one task (in ordered mode, the oldest unfinished one)
+ * writes straight to the stream, and only the output of the others is
+ * buffered.  The total size of the buffered data never exceeds the
+ * limit given to outseq_create: outseq_write refuses data which would
+ * exceed it, and the caller should then stop reading from that task
+ * until the sequencer has made room (which it does when the task
+ * writing to the stream finishes).  The task writing to the stream
+ * can always write, so this cannot deadlock.
+ *
+ * The sequencer does no locking and does not wait for anything; it is
+ * meant to be driven from a single event loop.  Errors writing to the
+ * stream are left for the caller to detect with ferror or at close.
+ */
+
+# include <stdbool.h>
+# include <stddef.h>
+# include <stdint.h>
+# include <stdio.h>
+
+enum outseq_mode
+  {
+    OUTSEQ_ORDERED,
+    OUTSEQ_UNORDERED
+  };
+
+struct outseq;
+
+/* Return a new sequencer writing to STREAM in MODE, buffering at most
+ * LIMIT bytes.
+ */
+struct outseq *outseq_create (FILE *stream, enum outseq_mode mode,
+                              size_t limit);
+
+/* Start a new task and return its sequence key.  Keys count up from
+ * zero.
+ */
+uintmax_t outseq_start_task (struct outseq *seq);
+
+/* Add the LEN bytes at DATA to the output of task KEY.  Return false,
+ * having consumed nothing, if they would have to be buffered and
+ * there is no room for them.
+ */
+bool outseq_write (struct outseq *seq, uintmax_t key,
+                   const void *data, size_t len);
+
+/* Record that task KEY has finished, and write out any output that
+ * this allows.
+ */
+void outseq_finish_task (struct outseq *seq, uintmax_t key);
+
+/* Return the number of bytes of output currently buffered.  */
+size_t outseq_buffered (const struct outseq *seq);
+
+/* Return the number of tasks which have been started but whose
+ * output has not all been written yet.  Callers which want to bound
+ * the memory used for bookkeeping should not start new tasks while
+ * this is large.
+ */
+size_t outseq_pending (const struct outseq *seq);
+
+/* Write out the output of all tasks, finished or not, in the order
+ * the mode requires, and free SEQ.
+ */
+void outseq_destroy (struct outseq *seq);
+
+#endif
@@ -19,8 +19,11 @@
 #include <config.h>
 
 /* system headers. */
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* gnulib headers. */
 #include "xalloc.h"
@@ -28,6 +31,84 @@
 /* find headers. */
 #include "printquoted.h"
 
+/* Return true if no byte of the 8 in W is a control character, DEL
+ * or a byte with the top bit set.  Borrows and carries between bytes
+ * can only cause false positives next to a byte which fails the test
+ * anyway, so the answer for the word as a whole is exact.
+ */
+static inline bool
+word_is_printable_ascii (uint64_t w)
+{
+  const uint64_t ones = UINT64_C (0x0101010101010101);
+  const uint64_t high = UINT64_C (0x8080808080808080);
+  uint64_t below_space = (w - ones * 0x20) & ~w & high;
+  uint64_t del_or_above = ((w + ones) | w) & high;
+  return !(below_space | del_or_above);
+}
+
+/* Return the length of the longest prefix of the LEN bytes at S
+ * which consists of printable ASCII characters (' ' to '~').  Names
+ * are checked eight bytes at a time, since almost all of them consist
+ * of nothing else.
+ */
+size_t
+printable_ascii_span (const char *s, size_t len)
+{
+  size_t i = 0;
+
+  for (; len - i >= sizeof (uint64_t); i += sizeof (uint64_t))
+    {
+      uint64_t w;
+      memcpy (&w, s + i, sizeof w);
+      if (!word_is_printable_ascii (w))
+        break;
+    }
+  for (; i < len; i++)
+    {
+      unsigned char c = s[i];
+      if (c < ' ' || c > '~')
+        break;
+    }
+  return i;
+}
+
+/* Return true if print_quoted would print the LEN bytes at S to a
+ * terminal unchanged when using QOPTS.  The literal quoting style
+ * (which is the one find and locate use) leaves printable ASCII
+ * characters alone, and qmark_chars never replaces them, so for such
+ * names the call to quotearg_buffer can be skipped.  We do not try to
+ * predict the other quoting styles.
+ */
+bool
+quoting_is_identity (const struct quoting_options *qopts,
+                     const char *s, size_t len)
+{
+  return (get_quoting_style (qopts) == literal_quoting_style
+          && printable_ascii_span (s, len) == len);
+}
+
+/* Print S, which is LEN bytes long, according to FORMAT, without
+ * quoting it.  The common formats are handled without fprintf.
+ */
+static int
+print_unquoted (FILE *fp, const char *format, const char *s, size_t len)
+{
+  if (format[0] == '%' && format[1] == 's'
+      && (format[2] == '\0' || (format[2] == '\n' && format[3] == '\0')))
+    {
+      if (fwrite (s, 1, len, fp) != len)
+        return -1;
+      if (format[2] == '\n')
+        {
+          if (putc ('\n', fp) == EOF)
+            return -1;
+          len++;
+        }
+      return len < INT_MAX ? len : INT_MAX;
+    }
+  return fprintf (fp, format, s);
+}
+
 /*
  * Print S according to the format FORMAT, but if the destination is a tty,
  * convert any potentially-dangerous characters.  The logic in this function
@@ -39,8 +120,9 @@ print_quoted (FILE *fp,
               bool dest_is_tty, const char *format, const char *s)
 {
   int rv;
+  size_t s_len = strlen (s);
 
-  if (dest_is_tty)
+  if (dest_is_tty && !quoting_is_identity (qopts, s, s_len))
     {
       char smallbuf[BUFSIZ];
       size_t len = quotearg_buffer (smallbuf, sizeof smallbuf, s, -1, qopts);
@@ -62,7 +144,7 @@ print_quoted (FILE *fp,
       len = qmark_chars (buf, len);
       buf[len] = 0;
 
-      rv = fprintf (fp, format, buf);   /* Print the quoted version */
+      rv = print_unquoted (fp, format, buf, len);       /* Print the quoted version */
       if (buf != smallbuf)
         {
           free (buf);
@@ -72,7 +154,7 @@ print_quoted (FILE *fp,
   else
     {
       /* no need to quote things. */
-      rv = fprintf (fp, format, s);
+      rv = print_unquoted (fp, format, s, s_len);
     }
   return rv;
 }
@@ -27,6 +27,9 @@
 
 
 size_t qmark_chars (char *buf, size_t len);
+size_t printable_ascii_span (const char *s, size_t len);
+bool quoting_is_identity (const struct quoting_options *qopts,
+                          const char *s, size_t len);
 int print_quoted (FILE * fp, const struct quoting_options *qopts,
                   bool dest_is_tty, const char *format, const char *s);
 
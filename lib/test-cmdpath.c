@@ -0,0 +1,166 @@
+/* test-cmdpath -- tests for cmdpath.c
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include <fcntl.h>              /* open, AT_FDCWD */
+#include <limits.h>             /* PATH_MAX */
+#include <stdio.h>              /* fprintf, snprintf */
+#include <stdlib.h>             /* EXIT_FAILURE, exit, getenv, mkdtemp, setenv */
+#include <string.h>             /* strcat, strcmp */
+#include <sys/stat.h>           /* mkdir, utimensat */
+#include <time.h>               /* time */
+#include <unistd.h>             /* close, getcwd, unlink, rmdir */
+
+#include "cmdpath.h"
+
+static char top[PATH_MAX];
+static char d1[PATH_MAX], d2[PATH_MAX], d3[PATH_MAX];
+
+static void
+fail (const char *what)
+{
+  perror (what);
+  exit (EXIT_FAILURE);
+}
+
+/* Make FILE in DIR with MODE.  */
+static void
+make_file (const char *dir, const char *file, mode_t mode)
+{
+  char name[PATH_MAX];
+  int fd;
+
+  snprintf (name, sizeof name, "%s/%s", dir, file);
+  fd = open (name, O_WRONLY | O_CREAT | O_TRUNC, mode);
+  if (fd < 0 || close (fd) != 0)
+    fail (name);
+}
+
+static void
+remove_file (const char *dir, const char *file)
+{
+  char name[PATH_MAX];
+
+  snprintf (name, sizeof name, "%s/%s", dir, file);
+  if (unlink (name) != 0)
+    fail (name);
+}
+
+/* Make DIR look as if it was last modified a while ago.  */
+static void
+settle (const char *dir)
+{
+  struct timespec ts[2];
+
+  ts[0].tv_sec = ts[1].tv_sec = time (NULL) - 60;
+  ts[0].tv_nsec = ts[1].tv_nsec = 0;
+  if (utimensat (AT_FDCWD, dir, ts, 0) != 0)
+    fail (dir);
+}
+
+static void
+check (const char *name, const char *dir, int line)
+{
+  char expected[PATH_MAX];
+  const char *result = cmdpath_lookup (name);
+
+  if (dir)
+    snprintf (expected, sizeof expected, "%s/%s", dir, name);
+  if (dir ? 0 != strcmp (result, expected) : result != name)
+    {
+      fprintf (stderr, "line %d: wrong result for %s: expected %s, got %s\n",
+               line, name, dir ? expected : name, result);
+      exit (EXIT_FAILURE);
+    }
+}
+#define CHECK(name, dir) check (name, dir, __LINE__)
+
+int
+main (void)
+{
+  static const char template[] = "/test-cmdpath.XXXXXX";
+  const char *tmpdir = getenv ("TMPDIR");
+  char path[3 * PATH_MAX + 3];
+
+  /* Work under $TMPDIR, or else in the build directory.  cmdpath only
+     caches absolute directories, so TOP must be absolute.  */
+  if (tmpdir && '/' == *tmpdir)
+    snprintf (top, sizeof top, "%s%s", tmpdir, template);
+  else if (getcwd (top, sizeof top - sizeof template))
+    strcat (top, template);
+  else
+    fail ("getcwd");
+  if (!mkdtemp (top))
+    fail ("mkdtemp");
+  snprintf (d1, sizeof d1, "%s/d1", top);
+  snprintf (d2, sizeof d2, "%s/d2", top);
+  snprintf (d3, sizeof d3, "%s/d3", top);
+  if (mkdir (d1, 0700) != 0 || mkdir (d2, 0700) != 0)
+    fail ("mkdir");
+  make_file (d2, "cmd", 0700);
+  make_file (d1, "cmd", 0600);  /* Not executable. */
+  snprintf (path, sizeof path, "%s:%s:%s", d1, d2, d3);
+  if (setenv ("PATH", path, 1) != 0)
+    fail ("setenv");
+
+  /* Names with a slash and names not found are left alone. */
+  CHECK ("./cmd", NULL);
+  CHECK ("nosuch", NULL);
+  CHECK ("", NULL);
+  CHECK ("cmd", d2);
+
+  /* Changes to the directories are noticed, whether or not they were
+     modified just before we looked.  */
+  settle (d1);
+  settle (d2);
+  CHECK ("cmd", d2);
+  remove_file (d1, "cmd");
+  make_file (d1, "cmd", 0700);
+  CHECK ("cmd", d1);
+  settle (d1);
+  CHECK ("cmd", d1);
+  remove_file (d1, "cmd");
+  CHECK ("cmd", d2);
+
+  /* So is a directory which did not exist. */
+  CHECK ("late", NULL);
+  if (mkdir (d3, 0700) != 0)
+    fail ("mkdir");
+  make_file (d3, "late", 0700);
+  CHECK ("late", d3);
+
+  /* A change to $PATH is noticed, and relative directories in it mean
+     the search is left to execvp.  */
+  if (setenv ("PATH", d1, 1) != 0)
+    fail ("setenv");
+  CHECK ("cmd", NULL);
+  snprintf (path, sizeof path, "%s::%s", d1, d2);
+  if (setenv ("PATH", path, 1) != 0)
+    fail ("setenv");
+  CHECK ("cmd", NULL);
+  if (unsetenv ("PATH") != 0)
+    fail ("unsetenv");
+  CHECK ("cmd", NULL);
+
+  cmdpath_forget ();
+  remove_file (d2, "cmd");
+  remove_file (d3, "late");
+  if (rmdir (d1) != 0 || rmdir (d2) != 0 || rmdir (d3) != 0
+      || rmdir (top) != 0)
+    fail ("rmdir");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,206 @@
+/* test-outseq - stress test for outseq.c
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>              /* fprintf, tmpfile */
+#include <stdlib.h>             /* EXIT_FAILURE, exit */
+#include <string.h>             /* memcmp */
+
+#include "xalloc.h"
+
+#include "outseq.h"
+
+/* The simulated tasks.  Each produces TEXT, in pieces of random
+ * sizes, starting with its number so that the output of a task can
+ * be recognised.
+ */
+struct sim_task
+{
+  uintmax_t key;
+  char *text;
+  size_t len;
+  size_t done;                  /* How much of TEXT has been accepted.  */
+  bool running;
+};
+
+static unsigned long rng_state;
+
+/* A fixed generator, so that failures can be reproduced.  */
+static unsigned long
+rng (unsigned long n)
+{
+  rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (rng_state >> 33) % n;
+}
+
+static void
+fail (const char *what, int mode, size_t limit)
+{
+  fprintf (stderr, "test-outseq: %s (mode %d, limit %lu)\n",
+           what, mode, (unsigned long) limit);
+  exit (EXIT_FAILURE);
+}
+
+static void
+make_text (struct sim_task *t, size_t i)
+{
+  size_t lines = rng (4);       /* Some tasks print nothing.  */
+  size_t size = 32, j;
+  t->text = xmalloc (size);
+  t->len = 0;
+  while (lines--)
+    {
+      size_t n = rng (300);
+      while (size - t->len < n + 32)
+        t->text = x2nrealloc (t->text, &size, 1);
+      t->len += sprintf (t->text + t->len, "<%lu>", (unsigned long) i);
+      for (j = 0; j < n; j++)
+        t->text[t->len++] = 'a' + rng (26);
+      t->text[t->len++] = '\n';
+    }
+  t->done = 0;
+  t->running = false;
+}
+
+/* Run N_TASKS tasks, at most WIDTH at a time, through a sequencer
+ * and check its output.
+ */
+static void
+run (enum outseq_mode mode, size_t limit, size_t n_tasks, size_t width)
+{
+  struct sim_task *tasks = xnmalloc (n_tasks, sizeof *tasks);
+  size_t *active = xnmalloc (width, sizeof *active);
+  size_t n_active = 0, started = 0, i;
+  FILE *fp = tmpfile ();
+  struct outseq *seq;
+
+  if (!fp)
+    fail ("cannot create a temporary file", mode, limit);
+  seq = outseq_create (fp, mode, limit);
+  for (i = 0; i < n_tasks; i++)
+    make_text (&tasks[i], i);
+
+  while (started < n_tasks || n_active)
+    {
+      size_t refused = 0;
+
+      /* Start tasks in order, as find would visit files.  */
+      while (started < n_tasks && n_active < width
+             && outseq_pending (seq) < 4 * width)
+        {
+          struct sim_task *t = &tasks[started];
+          t->key = outseq_start_task (seq);
+          if (t->key != started)
+            fail ("keys are not handed out in order", mode, limit);
+          t->running = true;
+          active[n_active++] = started++;
+        }
+
+      /* Let the running tasks make progress in a random order, until
+       * one of them finishes.  */
+      for (;;)
+        {
+          size_t slot = rng (n_active);
+          struct sim_task *t = &tasks[active[slot]];
+          size_t n = rng (t->len - t->done + 1);
+
+          if (t->done == t->len && rng (2))
+            {
+              outseq_finish_task (seq, t->key);
+              t->running = false;
+              active[slot] = active[--n_active];
+              break;
+            }
+          if (outseq_write (seq, t->key, t->text + t->done, n))
+            {
+              t->done += n;
+              refused = 0;
+            }
+          else if (++refused > 100000)
+            fail ("no task can make progress", mode, limit);
+          if (outseq_buffered (seq) > limit)
+            fail ("too much output held back", mode, limit);
+        }
+    }
+  if (outseq_pending (seq) || outseq_buffered (seq))
+    fail ("output left over", mode, limit);
+  outseq_destroy (seq);
+
+  /* Check what was written.  */
+  {
+    long size = ftell (fp);
+    char *out = xmalloc (size + 1);
+    size_t pos = 0;
+    bool *seen = xcalloc (n_tasks, sizeof *seen);
+
+    rewind (fp);
+    if (fread (out, 1, size, fp) != size)
+      fail ("cannot read back the output", mode, limit);
+    out[size] = '\0';
+
+    for (i = 0; i < n_tasks; i++)
+      {
+        struct sim_task *t;
+        if (mode == OUTSEQ_ORDERED)
+          t = &tasks[i];
+        else if (pos < size)
+          {
+            /* The next task is the one whose number comes next.  */
+            unsigned long k = strtoul (out + pos + 1, NULL, 10);
+            if (out[pos] != '<' || k >= n_tasks || seen[k])
+              fail ("output of a task is not contiguous", mode, limit);
+            t = &tasks[k];
+            seen[k] = true;
+          }
+        else
+          break;
+        if (t->len > size - pos || memcmp (out + pos, t->text, t->len))
+          fail ("output differs from the tasks' output", mode, limit);
+        pos += t->len;
+      }
+    if (pos != size)
+      fail ("unexpected output", mode, limit);
+
+    free (seen);
+    free (out);
+  }
+
+  for (i = 0; i < n_tasks; i++)
+    free (tasks[i].text);
+  free (tasks);
+  free (active);
+  fclose (fp);
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const size_t limits[] = { 0, 1, 100, 4096, 1000000 };
+  static const size_t widths[] = { 1, 2, 7, 64 };
+  size_t l, w;
+  int mode;
+
+  rng_state = 1;
+  for (mode = OUTSEQ_ORDERED; mode <= OUTSEQ_UNORDERED; mode++)
+    for (l = 0; l < sizeof limits / sizeof limits[0]; l++)
+      for (w = 0; w < sizeof widths / sizeof widths[0]; w++)
+        run (mode, limits[l], 3000, widths[w]);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+#!/bin/sh
+# Verify that 'find -batchtime' starts with small command lines for
+# -exec ... {} + and makes them longer for a quick command, and that
+# every file is given to a command exactly once, also with -maxprocs.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+# The command logs the number of its arguments, and prints them.
+mkdir bin \
+  && cat > bin/count <<'EOF2' \
+  && chmod +x bin/count \
+  || framework_failure_
+#!/bin/sh
+echo $# >> "$LOG"
+printf '%s\n' "$@"
+EOF2
+LOG="$PWD/log" && export LOG || framework_failure_
+PATH="$PWD/bin:$PATH" || framework_failure_
+
+mkdir dir || framework_failure_
+for i in $(seq 300); do
+  echo "dir/f$i"
+done > list || framework_failure_
+xargs touch < list || framework_failure_
+sort list > exp || framework_failure_
+
+find dir -batchtime 100 -type f -exec count {} + > out 2> err || fail=1
+sort out | compare exp - || fail=1
+compare /dev/null err || fail=1
+test "$(head -n 1 log)" = 1 || fail=1
+test $(wc -l < log) -le 10 || fail=1
+
+# Like other global options, -batchtime also applies to actions which
+# come before it (find warns about the order).
+rm -f log || framework_failure_
+find dir -type f -exec count {} + -batchtime 100 > out 2> /dev/null \
+  || fail=1
+sort out | compare exp - || fail=1
+test "$(head -n 1 log)" = 1 || fail=1
+
+rm -f log || framework_failure_
+find dir -type f -maxprocs 3 -batchtime 0.5 -exec count {} + > out \
+  || fail=1
+sort out | compare exp - || fail=1
+test $(awk '{ n += $1 } END { print n }' log) = 300 || fail=1
+
+for t in 0 -1 x; do
+  returns_ 1 find dir -batchtime "$t" -exec count {} + 2> /dev/null \
+    || fail=1
+done
+
+Exit $fail
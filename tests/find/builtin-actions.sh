@@ -0,0 +1,84 @@
+#!/bin/sh
+# Verify the -chmod, -chown, -touch, -moveto and -linkto actions.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+mkdir d d/sub dest links || framework_failure_
+touch d/a d/sub/b || framework_failure_
+chmod 600 d/a d/sub/b || framework_failure_
+
+# -chmod works like chmod, with symbolic and octal modes.
+find d -type f -chmod go+r || fail=1
+test 2 = $(find d -type f -perm 644 | wc -l) || fail=1
+find d/a -chmod 0640 || fail=1
+find d/a -perm 640 > out || fail=1
+echo d/a > exp || framework_failure_
+compare exp out || fail=1
+returns_ 1 find d -chmod 'a+q' 2> /dev/null || fail=1
+
+# -chown to the owner and group the files already have succeeds.
+u=$(id -u) && g=$(id -g) || framework_failure_
+find d -chown "$u:$g" > out || fail=1
+compare /dev/null out || fail=1
+find d -chown ":$g" > out || fail=1
+compare /dev/null out || fail=1
+# As with chown, a bare ':' is accepted and changes nothing.
+find d -chown ':' -print > out || fail=1
+find d > exp || framework_failure_
+compare exp out || fail=1
+
+# -touch sets the times to now.
+touch -d '2001-01-01 00:00:00' d/a d/sub/b || framework_failure_
+touch -d '2010-01-01 00:00:00' ref || framework_failure_
+find d -type f -newer ref > out || fail=1
+compare /dev/null out || fail=1
+find d/a -touch || fail=1
+find d -type f -newer ref -print > out || fail=1
+compare exp out || fail=1
+
+# -linkto makes hard links, and -moveto moves files.
+find d -type f -linkto links || fail=1
+test -f links/a && test -f links/b || fail=1
+find d/sub -type f -moveto dest || fail=1
+test -f dest/b && test ! -f d/sub/b || fail=1
+
+# -moveto implies -depth, so moving a directory does not leave find
+# trying to search it under its old name.
+mkdir src src/x src/x/y dst || framework_failure_
+find src -type d -name x -moveto dst > out 2> err || fail=1
+compare /dev/null err || fail=1
+test -d dst/x/y && test ! -d src/x || fail=1
+
+# Failures are reported, with the exit status set, and the action is
+# false.
+find d/a -linkto links -print > out 2> err && fail=1
+compare /dev/null out || fail=1
+grep 'failed to create hard link' err || { cat err; fail=1; }
+returns_ 1 find d -moveto nosuchdir 2> /dev/null || fail=1
+
+# -moveto does not replace a file already in the directory.
+echo old > dest/a || framework_failure_
+find d/a -moveto dest -print > out 2> err && fail=1
+compare /dev/null out || fail=1
+grep 'cannot move' err || { cat err; fail=1; }
+test -f d/a || fail=1
+echo old > exp || framework_failure_
+compare exp dest/a || fail=1
+
+Exit $fail
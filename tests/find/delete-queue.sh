@@ -0,0 +1,67 @@
+#!/bin/sh
+# Verify that -delete removes whole trees when its removals are queued,
+# that directories are only removed (or tested by -empty) once their
+# contents are gone, and that failures are still reported.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+make_tree ()
+{
+  for d in a a/b a/b/c e e/f g; do
+    mkdir -p "$1/$d" || framework_failure_
+    for i in 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19; do
+      echo x > "$1/$d/file$i" || framework_failure_
+    done
+  done
+}
+
+# Everything goes, including the starting point.
+make_tree d
+find d -delete > out 2> err || fail=1
+compare /dev/null out || fail=1
+compare /dev/null err || fail=1
+test -e d && fail=1
+
+# -empty sees a directory after the files in it have been removed, so
+# the removal of the directories cascades.
+make_tree d
+find d \( -type f -delete \) , \( -type d -empty -delete \) 2> err || fail=1
+compare /dev/null err || fail=1
+test -e d && fail=1
+
+# Commands see the files removed before them.
+make_tree d
+find d \( -name 'file*' -delete \) , \( -type d -exec ls -A {} + \) \
+  > out 2> err || fail=1
+compare /dev/null err || fail=1
+grep file out && fail=1
+
+# A file which cannot be removed is reported, its directories are left,
+# and the exit status is nonzero.  Privileged users can remove anything.
+if test "$(id -u)" != 0; then
+  make_tree d
+  chmod a-w d/a/b/c || framework_failure_
+  returns_ 1 find d -delete 2> err || fail=1
+  chmod u+w d/a/b/c || framework_failure_
+  grep 'cannot delete' err || { cat err; fail=1; }
+  test -d d/a/b/c && test ! -e d/e || fail=1
+  rm -rf d
+fi
+
+Exit $fail
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Verify that -maxprocs runs commands at the same time.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+mkdir d || framework_failure_
+touch d/a d/b || framework_failure_
+
+# Each command waits for the other to start, which only works if they
+# run at the same time.  find must also wait for both before exiting.
+cat > meet <<\EOF_MEET || framework_failure_
+touch "started.${1##*/}"
+i=0
+while test $i -lt 20; do
+  if test -e started.a && test -e started.b; then
+    echo "${1##*/}" >> met
+    exit 0
+  fi
+  sleep 1
+  i=$(expr $i + 1)
+done
+exit 1
+EOF_MEET
+
+find d -maxprocs 2 -type f -exec sh ./meet {} ';' || fail=1
+printf '%s\n' a b > exp || framework_failure_
+LC_ALL=C sort met > out || fail=1
+compare exp out || fail=1
+
+# A failing command terminated by '+' still makes find fail; one
+# terminated by ';' does not.
+returns_ 1 find d -maxprocs 3 -type f -exec false {} + || fail=1
+find d -maxprocs 3 -type f -exec false {} ';' || fail=1
+
+# Commands whose result is tested still run to completion first.
+find d -maxprocs 3 -type f -exec false {} ';' -print > out || fail=1
+compare /dev/null out || fail=1
+
+# The argument must be a positive integer.
+for n in 0 -1 x ''; do
+  returns_ 1 find d -maxprocs "$n" > out 2> err || fail=1
+  compare /dev/null out || fail=1
+done
+
+Exit $fail
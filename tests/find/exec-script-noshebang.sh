@@ -0,0 +1,47 @@
+#!/bin/sh
+# Verify that find runs a command without a "#!" line with /bin/sh, as
+# execvp does, however it starts the command.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+# The system cannot execute this itself (ENOEXEC).
+printf '%s\n' 'echo "$# args: $*"' > script \
+  && chmod +x script \
+  || framework_failure_
+
+mkdir d && touch d/a d/b || framework_failure_
+
+find d -name a -exec ./script x '{}' \; > out 2> err || fail=1
+echo '2 args: x d/a' > exp || framework_failure_
+compare exp out || fail=1
+compare /dev/null err || fail=1
+
+find d -type f -exec ./script '{}' + > out 2> err || fail=1
+test "$(cut -d' ' -f1,2 out)" = '2 args:' || { cat out; fail=1; }
+compare /dev/null err || fail=1
+
+# Also when the command is found in $PATH.
+mkdir bin && cp script bin/noshebang || framework_failure_
+PATH="$PWD/bin:$PATH" find d -name a -execdir noshebang '{}' \; \
+  > out 2> err || fail=1
+echo '1 args: ./a' > exp || framework_failure_
+compare exp out || fail=1
+compare /dev/null err || fail=1
+
+Exit $fail
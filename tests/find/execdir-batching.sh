@@ -0,0 +1,97 @@
+#!/bin/sh
+# Verify that 'find -execdir CMD {} +' runs one command per directory
+# even when the files of a directory are visited on either side of its
+# subdirectories, and that each command runs in the right directory,
+# also when more directories are waiting than find keeps open.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+# The command checks that its arguments are in its working directory,
+# and logs the directory and the number of arguments, and (in
+# $LOG.files) the full name of each argument.
+mkdir bin \
+  && cat > bin/check <<'EOF' \
+  && chmod +x bin/check \
+  || framework_failure_
+#!/bin/sh
+for f
+do
+  test -f "$f" || echo "$PWD: no file $f" >&2
+  echo "$PWD/${f#./}" >> "$LOG.files"
+done
+echo "$PWD $#" >> "$LOG"
+EOF
+LOG="$PWD/log" && export LOG || framework_failure_
+PATH="$PWD/bin:$PATH" || framework_failure_
+
+# A directory with files and subdirectories mixed, so that (whatever
+# order readdir returns them in) most of its files are likely to be
+# visited on either side of a subdirectory.
+numbers="01 02 03 04 05 06 07 08 09 10 11 12 13 14 15 16 17 18 19 20"
+mkdir top || framework_failure_
+for i in $numbers; do
+  mkdir "top/d$i" \
+    && touch "top/f$i" "top/d$i/a" "top/d$i/b" \
+    || framework_failure_
+done
+
+find top -type f -execdir check '{}' + 2> err || fail=1
+compare /dev/null err || fail=1
+# One command for each of the 21 directories: 20 files in top, and
+# 2 in each subdirectory.
+sort log > out || framework_failure_
+{ echo "$PWD/top 20"
+  for i in $numbers; do
+    echo "$PWD/top/d$i 2"
+  done
+} > exp || framework_failure_
+compare exp out || fail=1
+
+# A chain of 40 nested directories, each with two files, is deeper than
+# the number of directories find keeps waiting, so some commands run
+# early, and a directory may then get more than one command.  Each file
+# must still be passed exactly once, from its own directory.
+rm -f log.files || framework_failure_
+dir=chain
+exp_dirs=
+for i in $numbers $numbers; do
+  mkdir "$dir" && touch "$dir/x" "$dir/y" || framework_failure_
+  exp_dirs="$exp_dirs $dir"
+  dir="$dir/s"
+done
+find chain -type f -execdir check '{}' + 2> err || fail=1
+compare /dev/null err || fail=1
+sort log.files > out || framework_failure_
+for d in $exp_dirs; do
+  echo "$PWD/$d/x"
+  echo "$PWD/$d/y"
+done | sort > exp || framework_failure_
+compare exp out || fail=1
+
+# The same, with few file descriptors to spare.
+if (ulimit -n 20) 2>/dev/null; then
+  rm -f log.files || framework_failure_
+  ( ulimit -n 20 && find chain -type f -execdir check '{}' + ) 2> err \
+    || fail=1
+  compare /dev/null err || fail=1
+  sort log.files > out || framework_failure_
+  compare exp out || fail=1
+fi
+
+Exit $fail
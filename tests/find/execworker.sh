@@ -0,0 +1,93 @@
+#!/bin/sh
+# Verify that 'find -execworker CMD ;' sends file names to a single
+# command and uses the statuses it reports.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+bash=$(command -v bash) || skip_ "required utility 'bash' missing"
+
+# The worker logs its process ID and each name, and reports success
+# for names containing "ok".  The quitter reads one name and exits
+# without reporting on it; the dier does the same a second later, by
+# killing itself.
+mkdir bin \
+  && { echo "#!$bash"
+       cat <<'EOF2'
+while IFS= read -r -d '' name; do
+  echo "$$ $name" >> "$LOG"
+  case $name in
+    *ok*) status=0 ;;
+    *) status=1 ;;
+  esac
+  printf '%s\0' $status >&3
+done
+EOF2
+     } > bin/worker \
+  && { echo "#!$bash"
+       echo "IFS= read -r -d '' name"
+     } > bin/quitter \
+  && { echo "#!$bash"
+       echo "IFS= read -r -d '' name; sleep 1; kill -KILL \$\$"
+     } > bin/dier \
+  && chmod +x bin/worker bin/quitter bin/dier \
+  || framework_failure_
+LOG="$PWD/log" && export LOG || framework_failure_
+PATH="$PWD/bin:$PATH" || framework_failure_
+
+mkdir d && touch d/ok1 d/bad1 d/ok2 d/bad2 d/ok3 || framework_failure_
+
+# The result of -execworker decides which files are printed.
+find d -type f -execworker worker \; -print > out 2> err || fail=1
+compare /dev/null err || fail=1
+sort out > out2 || framework_failure_
+printf '%s\n' d/ok1 d/ok2 d/ok3 > exp || framework_failure_
+compare exp out2 || fail=1
+
+# Every name went to a single worker.
+test $(wc -l < log) = 5 || fail=1
+test $(cut -d' ' -f1 log | sort -u | wc -l) = 1 || fail=1
+
+# When nothing tests the result, the names may be shared between up to
+# -maxprocs workers; a failure does not change the exit status, as for
+# -exec ... ;.
+rm -f log || framework_failure_
+find d -maxprocs 3 -type f -execworker worker \; 2> err || fail=1
+compare /dev/null err || fail=1
+cut -d' ' -f2 log | sort > out || framework_failure_
+printf '%s\n' d/bad1 d/bad2 d/ok1 d/ok2 d/ok3 > exp || framework_failure_
+compare exp out || fail=1
+test $(cut -d' ' -f1 log | sort -u | wc -l) -le 3 || fail=1
+
+# A worker which exits without reporting on a file makes find fail.
+returns_ 1 find d -type f -execworker quitter \; 2> err || fail=1
+grep 'quitter exited without reporting' err > /dev/null || fail=1
+
+# Workers are children of find too, so one may die while find waits
+# for a -maxprocs slot; find must still report it.
+mkdir e && touch e/f1 e/f2 e/f3 || framework_failure_
+returns_ 1 find e -maxprocs 2 -type f \( -execworker dier \; , \
+  -exec sleep 3 \; \) 2> err || fail=1
+grep 'dier terminated by signal' err > /dev/null || { cat err; fail=1; }
+grep 'dier exited without reporting' err > /dev/null || { cat err; fail=1; }
+
+# The file names are not given on the command line.
+returns_ 1 find d -execworker worker '{}' \; 2> /dev/null || fail=1
+
+Exit $fail
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Verify that find can write to more output files than it may keep open.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+( ulimit -n 64 ) 2>/dev/null || skip_ "cannot lower the limit on open files"
+
+mkdir d out || framework_failure_
+
+# Route each of 200 files to its own output file.  The starting point
+# is given twice, so each output file is written to, probably closed
+# to make room for others, and then written to again.
+set x
+i=0
+while test $i -lt 200; do
+  touch d/f$i || framework_failure_
+  set "$@" -o -name f$i -fprint out/$i
+  i=$(expr $i + 1)
+done
+shift
+
+( ulimit -n 64 && exec find d d -false "$@" ) || fail=1
+
+i=0
+while test $i -lt 200; do
+  printf 'd/f%s\nd/f%s\n' $i $i > exp || framework_failure_
+  compare exp out/$i || fail=1
+  i=$(expr $i + 1)
+done
+
+Exit $fail
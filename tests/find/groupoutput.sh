@@ -0,0 +1,57 @@
+#!/bin/sh
+# Verify that -groupoutput keeps the output of each command together.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+mkdir d || framework_failure_
+touch d/a d/b d/c || framework_failure_
+
+# Each command prints two lines a second apart, and the later the file
+# comes in the alphabet the sooner its command starts printing.  Run
+# at the same time, their output would be interleaved and in the
+# reverse order.
+cat > say <<\EOF_SAY || framework_failure_
+case $1 in
+  */a) sleep 2 ;;
+  */b) sleep 1 ;;
+esac
+echo "$1 1"
+sleep 1
+echo "$1 2"
+EOF_SAY
+find d -type f -exec sh ./say {} ';' > exp || framework_failure_
+
+# In order, the output is just what it is without -maxprocs.
+find d -maxprocs 3 -groupoutput ordered -type f -exec sh ./say {} ';' \
+  > out || fail=1
+compare exp out || fail=1
+
+# Otherwise, the two lines of each command are still together.
+find d -maxprocs 3 -groupoutput unordered -type f -exec sh ./say {} ';' \
+  > out || fail=1
+LC_ALL=C sort exp > exp2 && LC_ALL=C sort out > out2 || framework_failure_
+compare exp2 out2 || fail=1
+awk 'NR % 2 { name = $1; next } $1 != name { exit 1 }' out \
+  || { cat out; fail=1; }
+
+# The order must be one of the two.
+returns_ 1 find d -groupoutput sideways > out 2> err || fail=1
+compare /dev/null out || fail=1
+
+Exit $fail
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Verify that -links-once visits each multiply-linked file only once.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+mkdir d d/a d/b d/c || framework_failure_
+echo x > d/a/f || framework_failure_
+echo y > d/a/single || framework_failure_
+ln d/a/f d/b/f || skip_ "hard links are not supported"
+ln d/a/f d/c/g || framework_failure_
+
+# Without the option, every name is visited.
+find d -type f > out || fail=1
+test 4 = $(wc -l < out) || { cat out; fail=1; }
+
+# With it, the three names of d/a/f yield a single file; directories
+# and files with only one link are not affected.
+find d -links-once -type f > out || fail=1
+test 2 = $(wc -l < out) || { cat out; fail=1; }
+grep -F 'd/a/single' out > /dev/null || fail=1
+test 4 = $(find d -links-once -type d | wc -l) || fail=1
+
+# The option also applies when the names are given as starting points.
+find d/b/f d/c/g d/a/f -links-once > out || fail=1
+echo d/b/f > exp || framework_failure_
+compare exp out || fail=1
+
+Exit $fail
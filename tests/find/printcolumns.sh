@@ -0,0 +1,52 @@
+#!/bin/sh
+# Verify the file format written by -fprintcolumns.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+mkdir -p d/a d/b || framework_failure_
+printf 'hello' > d/f || framework_failure_
+touch d/a/x d/a/y d/b/z || framework_failure_
+
+# The magic, a schema block, one batch and the end block.
+find d/f -fprintcolumns out.col size || fail=1
+od -An -tx1 -v out.col | tr -d ' \n' > out || framework_failure_
+printf '%s' 46494e44434f4c31 \
+  01000000000000001000000000000000 01000000010473697a65000000000000 \
+  03000000000000001800000000000000 0100000000000000 \
+  0800000000000000 0500000000000000 \
+  04000000000000001000000000000000 0100000000000000 0000000000000000 \
+  > exp || framework_failure_
+compare exp out || fail=1
+
+# The end block counts 7 rows (d, d/a, d/b, d/f, d/a/x, d/a/y and
+# d/b/z) and 4 directory names ("", "d/", "d/a/" and "d/b/").
+find d -fprintcolumns out.col path,mtime,mode || fail=1
+tail -c 16 out.col | od -An -tx1 -v | tr -d ' \n' > out \
+  || framework_failure_
+printf '%s' 0700000000000000 0400000000000000 > exp || framework_failure_
+compare exp out || fail=1
+
+# Unknown and repeated columns are rejected.
+returns_ 1 find d -fprintcolumns out.col path,name > /dev/null 2> err \
+  || fail=1
+returns_ 1 find d -fprintcolumns out.col size,size > /dev/null 2> err \
+  || fail=1
+returns_ 1 find d -fprintcolumns out.col '' > /dev/null 2> err || fail=1
+
+Exit $fail
@@ -0,0 +1,57 @@
+#!/bin/sh
+# Verify the -printf directives %z and %j.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+LC_ALL=C
+export LC_ALL
+
+# Sizes around the points where the output changes form.
+for size in 0 999 1000 1023 1024 1025 1536 10239 10240 10241 1047552 \
+    1048064 1048576; do
+  dd if=/dev/zero of=f$size bs=1 seek=$size count=0 2>/dev/null \
+    || framework_failure_
+done
+
+cat > exp <<\EOT
+f0 0 0
+f999 999 999
+f1000 1000 1.0k
+f1023 1023 1.1k
+f1024 1.0K 1.1k
+f1025 1.1K 1.1k
+f1536 1.5K 1.6k
+f10239 10K 11k
+f10240 10K 11k
+f10241 11K 11k
+f1047552 1023K 1.1M
+f1048064 1.0M 1.1M
+f1048576 1.0M 1.1M
+EOT
+
+find . -name 'f*' -printf '%f %z %j\n' | LC_ALL=C sort -t f -k 2n > out \
+  || fail=1
+compare exp out || fail=1
+
+# Field widths and the - flag apply as for other directives.
+printf '[  1.5K][1.6k  ]\n' > exp || framework_failure_
+find f1536 -printf '[%6z][%-6j]\n' > out || fail=1
+compare exp out || fail=1
+
+Exit $fail
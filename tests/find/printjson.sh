@@ -0,0 +1,50 @@
+#!/bin/sh
+# Verify the record formats of -printjson and -printtlv.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ find
+
+mkdir d || framework_failure_
+printf 'hello' > d/f || framework_failure_
+# A name with a tab, a quote, a backslash and a byte which is not UTF-8.
+touch "$(printf 'd/a\tb"c\\\377')" || framework_failure_
+
+# Names are escaped; numbers are not quoted, except %m.
+chmod 644 d/f || framework_failure_
+echo '{"name":"d/f","s":5,"m":"644","d":1}' > exp || framework_failure_
+find d -type f -name f -printjson 'name=%p,%s,%m,%d' > out || fail=1
+compare exp out || fail=1
+
+find d -type f -name 'a*' -printjson '%f' > out || fail=1
+printf '{"f":"a\\tb\\"c\\\\\\udcff"}\n' > exp || framework_failure_
+compare exp out || fail=1
+
+# Each -printtlv record is a length, then per field a number, a type,
+# a length and a value, all little-endian.
+find d/f -printtlv '%p,%s' > out.tlv || fail=1
+od -An -tx1 -v out.tlv | tr -d ' \n' > out || framework_failure_
+printf '%s' 17000000 000003000000642f66 0101080000000500000000000000 \
+  > exp || framework_failure_
+compare exp out || fail=1
+
+# Fields must be -printf directives.
+returns_ 1 find d -printjson 'name=p' > /dev/null 2> err || fail=1
+returns_ 1 find d -printtlv '%p,' > /dev/null 2> err || fail=1
+returns_ 1 find d -fprintjson out '%%' > /dev/null 2> err || fail=1
+
+Exit $fail
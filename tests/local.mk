@@ -18,7 +18,8 @@
 built_programs = find xargs frcode locate updatedb
 
 AM_CPPFLAGS = -I$(top_srcdir)/gl/lib -I$(top_srcdir)/lib
-LDADD = $(top_builddir)/lib/libfind.a $(top_builddir)/gl/lib/libgnulib.a
+LDADD = $(top_builddir)/lib/libfind.a $(top_builddir)/gl/lib/libgnulib.a \
+  $(CLOCK_TIME_LIB)
 
 # Indirections required so that we'll still be able to know the
 # complete list of our tests even if the user overrides TESTS
@@ -92,7 +93,8 @@ all_root_tests = \
 check_PROGRAMS = $(binary_tests)
 binary_tests = \
         tests/xargs/test-option-range \
-	tests/xargs/test-sigusr
+	tests/xargs/test-sigusr \
+	tests/xargs/test-exec-limit
 
 ALL_RECURSIVE_TARGETS += check-root
 .PHONY: check-root
@@ -119,6 +121,9 @@ sh_tests = \
   tests/misc/help-version.sh \
   tests/find/depth-unreadable-dir.sh \
   tests/find/inode-zero.sh \
+  tests/find/links-once.sh \
+  tests/find/builtin-actions.sh \
+  tests/find/delete-queue.sh \
   tests/find/many-dir-entries-vs-OOM.sh \
   tests/find/name-lbracket-literal.sh \
   tests/find/ls-format-file.sh \
@@ -127,9 +132,19 @@ sh_tests = \
   tests/find/printf_escapechars.sh \
   tests/find/printf_escape_c.sh \
   tests/find/printf_inode.sh \
+  tests/find/printf_human_size.sh \
+  tests/find/exec-maxprocs.sh \
+  tests/find/groupoutput.sh \
+  tests/find/fprint-many-files.sh \
+  tests/find/printcolumns.sh \
+  tests/find/printjson.sh \
   tests/find/operators-wrong-with-dash.sh \
   tests/find/execdir-fd-leak.sh \
+  tests/find/execdir-batching.sh \
+  tests/find/execworker.sh \
+  tests/find/batchtime.sh \
   tests/find/exec-plus-last-file.sh \
+  tests/find/exec-script-noshebang.sh \
   tests/find/files0-from.sh \
   tests/find/refuse-noop.sh \
   tests/find/debug-missing-arg.sh \
@@ -141,6 +156,9 @@ sh_tests = \
   tests/find/user-group-max.sh \
   tests/xargs/conflicting_opts.sh \
   tests/xargs/verbose-quote.sh \
+  tests/xargs/exec-script-noshebang.sh \
+  tests/xargs/worker.sh \
+  tests/xargs/batch-time.sh \
   tests/find/arg-nan.sh \
   tests/find/mount-vs-xdev.sh \
   $(all_root_tests)
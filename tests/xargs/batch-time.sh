@@ -0,0 +1,65 @@
+#!/bin/sh
+# Verify that 'xargs --batch-time' starts with small command lines and
+# makes them longer for a quick command, and that every argument is
+# used exactly once, also with -P.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ xargs
+
+# The command logs the number of its arguments, and prints them.
+mkdir bin \
+  && cat > bin/count <<'EOF2' \
+  && chmod +x bin/count \
+  || framework_failure_
+#!/bin/sh
+echo $# >> "$LOG"
+printf '%s\n' "$@"
+EOF2
+LOG="$PWD/log" && export LOG || framework_failure_
+PATH="$PWD/bin:$PATH" || framework_failure_
+seq 1000 > exp || framework_failure_
+
+# The first command gets one argument.  The command is much quicker
+# than the target, so the number grows (by up to 4 times per command)
+# and a few commands do.
+xargs --batch-time=100 count < exp > out 2> err || fail=1
+compare exp out || fail=1
+compare /dev/null err || fail=1
+test "$(head -n 1 log)" = 1 || fail=1
+test $(wc -l < log) -le 12 || fail=1
+
+# With -P, the commands run at the same time, and the last arguments
+# are shared out among them.
+rm -f log || framework_failure_
+xargs -P 4 --batch-time=0.5 count < exp > out 2> err || fail=1
+sort -n out | compare exp - || fail=1
+compare /dev/null err || fail=1
+test $(awk '{ n += $1 } END { print n }' log) = 1000 || fail=1
+
+# -n still limits the number of arguments.
+rm -f log || framework_failure_
+xargs -n 10 --batch-time=100 count < exp > out || fail=1
+compare exp out || fail=1
+test $(sort -n log | tail -n 1) = 10 || fail=1
+
+# The time must be a positive number.
+for t in 0 -1 x 1x ''; do
+  returns_ 1 xargs --batch-time="$t" < /dev/null 2> /dev/null || fail=1
+done
+
+Exit $fail
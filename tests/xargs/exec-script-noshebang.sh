@@ -0,0 +1,43 @@
+#!/bin/sh
+# Verify that xargs runs a command without a "#!" line with /bin/sh, as
+# execvp does, however it starts the command.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ xargs
+
+# The system cannot execute this itself (ENOEXEC).
+printf '%s\n' 'echo "$# args: $*"' > script \
+  && chmod +x script \
+  || framework_failure_
+
+printf '%s\n' a b c | xargs ./script x > out 2> err || fail=1
+echo '4 args: x a b c' > exp || framework_failure_
+compare exp out || fail=1
+compare /dev/null err || fail=1
+
+# Also when the command is found in $PATH, and with several commands
+# running at once.
+mkdir bin && cp script bin/noshebang || framework_failure_
+printf '%s\n' a b c | PATH="$PWD/bin:$PATH" xargs -n1 -P2 noshebang \
+  > out 2> err || fail=1
+sort out > out2 || framework_failure_
+printf '1 args: %s\n' a b c > exp || framework_failure_
+compare exp out2 || fail=1
+compare /dev/null err || fail=1
+
+Exit $fail
@@ -0,0 +1,245 @@
+/* test-exec-limit -- check that command lines fit the system's limits
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Build command lines as "xargs -s" does with the largest size it
+   accepts, out of arguments of each of many lengths, and run them
+   (this program runs itself with the argument --child).  The system
+   must never refuse one with E2BIG.  Also check that the first command
+   line would not still have fitted with much more added to it, so that
+   the limits buildcmd works out are not far too cautious.  Then do it
+   all again with the stack size limit raised as far as possible, which
+   raises ARG_MAX on Linux.  */
+
+/* config.h must be included first. */
+#include <config.h>
+
+/* System headers */
+#include <errno.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* gnulib headers */
+#include <error.h>
+#include "xalloc.h"
+
+/* findutils headers */
+#include "buildcmd.h"
+
+
+/* The headroom xargs leaves for the command to add to the environment. */
+enum { HEADROOM = 2048 };
+
+static const char *self;
+
+/* The length (without the null) of the arguments being tried. */
+static size_t arg_length;
+
+/* Commands run and refused for the current length. */
+static size_t commands;
+static size_t refusals;
+
+/* If nonzero, check that this many more bytes of arguments would not
+   have fitted on the next command line.  */
+static size_t probe_bytes;
+
+/* The number of command lines on which they would have fitted. */
+static size_t roomy;
+
+
+/* Run ARGV, and return 0 or the error number with which the system
+   refused to run it.  */
+static int
+run (char **argv)
+{
+  pid_t pid;
+  int status;
+  int err = posix_spawnp (&pid, self, NULL, NULL, argv, environ);
+
+  if (err)
+    return err;
+  while (waitpid (pid, &status, 0) < 0)
+    if (errno != EINTR)
+      error (EXIT_FAILURE, errno, "waitpid");
+  if (!WIFEXITED (status) || WEXITSTATUS (status))
+    error (EXIT_FAILURE, 0, "%s --child failed", self);
+  return 0;
+}
+
+/* Return true if ARGV (which has ARGC entries before its null) can
+   still be run with enough extra arguments of the current length added
+   to take up at least EXTRA_BYTES more.  */
+static bool
+fits_with_extra (char **argv, size_t argc, size_t extra_bytes)
+{
+  const size_t count = extra_bytes / (arg_length + 1 + sizeof (char *)) + 1;
+  char *extra = xmalloc (arg_length + 1);
+  char **longer = xnmalloc (argc + count + 1, sizeof *longer);
+  size_t i;
+  bool fits;
+
+  memset (extra, 'y', arg_length);
+  extra[arg_length] = '\0';
+  memcpy (longer, argv, argc * sizeof *longer);
+  for (i = 0; i < count; i++)
+    longer[argc + i] = extra;
+  longer[argc + count] = NULL;
+  fits = run (longer) == 0;
+  free (longer);
+  free (extra);
+  return fits;
+}
+
+static int
+try_exec (struct buildcmd_control *ctl, void *usercontext,
+          int argc, char **argv)
+{
+  int err;
+
+  (void) ctl;
+  (void) usercontext;
+  (void) argc;
+
+  err = run (argv);
+  if (err == E2BIG)
+    {
+      refusals++;
+      return 0;
+    }
+  if (err)
+    error (EXIT_FAILURE, err, "cannot run %s", self);
+  commands++;
+
+  if (probe_bytes)
+    {
+      size_t n = 0;
+      while (argv[n])
+        n++;
+      if (fits_with_extra (argv, n, probe_bytes))
+        roomy++;
+      probe_bytes = 0;
+    }
+  return 1;
+}
+
+/* Build and run a full command line of arguments of LENGTH bytes, and
+   then the rest.  If CHECK_ROOM, fail if much more would have fitted.
+   Return false if the system refused a command line.  */
+static bool
+try_length (size_t length, bool check_room)
+{
+  struct buildcmd_control ctl;
+  struct buildcmd_state state;
+  char *arg;
+  size_t i, n;
+
+  if (bc_init_controlinfo (&ctl, HEADROOM) != BC_INIT_OK)
+    error (EXIT_FAILURE, 0, "the environment is too large");
+  if (length + 1 > ctl.max_arg_len)
+    return true;
+  ctl.arg_max = ctl.posix_arg_size_max;
+  ctl.exec_callback = try_exec;
+  ctl.initial_argc = 2;
+  bc_init_state (&ctl, &state, NULL);
+  bc_push_arg (&ctl, &state, self, strlen (self) + 1, NULL, 0, 1);
+  bc_push_arg (&ctl, &state, "--child", sizeof "--child", NULL, 0, 1);
+
+  arg_length = length;
+  commands = refusals = roomy = 0;
+  probe_bytes = check_room ? ctl.exec_budget / 16 : 0;
+  arg = xmalloc (length + 1);
+  memset (arg, 'x', length);
+  arg[length] = '\0';
+  n = ctl.arg_max / (length + 1) + 3;
+  for (i = 0; i < n; i++)
+    bc_push_arg (&ctl, &state, arg, length + 1, NULL, 0, 0);
+  bc_do_exec (&ctl, &state);
+
+  printf ("length %zu: budget %zu, %zu commands, %zu refused\n",
+          length, ctl.exec_budget, commands, refusals);
+  if (roomy && !refusals)
+    error (EXIT_FAILURE, 0,
+           "length %zu: more than %zu bytes were left unused; "
+           "the limits are far too cautious", length, ctl.exec_budget / 16);
+
+  free (arg);
+  free (state.argbuf);
+  free (state.cmd_argv);
+  return refusals == 0;
+}
+
+static bool
+try_lengths (const size_t *lengths, size_t n, bool check_room)
+{
+  bool ok = true;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if (!try_length (lengths[i], check_room))
+      ok = false;
+  fflush (stdout);
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const size_t more_lengths[] =
+    {
+      63, 64, 65, 100, 127, 128, 255, 256, 511, 512, 1000, 1023, 1024,
+      4095, 4096, 4097, 10000, 65535, 131071, 131072
+    };
+  static const size_t big_stack_lengths[] = { 1, 2, 7, 8, 9, 100, 4096 };
+  size_t lengths[32 + sizeof more_lengths / sizeof *more_lengths];
+  size_t i;
+  struct rlimit rl;
+  bool ok;
+
+  if (argc > 1 && 0 == strcmp (argv[1], "--child"))
+    return EXIT_SUCCESS;
+  self = argv[0];
+
+  /* Every length up to 32, where the pointers cost the most. */
+  for (i = 0; i < 32; i++)
+    lengths[i] = i + 1;
+  memcpy (lengths + 32, more_lengths, sizeof more_lengths);
+  ok = try_lengths (lengths, sizeof lengths / sizeof *lengths, true);
+
+  /* Raising the stack size limit raises the limit on arguments (up to
+     a point, which is the part worth checking).  How much room is left
+     then depends on the kernel, so only check for refusals.  */
+  if (0 == getrlimit (RLIMIT_STACK, &rl) && rl.rlim_cur != rl.rlim_max)
+    {
+      rl.rlim_cur = rl.rlim_max;
+      if (0 == setrlimit (RLIMIT_STACK, &rl))
+        {
+          printf ("With the stack size limit raised:\n");
+          ok = try_lengths (big_stack_lengths,
+                            sizeof big_stack_lengths
+                            / sizeof *big_stack_lengths, false) && ok;
+        }
+    }
+
+  if (!ok)
+    error (EXIT_FAILURE, 0, "the system refused command lines");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Verify that 'xargs --worker' sends the arguments to workers on their
+# standard input and uses the statuses they report.
+
+# Copyright (C) 2026 Free Software Foundation, Inc.
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+. "${srcdir=.}/tests/init.sh"; fu_path_prepend_
+print_ver_ xargs
+
+bash=$(command -v bash) || skip_ "required utility 'bash' missing"
+
+# The worker logs its process ID, its initial arguments and each
+# argument it is sent; it reports failure for "bad" and asks xargs to
+# stop for "stop".
+mkdir bin \
+  && { echo "#!$bash"
+       cat <<'EOF2'
+while IFS= read -r -d '' arg; do
+  echo "$$ $* $arg" >> "$LOG"
+  case $arg in
+    bad) status=1 ;;
+    stop) status=255 ;;
+    *) status=0 ;;
+  esac
+  printf '%s\0' $status >&3
+done
+EOF2
+     } > bin/worker \
+  && chmod +x bin/worker \
+  || framework_failure_
+LOG="$PWD/log" && export LOG || framework_failure_
+PATH="$PWD/bin:$PATH" || framework_failure_
+
+printf '%s\n' a b c | xargs --worker worker -v > out 2> err || fail=1
+compare /dev/null out || fail=1
+compare /dev/null err || fail=1
+cut -d' ' -f2- log > out || framework_failure_
+printf -- '-v %s\n' a b c > exp || framework_failure_
+compare exp out || fail=1
+test $(cut -d' ' -f1 log | sort -u | wc -l) = 1 || fail=1
+
+# A failure makes xargs exit with status 123, but all the arguments
+# are still processed.
+rm -f log || framework_failure_
+printf 'a\0bad\0c\0' | returns_ 123 xargs -0 --worker worker || fail=1
+test $(wc -l < log) = 3 || fail=1
+
+# Status 255 makes xargs stop reading input and exit with status 124.
+printf '%s\n' stop a b | returns_ 124 xargs --worker worker 2> err || fail=1
+grep 'reported status 255' err > /dev/null || fail=1
+
+# With -P, the arguments are shared between up to that many workers.
+rm -f log || framework_failure_
+seq 30 | xargs -P 3 --worker worker || fail=1
+cut -d' ' -f2 log | sort -n > out || framework_failure_
+seq 30 > exp || framework_failure_
+compare exp out || fail=1
+test $(cut -d' ' -f1 log | sort -u | wc -l) -le 3 || fail=1
+
+# Options which need a command line per group of arguments conflict.
+for opt in -I{} -L1 -n1 -x -p; do
+  returns_ 1 xargs --worker $opt worker < /dev/null 2> /dev/null || fail=1
+done
+
+Exit $fail
@@ -42,6 +42,7 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,15 +55,19 @@
 /* gnulib headers. */
 #include "closein.h"
 #include "fcntl--.h"
+#include "intprops.h"
+#include "nproc.h"
 #include "progname.h"
 #include "quotearg.h"
 #include "safe-read.h"
 #include "unistd--.h"
 #include "xalloc.h"
+#include "xstrtod.h"
 
 /* find headers. */
 #include "buildcmd.h"
 #include "bugreports.h"
+#include "cmdpath.h"
 #include "fdleak.h"
 #include "findutils-version.h"
 #include "gcc-function-attributes.h"
@@ -153,6 +158,11 @@ static bool print_command = false;      /* Option -t */
    execute the command if the user responds affirmatively.  */
 static bool query_before_executing = false;
 
+/* If positive, the number of seconds each command should take to run
+ * (option --batch-time).
+ */
+static double batch_time = 0.0;
+
 /* The delimiter for input arguments.   This is only consulted if the
  * -0 or -d option had been given.
  */
@@ -166,14 +176,48 @@ static char input_delimiter = '\0';
  */
 static char *slot_var_name = NULL;
 
+/* If true, start the command once per slot and send it the arguments
+ * on its standard input (option --worker).
+ */
+static bool worker_mode = false;
+
+/* The workers, if worker_mode is set. */
+static struct bc_worker_pool worker_pool;
+
+/* The number of arguments sent to a worker before we wait for it to
+ * report on them.
+ */
+enum { WORKER_PIPELINE_DEPTH = 16 };
+
+/* Set when a worker tells us to stop, or dies. */
+static bool stop_workers = false;
+
+/* The number of arguments the workers exited without reporting on. */
+static size_t worker_lost = 0u;
+
+/* With --batch-time, when the command in each slot of `pids' was
+ * started and how many arguments it was given, for the batch size
+ * tuner in bc_ctl.
+ */
+struct batch_timing
+{
+  double started;
+  size_t nargs;
+};
+static struct batch_timing *batch_timings = NULL;
+static size_t batch_timings_alloc = 0u;
+
 enum LongOptionIdentifier
 {
-  PROCESS_SLOT_VAR = CHAR_MAX + 1
+  PROCESS_SLOT_VAR = CHAR_MAX + 1,
+  WORKER_OPTION,
+  BATCH_TIME_OPTION
 };
 
 static struct option const longopts[] = {
   {"null", no_argument, NULL, '0'},
   {"arg-file", required_argument, NULL, 'a'},
+  {"batch-time", required_argument, NULL, BATCH_TIME_OPTION},
   {"delimiter", required_argument, NULL, 'd'},
   {"eof", optional_argument, NULL, 'e'},
   {"replace", optional_argument, NULL, 'I'},
@@ -188,6 +232,7 @@ static struct option const longopts[] = {
   {"exit", no_argument, NULL, 'x'},
   {"max-procs", required_argument, NULL, 'P'},
   {"process-slot-var", required_argument, NULL, PROCESS_SLOT_VAR},
+  {"worker", no_argument, NULL, WORKER_OPTION},
   {"version", no_argument, NULL, 'v'},
   {"help", no_argument, NULL, 'h'},
   {NULL, no_argument, NULL, 0}
@@ -214,10 +259,21 @@ static int read_line (void);
 static int read_string (void);
 static bool print_args (bool ask);
 /* static void do_exec (void); */
+static void push_arg (char *arg, size_t len);
+static int spawn_worker (struct bc_worker_pool *pool, size_t slot,
+                         const posix_spawn_file_actions_t *actions,
+                         pid_t *pid);
+static void note_worker_status (struct bc_worker_pool *pool, size_t slot,
+                                int status);
+static void note_worker_exit (struct bc_worker_pool *pool, size_t slot,
+                              int status);
 static int xargs_do_exec (struct buildcmd_control *ctl, void *usercontext,
                           int argc, char **argv);
 static void exec_if_possible (void);
+static unsigned int free_slot (void);
 static unsigned int add_proc (pid_t pid);
+static void note_batch_start (unsigned int slot, double started,
+                              char **argv);
 static void wait_for_proc (bool all, unsigned int minreap);
 static void wait_for_proc_all (void);
 static void increment_proc_max (int);
@@ -823,6 +879,25 @@ main (int argc, char **argv)
             }
           break;
 
+        case WORKER_OPTION:
+          worker_mode = true;
+          break;
+
+        case BATCH_TIME_OPTION:
+          {
+            const char *end;
+            if (!xstrtod (optarg, &end, &batch_time, strtod) || *end
+                || !(batch_time > 0))
+              {
+                error (0, 0,
+                       _("option --%s needs a positive number of seconds, "
+                         "not %s"), longopts[option_index].name,
+                       quotearg_n_style (0, locale_quoting_style, optarg));
+                usage (EXIT_FAILURE);
+              }
+          }
+          break;
+
         default:
           usage (EXIT_FAILURE);
         }
@@ -886,9 +961,29 @@ main (int argc, char **argv)
         }
     }
 
+  if (worker_mode)
+    {
+      /* Workers are sent one argument at a time, on their standard
+       * input.
+       */
+      if (bc_ctl.replace_pat || bc_ctl.lines_per_exec
+          || bc_ctl.args_per_exec || bc_ctl.exit_if_size_exceeded
+          || open_tty || query_before_executing)
+        error (EXIT_FAILURE, 0,
+               _("option --worker cannot be used with -I, -L, -n, -o, "
+                 "-p or -x"));
+      if (optind == argc)
+        error (EXIT_FAILURE, 0, _("option --worker needs a command"));
+    }
+
   if (bc_ctl.replace_pat || bc_ctl.lines_per_exec)
     bc_ctl.exit_if_size_exceeded = true;
 
+  /* With -I and -L, the input lines decide where command lines end. */
+  if (batch_time > 0 && !bc_ctl.replace_pat && !bc_ctl.lines_per_exec
+      && !worker_mode)
+    bc_init_tuner (&bc_ctl, batch_time);
+
   if (optind == argc)
     {
       optind = 0;
@@ -953,7 +1048,20 @@ main (int argc, char **argv)
   /* Make sure to listen for the kids.  */
   signal (SIGCHLD, SIG_DFL);
 
-  if (!bc_ctl.replace_pat)
+  if (worker_mode)
+    {
+      bc_worker_pool_init (&worker_pool, argv + optind, proc_max,
+                           WORKER_PIPELINE_DEPTH, NULL);
+      worker_pool.spawn = spawn_worker;
+      worker_pool.status_callback = note_worker_status;
+      worker_pool.exit_callback = note_worker_exit;
+
+      /* The readers send each argument to a worker. */
+      while (!stop_workers && (*read_args) () != -1)
+        ;
+      bc_worker_pool_finish (&worker_pool);
+    }
+  else if (!bc_ctl.replace_pat)
     {
       for (; optind < argc; optind++)
         bc_push_arg (&bc_ctl, &bc_state,
@@ -976,17 +1084,36 @@ main (int argc, char **argv)
          input is empty.  */
       if (bc_state.cmd_argc != bc_ctl.initial_argc
           || (always_run_command && procs_executed == 0))
-        bc_do_exec (&bc_ctl, &bc_state);
+        {
+          if (bc_ctl.tuner.target > 0 && proc_max != 1)
+            {
+              /* Share the last arguments out among the idle slots, so
+               * that a single command does not hold up the end.  With
+               * no limit on the slots (-P 0), take one per processor.
+               */
+              const unsigned long slots = proc_max
+                ? (unsigned long) proc_max
+                : num_processors (NPROC_CURRENT_OVERRIDABLE);
+
+              wait_for_proc (false, 0u);
+              bc_do_exec_split (&bc_ctl, &bc_state,
+                                procs_executing < slots
+                                ? slots - procs_executing : 1u);
+            }
+          else
+            bc_do_exec (&bc_ctl, &bc_state);
+        }
 
     }
   else
     {
       int i, args;
-      size_t *arglen = xmalloc (sizeof (size_t) * argc);
+      size_t cmdlen = strlen (argv[optind]);
+      struct bc_insert_template *tpl = xnmalloc (argc, sizeof *tpl);
 
-      for (i = optind; i < argc; i++)
-        arglen[i] = strlen (argv[i]);
       bc_ctl.rplen = strlen (bc_ctl.replace_pat);
+      for (i = optind + 1; i < argc; i++)
+        bc_init_insert (&bc_ctl, &tpl[i], argv[i], strlen (argv[i]));
       while ((args = (*read_args) ()) != -1)
         {
           size_t len = (size_t) args;
@@ -995,17 +1122,19 @@ main (int argc, char **argv)
           bc_state.cmd_argv_chars = 0;  /* begin at start of buffer */
 
           bc_push_arg (&bc_ctl, &bc_state,
-                       argv[optind], arglen[optind] + 1,
+                       argv[optind], cmdlen + 1,
                        NULL, 0, initial_args);
           len--;
           initial_args = false;
 
           for (i = optind + 1; i < argc; i++)
-            bc_do_insert (&bc_ctl, &bc_state,
-                          argv[i], arglen[i],
+            bc_do_insert (&bc_ctl, &bc_state, &tpl[i],
                           NULL, 0, linebuf, len, initial_args);
           bc_do_exec (&bc_ctl, &bc_state);
         }
+      for (i = optind + 1; i < argc; i++)
+        bc_free_insert (&tpl[i]);
+      free (tpl);
     }
 
   original_exit_value = child_error;
@@ -1074,8 +1203,7 @@ read_line (void)
           if (first && EOF_STR (linebuf))
             return -1;
           if (!bc_ctl.replace_pat)
-            bc_push_arg (&bc_ctl, &bc_state,
-                         linebuf, len, NULL, 0, initial_args);
+            push_arg (linebuf, len);
           return len;
         }
       switch (state)
@@ -1112,8 +1240,7 @@ read_line (void)
                   return first ? -1 : len;
                 }
               if (!bc_ctl.replace_pat)
-                bc_push_arg (&bc_ctl, &bc_state,
-                             linebuf, len, NULL, 0, initial_args);
+                push_arg (linebuf, len);
               return len;
             }
           seen_arg = true;
@@ -1130,8 +1257,7 @@ read_line (void)
                   eof = true;
                   return first ? -1 : len;
                 }
-              bc_push_arg (&bc_ctl, &bc_state,
-                           linebuf, len, NULL, 0, initial_args);
+              push_arg (linebuf, len);
               p = linebuf;
               state = SPACE;
               first = false;
@@ -1235,8 +1361,7 @@ read_string (void)
           *p++ = '\0';
           len = p - linebuf;
           if (!bc_ctl.replace_pat)
-            bc_push_arg (&bc_ctl, &bc_state,
-                         linebuf, len, NULL, 0, initial_args);
+            push_arg (linebuf, len);
           return len;
         }
       if (c == input_delimiter)
@@ -1245,8 +1370,7 @@ read_string (void)
           *p++ = '\0';
           len = p - linebuf;
           if (!bc_ctl.replace_pat)
-            bc_push_arg (&bc_ctl, &bc_state,
-                         linebuf, len, NULL, 0, initial_args);
+            push_arg (linebuf, len);
           return len;
         }
       if (p >= endbuf)
@@ -1408,6 +1532,250 @@ prep_child_for_exec (void)
 }
 
 
+/* Return a file descriptor open on the file which prep_child_for_exec
+ * makes the standard input of commands, or -1 if it could not be
+ * opened.
+ */
+static int
+get_child_input (void)
+{
+  static int fd = -2;
+
+  if (fd == -2)
+    {
+      fd = open_cloexec (open_tty ? "/dev/tty" : "/dev/null", O_RDONLY);
+      if (0 <= fd && fd <= STDERR_FILENO)
+        {
+          /* One of the standard descriptors was closed, and using this
+           * one as the child's standard input would not clear its
+           * close-on-exec flag.
+           */
+          close (fd);
+          fd = -1;
+        }
+    }
+  return fd;
+}
+
+/* Return the environment for a command started with posix_spawn in
+ * slot SLOT.  This is our own environment, plus the variable named by
+ * the -P option if there is one.  We unset that variable at startup,
+ * and do not change the environment after that, so the copy of it we
+ * make here stays valid.
+ */
+static char **
+child_environment (unsigned int slot)
+{
+  static char **envp = NULL;
+  static char *setting = NULL;
+
+  if (!slot_var_name)
+    return environ;
+
+  if (!envp)
+    {
+      size_t n = 0;
+      while (environ[n])
+        n++;
+      envp = xnmalloc (n + 2, sizeof *envp);
+      memcpy (envp, environ, n * sizeof *envp);
+      setting = xmalloc (strlen (slot_var_name) + 1
+                         + INT_BUFSIZE_BOUND (unsigned int));
+      envp[n] = setting;
+      envp[n + 1] = NULL;
+    }
+  sprintf (setting, "%s=%u", slot_var_name, slot);
+  return envp;
+}
+
+/* Start the command ARGV with posix_spawnp, which does what
+ * prep_child_for_exec does but, unlike fork, without copying our
+ * address space.  Store the process ID of the child in *PID.  Return
+ * zero if the command was started, -1 if this needs fork after all,
+ * and otherwise an error number.
+ */
+static int
+spawn_command (char **argv, pid_t *pid)
+{
+  posix_spawn_file_actions_t actions;
+  const char *file;
+  char **script_argv = NULL;
+  int input = -1;
+  int err;
+
+  if (!keep_stdin || open_tty)
+    {
+      input = get_child_input ();
+      if (input < 0)
+        return -1;              /* Let the child report the problem. */
+    }
+
+  /* The child inherits exactly the descriptors we have open now. */
+  if (fd_leak_check_is_enabled ())
+    complain_about_leaky_fds ();
+
+  if (bc_args_exceed_testing_limit (argv))
+    return E2BIG;
+
+  err = posix_spawn_file_actions_init (&actions);
+  if (err)
+    return err;
+  if (input >= 0)
+    err = posix_spawn_file_actions_adddup2 (&actions, input, STDIN_FILENO);
+
+  file = cmdpath_lookup (argv[0]);
+  while (!err)
+    {
+      if (script_argv)
+        err = posix_spawn (pid, script_argv[0], &actions, NULL, script_argv,
+                           child_environment (free_slot ()));
+      else
+        err = posix_spawnp (pid, file, &actions, NULL, argv,
+                            child_environment (free_slot ()));
+
+      /* Like execvp, run a file the system cannot execute as a shell
+       * script.
+       */
+      if (ENOEXEC == err && !script_argv)
+        {
+          script_argv = cmdpath_script_argv (file, argv);
+          err = 0;
+          continue;
+        }
+
+      /* If we run out of processes, wait for a child to return and
+       * try again.
+       */
+      if (err != EAGAIN || !procs_executing)
+        break;
+      wait_for_proc (false, 1u);
+      err = 0;
+    }
+
+  free (script_argv);
+  posix_spawn_file_actions_destroy (&actions);
+  return err;
+}
+
+/* Raise the exit status of xargs to STATUS, unless it is higher.  */
+static void
+raise_child_error (int status)
+{
+  if (child_error < status)
+    child_error = status;
+}
+
+/* Start a worker (option --worker).  Unlike spawn_command, the pool
+ * has already arranged the worker's standard input.
+ */
+static int
+spawn_worker (struct bc_worker_pool *pool, size_t slot,
+              const posix_spawn_file_actions_t *actions, pid_t *pid)
+{
+  if (print_command)
+    {
+      char **p;
+      for (p = pool->argv; *p; p++)
+        fprintf (stderr, "%s%s", p == pool->argv ? "" : " ",
+                 quotearg_n_style (0, shell_escape_quoting_style, *p));
+      putc ('\n', stderr);
+      fflush (stderr);
+    }
+
+  /* The worker inherits exactly the descriptors we have open now. */
+  if (fd_leak_check_is_enabled ())
+    complain_about_leaky_fds ();
+
+  return posix_spawnp (pid, pool->argv[0], actions, NULL, pool->argv,
+                       child_environment (slot));
+}
+
+/* Act on the status a worker reported for one argument.  Statuses
+ * mean what exit statuses of the command would have meant without
+ * --worker.
+ */
+static void
+note_worker_status (struct bc_worker_pool *pool, size_t slot, int status)
+{
+  (void) slot;
+
+  if (BC_WORKER_LOST == status)
+    worker_lost++;
+  else if (CHILD_EXIT_PLEASE_STOP_IMMEDIATELY == status)
+    {
+      if (!stop_workers)
+        error (0, 0, _("%s: reported status 255; aborting"),
+               pool->argv[0]);
+      raise_child_error (XARGS_EXIT_CLIENT_EXIT_255);
+      stop_workers = true;
+    }
+  else if (status)
+    raise_child_error (XARGS_EXIT_CLIENT_EXIT_NONZERO);
+}
+
+/* Act on the exit of a worker. */
+static void
+note_worker_exit (struct bc_worker_pool *pool, size_t slot, int status)
+{
+  const char *name = pool->argv[0];
+
+  (void) slot;
+
+  if (worker_lost)
+    {
+      error (0, 0, _("%s: exited without reporting on every argument "
+                     "sent to it"), name);
+      raise_child_error (XARGS_EXIT_CLIENT_EXIT_NONZERO);
+      worker_lost = 0u;
+    }
+  if (WIFSIGNALED (status))
+    {
+      error (0, 0, _("%s: terminated by signal %d"), name, WTERMSIG (status));
+      raise_child_error (XARGS_EXIT_CLIENT_FATAL_SIG);
+      stop_workers = true;
+    }
+  else if (WEXITSTATUS (status) == CHILD_EXIT_PLEASE_STOP_IMMEDIATELY)
+    {
+      error (0, 0, _("%s: exited with status 255; aborting"), name);
+      raise_child_error (XARGS_EXIT_CLIENT_EXIT_255);
+      stop_workers = true;
+    }
+  else if (WEXITSTATUS (status) != 0)
+    raise_child_error (XARGS_EXIT_CLIENT_EXIT_NONZERO);
+}
+
+/* Send the argument ARG, of length LEN including its terminating
+ * null, to a worker.
+ */
+static void
+send_to_worker (char *arg, size_t len)
+{
+  int err = bc_worker_pool_send (&worker_pool, arg, len);
+
+  if (err)
+    {
+      error (0, err, _("failed to run command %s"),
+             quotearg_n_style (0, locale_quoting_style, worker_pool.argv[0]));
+      bc_worker_pool_finish (&worker_pool);
+      exit (ENOENT == err
+            ? XARGS_EXIT_COMMAND_NOT_FOUND
+            : XARGS_EXIT_COMMAND_CANNOT_BE_RUN);
+    }
+}
+
+/* Add the argument ARG, of length LEN including its terminating null,
+ * to the command line, or with --worker send it to a worker.
+ */
+static void
+push_arg (char *arg, size_t len)
+{
+  if (worker_mode)
+    send_to_worker (arg, len);
+  else
+    bc_push_arg (&bc_ctl, &bc_state, arg, len, NULL, 0, initial_args);
+}
+
+
 /* Execute the command that has been built in `cmd_argv'.  This may involve
    waiting for processes that were previously executed.
 
@@ -1423,7 +1791,10 @@ xargs_do_exec (struct buildcmd_control *ctl, void *usercontext, int argc,
   pid_t child;
   int fd[2];
   int buf;
+  int err;
   ptrdiff_t r;
+  double started = 0.0;
+  const char *file;
 
   (void) ctl;
   (void) argc;
@@ -1453,6 +1824,28 @@ xargs_do_exec (struct buildcmd_control *ctl, void *usercontext, int argc,
        */
       wait_for_proc (false, 0u);
 
+      if (bc_ctl.tuner.target > 0)
+        started = bc_now ();
+      err = spawn_command (argv, &child);
+      if (0 == err)
+        {
+          note_batch_start (add_proc (child), started, argv);
+          return 1;             /* Success */
+        }
+      else if (E2BIG == err)
+        {
+          return 0;             /* Failure; caller should pass fewer args */
+        }
+      else if (0 < err)
+        {
+          error (0, err, _("failed to run command %s"),
+                 quotearg_n_style (0, locale_quoting_style, argv[0]));
+          exit (ENOENT == err
+                ? XARGS_EXIT_COMMAND_NOT_FOUND
+                : XARGS_EXIT_COMMAND_CANNOT_BE_RUN);
+        }
+
+      /* posix_spawn cannot set up the child as we need, so fork. */
       if (pipe (fd))
         {
           /* TRANSLATORS: The pipe being referred to is an
@@ -1468,6 +1861,9 @@ xargs_do_exec (struct buildcmd_control *ctl, void *usercontext, int argc,
         }
       fcntl (fd[1], F_SETFD, FD_CLOEXEC);
 
+      /* Search $PATH here, where the answer is remembered. */
+      file = cmdpath_lookup (argv[0]);
+
       /* If we run out of processes, wait for a child to return and
          try again.  */
       while ((child = fork ()) < 0 && errno == EAGAIN && procs_executing)
@@ -1496,7 +1892,7 @@ xargs_do_exec (struct buildcmd_control *ctl, void *usercontext, int argc,
             if (bc_args_exceed_testing_limit (argv))
               errno = E2BIG;
             else
-              execvp (argv[0], argv);
+              execvp (file, argv);
             int saved_errno = errno;
             if (saved_errno)
               {
@@ -1587,7 +1983,7 @@ xargs_do_exec (struct buildcmd_control *ctl, void *usercontext, int argc,
            * want to do that if we didn't already wait for the
            * child.
            */
-          add_proc (child);
+          note_batch_start (add_proc (child), started, argv);
         }
     }
   return 1;                     /* Success */
@@ -1604,6 +2000,18 @@ exec_if_possible (void)
   bc_do_exec (&bc_ctl, &bc_state);
 }
 
+/* Return the index of the first empty slot in `pids', which is where
+   add_proc will record the next process.  This may be pids_alloc.  */
+static unsigned int
+free_slot (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < pids_alloc && pids[i]; i++)
+    ;
+  return i;
+}
+
 /* Add the process with id PID to the list of processes that have
    been executed.  */
 static unsigned int
@@ -1612,8 +2020,7 @@ add_proc (pid_t pid)
   unsigned int i, j;
 
   /* Find an empty slot.  */
-  for (i = 0; i < pids_alloc && pids[i]; i++)
-    ;
+  i = free_slot ();
 
   /* Extend the array if we failed. */
   if (i == pids_alloc)
@@ -1634,6 +2041,23 @@ add_proc (pid_t pid)
   return i;
 }
 
+/* With --batch-time, remember that the command ARGV, which we recorded
+   in slot SLOT of `pids', was started at time STARTED.  */
+static void
+note_batch_start (unsigned int slot, double started, char **argv)
+{
+  if (!(bc_ctl.tuner.target > 0))
+    return;
+  if (batch_timings_alloc < pids_alloc)
+    {
+      batch_timings = xnrealloc (batch_timings, pids_alloc,
+                                 sizeof *batch_timings);
+      batch_timings_alloc = pids_alloc;
+    }
+  batch_timings[slot].started = started;
+  batch_timings[slot].nargs = bc_batch_size (&bc_ctl, argv);
+}
+
 
 /* If ALL is true, wait for all child processes to finish;
    otherwise, wait for one child process to finish, or for another signal
@@ -1726,6 +2150,10 @@ wait_for_proc (bool all, unsigned int minreap)
       procs_executing--;
       reaped++;
 
+      if (bc_ctl.tuner.target > 0)
+        bc_note_batch_time (&bc_ctl, batch_timings[i].nargs,
+                            bc_now () - batch_timings[i].started);
+
 #define set_deferred_exit_status(n) \
       do \
       { \
@@ -2079,6 +2507,9 @@ usage (int status)
         "                                 logical EOF processing\n"));
   HTL (_
        ("  -a, --arg-file=FILE          read arguments from FILE, not standard input\n"));
+  HTL (_
+       ("      --batch-time=SECONDS     adjust the number of arguments per command line\n"
+        "                                 so that each command runs for about SECONDS\n"));
   HTL (_
        ("  -d, --delimiter=CHARACTER    items in input stream are separated by CHARACTER,\n"
         "                                 not by whitespace; disables quote and backslash\n"
@@ -2122,6 +2553,9 @@ usage (int status)
        ("      --show-limits            show limits on command-line length\n"));
   HTL (_
        ("  -t, --verbose                print commands before executing them\n"));
+  HTL (_
+       ("      --worker                 start COMMAND once per process and send it the\n"
+        "                                 arguments on its standard input, one at a time\n"));
   HTL (_
        ("  -x, --exit                   exit if the size (see -s) is exceeded\n"));
 